@@ -0,0 +1,127 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "asset_cache.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+AssetCache::AssetCache(const char *directory)
+        : m_directory(directory ? directory : "")
+        , m_hitCounts(0)
+        , m_missCounts(0)
+        , m_storeCounts(0)
+{
+}
+
+void AssetCache::setDirectory(const char *directory)
+{
+    m_directory = directory ? directory : "";
+}
+
+uint64_t AssetCache::hashBytes(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = (0xcbf29ce484222325ull ^ seed) * 0x9e3779b97f4a7c15ull ^ size;
+
+    size_t words = size / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool AssetCache::hashFile(const char *path, uint64_t seed, uint64_t &hash)
+{
+    MappedFile file;
+    if (file.open(path))
+    {
+        hash = hashBytes(file.data(), file.size(), seed);
+        return true;
+    }
+
+    //empty files can't be mapped
+    FILE* stream = fopen(path, "rb");
+    if (!stream) return false;
+    bool empty = fgetc(stream) == EOF;
+    fclose(stream);
+    if (empty) hash = hashBytes(nullptr, 0, seed);
+    return empty;
+}
+
+std::string AssetCache::_getPath(uint64_t key, const char *extension) const
+{
+    char name[48];
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".%s", key, extension);
+    return m_directory + name;
+}
+
+bool AssetCache::load(uint64_t key, const char *extension, MappedFile &file)
+{
+    if (!isEnabled() || !file.open(_getPath(key, extension).c_str()))
+    {
+        m_missCounts++;
+        return false;
+    }
+    m_hitCounts++;
+    return true;
+}
+
+bool AssetCache::store(uint64_t key, const char *extension, const void *data, size_t size)
+{
+    if (!isEnabled()) return false;
+
+#ifdef _WIN32
+    _mkdir(m_directory.c_str());
+#else
+    mkdir(m_directory.c_str(), 0755);
+#endif
+
+    //another thread or process may write the same entry, each one uses its own temporary file
+    std::string path = _getPath(key, extension);
+    char suffix[32];
+    uint64_t writer = (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                      (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    snprintf(suffix, sizeof(suffix), ".%016" PRIx64 ".tmp", writer);
+    std::string tempPath = path + suffix;
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    m_storeCounts++;
+    return true;
+}
@@ -0,0 +1,56 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_ASSET_CACHE_H
+#define SIMPLE_FLUID_SIMULATOR_ASSET_CACHE_H
+
+#include "mapped_file.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/** content addressed files in one directory, for assets which are slow to build from their sources.
+ *  an entry is named by a key hashed from everything it was built from, the source files, the import settings
+ *  and the layout of the data, so a changed source just misses and a stale entry is never read. entries are
+ *  written to a temporary file and renamed, a crash never leaves a broken one behind.
+ *  load and store may be called from several threads */
+class AssetCache
+{
+public:
+    /** entries go to directory, created with the first store. an empty path disables the cache */
+    void setDirectory(const char* directory);
+    bool isEnabled() const { return !m_directory.empty(); }
+
+    /** map the entry of key, false if there is none */
+    bool load(uint64_t key, const char* extension, MappedFile& file);
+    bool store(uint64_t key, const char* extension, const void* data, size_t size);
+
+    unsigned int getHitCounts() const { return m_hitCounts; }
+    unsigned int getMissCounts() const { return m_missCounts; }
+    unsigned int getStoreCounts() const { return m_storeCounts; }
+
+    /** hash of data chained onto seed */
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+    /** hash of the content of a file chained onto seed, false if it can't be read */
+    static bool hashFile(const char* path, uint64_t seed, uint64_t& hash);
+
+private:
+    std::string _getPath(uint64_t key, const char* extension) const;
+
+private:
+    std::string m_directory;
+    std::atomic<unsigned int> m_hitCounts;
+    std::atomic<unsigned int> m_missCounts;
+    std::atomic<unsigned int> m_storeCounts;
+
+public:
+    explicit AssetCache(const char* directory = "asset_cache");
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_ASSET_CACHE_H
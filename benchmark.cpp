@@ -0,0 +1,231 @@
+//
+// Created by Leo on 2026/10/19.
+//
+// Runs the canonical scenarios for a fixed simulated time and reports strong and weak scaling.
+//
+//   Simple_Fluid_Benchmark [--threads N] [--sim-time seconds] [--sizes n1,n2,..] [--weak-size n]
+//                          [--output results.csv] [--baseline baseline.csv] [--save-baseline] [--tolerance percent]
+//                          [--no-stats]
+//
+// Strong scaling runs every scenario and size on 1..N threads. Weak scaling runs every scenario on 1..N threads
+// with weak-size particles per thread. With --baseline every run is compared to the stored one and runs more than
+// tolerance percent slower are reported, the exit code is 1 if any run regressed.
+//
+
+#include "scenario.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchmarkResult
+{
+    std::string mode;
+    std::string scenario;
+    unsigned int targetCounts;
+    unsigned int pointCounts;
+    unsigned int threadCounts;
+    unsigned int ticks;
+    double msPerTick;
+    double speedup;
+
+    std::string key() const
+    {
+        std::ostringstream ss;
+        ss << mode << "," << scenario << "," << targetCounts << "," << threadCounts;
+        return ss.str();
+    }
+};
+
+static const char* CSV_HEADER = "mode,scenario,target_points,threads,points,ticks,ms_per_tick,speedup,efficiency";
+
+static bool runScenario(SPHSystem* sphSystem, const char* mode, ScenarioType type,
+                        unsigned int targetCounts, unsigned int threadCounts, float simTime, BenchmarkResult& result)
+{
+    sphSystem->setThreadCounts(threadCounts);
+    if (!setupScenario(sphSystem, type, targetCounts))
+    {
+        std::cout << "skipped " << mode << "," << getScenarioName(type) << "," << targetCounts
+                  << ": more particles than a system can address" << std::endl;
+        return false;
+    }
+
+    unsigned int ticks = (unsigned int)(simTime / sphSystem->getDeltaTime() + 0.5f);
+    if (ticks == 0) ticks = 1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ticks; i++)
+    {
+        sphSystem->tick();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    result.mode = mode;
+    result.scenario = getScenarioName(type);
+    result.targetCounts = targetCounts;
+    result.pointCounts = sphSystem->getPointCounts();
+    result.threadCounts = threadCounts;
+    result.ticks = ticks;
+    result.msPerTick = std::chrono::duration<double, std::milli>(stop - start).count() / ticks;
+    result.speedup = 1.0;
+    return true;
+}
+
+static void printResult(std::ostream& os, const BenchmarkResult& r)
+{
+    os << r.mode << "," << r.scenario << "," << r.targetCounts << "," << r.threadCounts << ","
+       << r.pointCounts << "," << r.ticks << "," << r.msPerTick << "," << r.speedup << ","
+       << r.speedup / r.threadCounts << std::endl;
+}
+
+static std::map<std::string, double> loadBaseline(const char* path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line); //header
+
+    while (std::getline(file, line))
+    {
+        // mode,scenario,target_points,threads,points,ticks,ms_per_tick,...
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) fields.push_back(field);
+        if (fields.size() < 7) continue;
+
+        std::string key = fields[0] + "," + fields[1] + "," + fields[2] + "," + fields[3];
+        baseline[key] = std::atof(fields[6].c_str());
+    }
+    return baseline;
+}
+
+static std::vector<unsigned int> parseSizes(const char* text)
+{
+    std::vector<unsigned int> sizes;
+    std::stringstream ss(text);
+    std::string field;
+    while (std::getline(ss, field, ','))
+    {
+        unsigned int size = (unsigned int)std::atoi(field.c_str());
+        if (size > 0) sizes.push_back(size);
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0) maxThreads = 1;
+    float simTime = 0.3f;
+    std::vector<unsigned int> sizes{ 1000, 4000, 16000 };
+    unsigned int weakSize = 1000;
+    const char* outputPath = nullptr;
+    const char* baselinePath = nullptr;
+    bool saveBaseline = false;
+    double tolerance = 10.0;
+    bool statsEnabled = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--threads") && hasValue) maxThreads = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--sim-time") && hasValue) simTime = (float)std::atof(argv[++i]);
+        else if (!strcmp(argv[i], "--sizes") && hasValue) sizes = parseSizes(argv[++i]);
+        else if (!strcmp(argv[i], "--weak-size") && hasValue) weakSize = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--output") && hasValue) outputPath = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && hasValue) baselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--save-baseline")) saveBaseline = true;
+        else if (!strcmp(argv[i], "--tolerance") && hasValue) tolerance = std::atof(argv[++i]);
+        else if (!strcmp(argv[i], "--no-stats")) statsEnabled = false;
+        else
+        {
+            std::cout << "unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (maxThreads == 0) maxThreads = 1;
+
+    SPHSystem sphSystem;
+    sphSystem.setStatsEnabled(statsEnabled);
+    std::vector<BenchmarkResult> results;
+
+    std::cout << CSV_HEADER << std::endl;
+
+    // Strong scaling: same problem, more threads
+    for (int type = 0; type < SCENARIO_COUNTS; type++)
+    {
+        for (unsigned int size : sizes)
+        {
+            double singleThreadMs = 0.0;
+            for (unsigned int threads = 1; threads <= maxThreads; threads++)
+            {
+                BenchmarkResult r;
+                if (!runScenario(&sphSystem, "strong", (ScenarioType)type, size, threads, simTime, r)) break;
+                if (threads == 1) singleThreadMs = r.msPerTick;
+                r.speedup = singleThreadMs / r.msPerTick;
+                printResult(std::cout, r);
+                results.push_back(r);
+            }
+        }
+    }
+
+    // Weak scaling: particles proportional to threads, ideal time per tick stays constant
+    for (int type = 0; type < SCENARIO_COUNTS; type++)
+    {
+        double singleThreadMs = 0.0;
+        for (unsigned int threads = 1; threads <= maxThreads; threads++)
+        {
+            BenchmarkResult r;
+            if (!runScenario(&sphSystem, "weak", (ScenarioType)type, weakSize * threads, threads, simTime, r)) break;
+            if (threads == 1) singleThreadMs = r.msPerTick;
+            r.speedup = singleThreadMs * threads / r.msPerTick;
+            printResult(std::cout, r);
+            results.push_back(r);
+        }
+    }
+
+    if (outputPath)
+    {
+        std::ofstream output(outputPath);
+        output << CSV_HEADER << std::endl;
+        for (const auto& r : results) printResult(output, r);
+    }
+
+    int regressions = 0;
+    if (baselinePath && saveBaseline)
+    {
+        std::ofstream baseline(baselinePath);
+        baseline << CSV_HEADER << std::endl;
+        for (const auto& r : results) printResult(baseline, r);
+        std::cout << "baseline saved to " << baselinePath << std::endl;
+    }
+    else if (baselinePath)
+    {
+        std::map<std::string, double> baseline = loadBaseline(baselinePath);
+        for (const auto& r : results)
+        {
+            auto it = baseline.find(r.key());
+            if (it == baseline.end() || it->second <= 0.0) continue;
+
+            double slowdown = (r.msPerTick / it->second - 1.0) * 100.0;
+            if (slowdown > tolerance)
+            {
+                std::printf("REGRESSION %s: %.3f ms/tick, baseline %.3f ms/tick (+%.1f%%)\n",
+                            r.key().c_str(), r.msPerTick, it->second, slowdown);
+                regressions++;
+            }
+        }
+        std::cout << regressions << " regression(s) over " << tolerance << "% against " << baselinePath << std::endl;
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const char CHECKPOINT_MAGIC[8] = { 'S', 'P', 'H', 'C', 'K', 'P', 'T', 0 };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    //bytes of a particle block, the last one may be short
+    uint64_t blockBytes(uint64_t particleBytes, uint64_t begin)
+    {
+        return std::min<uint64_t>(particleBytes - begin, CHECKPOINT_BLOCK_BYTES);
+    }
+
+    uint64_t hashBytes(const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64_t hash = 0xcbf29ce484222325ull ^ size;
+
+        size_t words = size / sizeof(uint64_t);
+        for (size_t i = 0; i < words; i++)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+            hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+            hash ^= hash >> 29;
+        }
+        for (size_t i = words * sizeof(uint64_t); i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    CheckpointHeader buildHeader(const CheckpointState& state)
+    {
+        CheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.state = CHECKPOINT_STATE_COMPLETE;
+        header.particleStride = sizeof(Particle);
+        header.pointCounts = state.pointCounts;
+        header.pointCapacity = state.pointCapacity;
+        header.nextPointId = state.nextPointId;
+        header.tickCounts = state.tickCounts;
+
+        uint64_t sizes[CHECKPOINT_SECTION_COUNTS] =
+        {
+            sizeof(CheckpointParameters),
+            sizeof(CheckpointGrid),
+            (uint64_t)state.pointCounts * sizeof(Particle),
+            (uint64_t)state.pointCounts * sizeof(float),
+            (uint64_t)state.pointCounts * sizeof(float),
+            (uint64_t)state.pointCounts * sizeof(uint32_t),
+        };
+
+        uint64_t offset = alignUp(sizeof(CheckpointHeader), CHECKPOINT_ALIGNMENT);
+        for (int i = 0; i < CHECKPOINT_SECTION_COUNTS; i++)
+        {
+            header.sections[i].offset = offset;
+            header.sections[i].size = sizes[i];
+            offset = alignUp(offset + sizes[i], CHECKPOINT_ALIGNMENT);
+        }
+
+        header.sections[CHECKPOINT_SECTION_PARAMETERS].hash = hashBytes(&state.parameters, sizeof(state.parameters));
+        header.sections[CHECKPOINT_SECTION_GRID].hash = hashBytes(&state.grid, sizeof(state.grid));
+        header.sections[CHECKPOINT_SECTION_MASSES].hash = hashBytes(state.masses, (size_t)sizes[CHECKPOINT_SECTION_MASSES]);
+        header.sections[CHECKPOINT_SECTION_RADII].hash = hashBytes(state.radii, (size_t)sizes[CHECKPOINT_SECTION_RADII]);
+        header.sections[CHECKPOINT_SECTION_IDS].hash = hashBytes(state.ids, (size_t)sizes[CHECKPOINT_SECTION_IDS]);
+        return header;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+CheckpointWriter::CheckpointWriter()
+        : m_lastWrittenBytes(0)
+{
+    memset(&m_lastHeader, 0, sizeof(m_lastHeader));
+}
+
+bool CheckpointWriter::write(const char *path, const CheckpointState &state, bool incremental)
+{
+    CheckpointHeader header = buildHeader(state);
+
+    std::vector<uint64_t> blockHashes;
+    _hashBlocks(state, blockHashes);
+    header.sections[CHECKPOINT_SECTION_PARTICLES].hash = hashBytes(blockHashes.data(), blockHashes.size() * sizeof(uint64_t));
+
+    //incremental writes need the same layout as the file on disk
+    bool samePath = !m_path.empty() && m_path == path;
+    bool sameLayout = m_lastHeader.pointCounts == header.pointCounts
+                      && m_lastHeader.pointCapacity == header.pointCapacity;
+
+    bool ok;
+    if (incremental && samePath && sameLayout)
+    {
+        //fall back to a full write if the old file is gone or broken
+        ok = _writeIncremental(header, state, blockHashes) || _writeFull(path, header, state);
+    }
+    else
+    {
+        ok = _writeFull(path, header, state);
+    }
+
+    if (ok)
+    {
+        m_path = path;
+        m_lastHeader = header;
+        m_blockHashes.swap(blockHashes);
+    }
+    else
+    {
+        //the file is in an unknown state, the next write rewrites it
+        m_path.clear();
+    }
+    return ok;
+}
+
+bool CheckpointWriter::_writeFull(const char *path, const CheckpointHeader &header, const CheckpointState &state)
+{
+    //write a temporary file and move it over the old checkpoint, so a crash never leaves a broken file
+    std::string tempPath = std::string(path) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) return false;
+
+    m_lastWrittenBytes = 0;
+    const CheckpointSection* sections = header.sections;
+    bool ok = _writeAt(file, 0, &header, sizeof(header))
+              && _writeAt(file, sections[CHECKPOINT_SECTION_PARAMETERS].offset, &state.parameters, sizeof(state.parameters))
+              && _writeAt(file, sections[CHECKPOINT_SECTION_GRID].offset, &state.grid, sizeof(state.grid))
+              && _writeAt(file, sections[CHECKPOINT_SECTION_PARTICLES].offset, state.particles,
+                          sections[CHECKPOINT_SECTION_PARTICLES].size)
+              && _writeAt(file, sections[CHECKPOINT_SECTION_MASSES].offset, state.masses, sections[CHECKPOINT_SECTION_MASSES].size)
+              && _writeAt(file, sections[CHECKPOINT_SECTION_RADII].offset, state.radii, sections[CHECKPOINT_SECTION_RADII].size)
+              && _writeAt(file, sections[CHECKPOINT_SECTION_IDS].offset, state.ids, sections[CHECKPOINT_SECTION_IDS].size);
+
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(tempPath.c_str(), path) == 0;
+}
+
+bool CheckpointWriter::_writeIncremental(const CheckpointHeader &header, const CheckpointState &state,
+                                         const std::vector<uint64_t> &blockHashes)
+{
+    FILE* file = fopen(m_path.c_str(), "r+b");
+    if (!file) return false;
+
+    //the blocks on disk are only known if nobody else wrote the file since our last write
+    CheckpointHeader diskHeader;
+    if (fread(&diskHeader, sizeof(diskHeader), 1, file) != 1 || memcmp(&diskHeader, &m_lastHeader, sizeof(diskHeader)) != 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    m_lastWrittenBytes = 0;
+
+    //mark the file as being written until all blocks are on disk
+    CheckpointHeader writingHeader = m_lastHeader;
+    writingHeader.state = CHECKPOINT_STATE_WRITING;
+    bool ok = _writeAt(file, 0, &writingHeader, sizeof(writingHeader)) && fflush(file) == 0;
+
+    const CheckpointSection* sections = header.sections;
+    if (ok && sections[CHECKPOINT_SECTION_PARAMETERS].hash != m_lastHeader.sections[CHECKPOINT_SECTION_PARAMETERS].hash)
+    {
+        ok = _writeAt(file, sections[CHECKPOINT_SECTION_PARAMETERS].offset, &state.parameters, sizeof(state.parameters));
+    }
+    if (ok && sections[CHECKPOINT_SECTION_GRID].hash != m_lastHeader.sections[CHECKPOINT_SECTION_GRID].hash)
+    {
+        ok = _writeAt(file, sections[CHECKPOINT_SECTION_GRID].offset, &state.grid, sizeof(state.grid));
+    }
+
+    //masses, radii and ids change only when particles are split or merged, they are rewritten as a whole
+    const void* arrays[] = { state.masses, state.radii, state.ids };
+    for (int i = 0; i < 3; i++)
+    {
+        int type = CHECKPOINT_SECTION_MASSES + i;
+        if (ok && sections[type].hash != m_lastHeader.sections[type].hash)
+        {
+            ok = _writeAt(file, sections[type].offset, arrays[i], sections[type].size);
+        }
+    }
+
+    uint64_t particleBytes = sections[CHECKPOINT_SECTION_PARTICLES].size;
+    for (size_t block = 0; ok && block < blockHashes.size(); block++)
+    {
+        if (block < m_blockHashes.size() && m_blockHashes[block] == blockHashes[block]) continue;
+
+        uint64_t begin = (uint64_t)block * CHECKPOINT_BLOCK_BYTES;
+        ok = _writeAt(file, sections[CHECKPOINT_SECTION_PARTICLES].offset + begin,
+                      (const unsigned char*)state.particles + begin, blockBytes(particleBytes, begin));
+    }
+
+    ok = ok && fflush(file) == 0 && _writeAt(file, 0, &header, sizeof(header));
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool CheckpointWriter::_writeAt(FILE *file, uint64_t offset, const void *data, uint64_t size)
+{
+    if (fseek(file, (long)offset, SEEK_SET) != 0) return false;
+    if (size > 0 && fwrite(data, 1, (size_t)size, file) != size) return false;
+
+    m_lastWrittenBytes += size;
+    return true;
+}
+
+void CheckpointWriter::_hashBlocks(const CheckpointState &state, std::vector<uint64_t> &hashes) const
+{
+    uint64_t particleBytes = (uint64_t)state.pointCounts * sizeof(Particle);
+    size_t blockCounts = (size_t)((particleBytes + CHECKPOINT_BLOCK_BYTES - 1) / CHECKPOINT_BLOCK_BYTES);
+
+    hashes.resize(blockCounts);
+    for (size_t block = 0; block < blockCounts; block++)
+    {
+        uint64_t begin = (uint64_t)block * CHECKPOINT_BLOCK_BYTES;
+        hashes[block] = hashBytes((const unsigned char*)state.particles + begin, (size_t)blockBytes(particleBytes, begin));
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+bool readCheckpoint(const char *path, MappedFile &file, CheckpointState &state)
+{
+    if (!file.open(path)) return false;
+
+    const unsigned char* data = file.data();
+    if (file.size() < sizeof(CheckpointHeader)) return false;
+
+    const CheckpointHeader* header = (const CheckpointHeader*)data;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CHECKPOINT_VERSION
+        || header->state != CHECKPOINT_STATE_COMPLETE
+        || header->particleStride != sizeof(Particle)
+        || header->pointCounts > 0xffff || header->pointCapacity > 0xffff
+        || header->pointCapacity < header->pointCounts)
+    {
+        return false;
+    }
+
+    uint64_t expectedSizes[CHECKPOINT_SECTION_COUNTS] =
+    {
+        sizeof(CheckpointParameters),
+        sizeof(CheckpointGrid),
+        (uint64_t)header->pointCounts * sizeof(Particle),
+        (uint64_t)header->pointCounts * sizeof(float),
+        (uint64_t)header->pointCounts * sizeof(float),
+        (uint64_t)header->pointCounts * sizeof(uint32_t),
+    };
+    for (int i = 0; i < CHECKPOINT_SECTION_COUNTS; i++)
+    {
+        const CheckpointSection& section = header->sections[i];
+        if (section.size != expectedSizes[i] || section.offset % CHECKPOINT_ALIGNMENT != 0
+            || section.offset + section.size > file.size())
+        {
+            return false;
+        }
+    }
+
+    memcpy(&state.parameters, data + header->sections[CHECKPOINT_SECTION_PARAMETERS].offset, sizeof(state.parameters));
+    memcpy(&state.grid, data + header->sections[CHECKPOINT_SECTION_GRID].offset, sizeof(state.grid));
+    state.tickCounts = header->tickCounts;
+    state.particles = (const Particle*)(data + header->sections[CHECKPOINT_SECTION_PARTICLES].offset);
+    state.masses = (const float*)(data + header->sections[CHECKPOINT_SECTION_MASSES].offset);
+    state.radii = (const float*)(data + header->sections[CHECKPOINT_SECTION_RADII].offset);
+    state.ids = (const uint32_t*)(data + header->sections[CHECKPOINT_SECTION_IDS].offset);
+    state.pointCounts = header->pointCounts;
+    state.pointCapacity = header->pointCapacity;
+    state.nextPointId = header->nextPointId;
+    return true;
+}
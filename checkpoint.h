@@ -0,0 +1,141 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_CHECKPOINT_H
+#define SIMPLE_FLUID_SIMULATOR_CHECKPOINT_H
+
+#include "particle.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Checkpoint file layout, all values little endian:
+//
+//   CheckpointHeader                       (padded to CHECKPOINT_ALIGNMENT)
+//   section PARAMETERS: CheckpointParameters
+//   section GRID:       CheckpointGrid
+//   section PARTICLES:  Particle[pointCounts], the in memory layout of ParticleBuffer
+//   section MASSES:     float[pointCounts], kg
+//   section RADII:      float[pointCounts], smoothing radius in metres
+//   section IDS:        uint32_t[pointCounts]
+//
+// Every section starts at a multiple of CHECKPOINT_ALIGNMENT, so a mapped file can be used without parsing.
+
+enum
+{
+    CHECKPOINT_VERSION = 2,
+    CHECKPOINT_ALIGNMENT = 4096,
+    CHECKPOINT_BLOCK_BYTES = 256 * 1024,    // granularity of incremental writes
+};
+
+enum CheckpointSectionType
+{
+    CHECKPOINT_SECTION_PARAMETERS,
+    CHECKPOINT_SECTION_GRID,
+    CHECKPOINT_SECTION_PARTICLES,
+    CHECKPOINT_SECTION_MASSES,
+    CHECKPOINT_SECTION_RADII,
+    CHECKPOINT_SECTION_IDS,
+
+    CHECKPOINT_SECTION_COUNTS
+};
+
+struct CheckpointSection
+{
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+};
+
+struct CheckpointHeader
+{
+    char magic[8];                  // "SPHCKPT\0"
+    uint32_t version;
+    uint32_t state;                 // CHECKPOINT_STATE_*, a crash during an incremental write leaves WRITING
+    uint32_t particleStride;        // sizeof(Particle) of the writer
+    uint32_t pointCounts;
+    uint32_t pointCapacity;
+    uint32_t nextPointId;           // id given to the next new particle
+    uint64_t tickCounts;
+    CheckpointSection sections[CHECKPOINT_SECTION_COUNTS];
+};
+
+enum
+{
+    CHECKPOINT_STATE_WRITING = 0,
+    CHECKPOINT_STATE_COMPLETE = 1,
+};
+
+struct CheckpointParameters
+{
+    float unitScale;
+    float viscosity;
+    float restDensity;
+    float particleMass;
+    float smoothRadius;
+    float gasConstantK;
+    float boundaryStiffness;
+    float boundaryDampening;
+    float speedLimiting;
+    float deltaTime;
+    float gravity[3];
+};
+
+struct CheckpointGrid
+{
+    float wallMin[3];
+    float wallMax[3];
+    float cellSize;
+    float border;
+};
+
+/** state of a system as stored in a checkpoint, the arrays point into the system or into the mapped file and
+ *  hold pointCounts entries each */
+struct CheckpointState
+{
+    CheckpointParameters parameters;
+    CheckpointGrid grid;
+    uint64_t tickCounts;
+    const Particle* particles;
+    const float* masses;
+    const float* radii;
+    const uint32_t* ids;
+    unsigned int pointCounts;
+    unsigned int pointCapacity;
+    uint32_t nextPointId;
+};
+
+/** writes checkpoints, in incremental mode only the sections and particle blocks which changed since the
+ *  previous write to the same path are rewritten */
+class CheckpointWriter
+{
+public:
+    bool write(const char* path, const CheckpointState& state, bool incremental);
+
+    /** bytes written by the last write */
+    uint64_t getLastWrittenBytes() const { return m_lastWrittenBytes; }
+
+private:
+    bool _writeFull(const char* path, const CheckpointHeader& header, const CheckpointState& state);
+    bool _writeIncremental(const CheckpointHeader& header, const CheckpointState& state, const std::vector<uint64_t>& blockHashes);
+    bool _writeAt(FILE* file, uint64_t offset, const void* data, uint64_t size);
+    void _hashBlocks(const CheckpointState& state, std::vector<uint64_t>& hashes) const;
+
+private:
+    std::string m_path;                 // path of the previous write
+    CheckpointHeader m_lastHeader;
+    std::vector<uint64_t> m_blockHashes;
+    uint64_t m_lastWrittenBytes;
+
+public:
+    CheckpointWriter();
+};
+
+/** map a checkpoint and validate it, state.particles points into the mapping */
+bool readCheckpoint(const char* path, MappedFile& file, CheckpointState& state);
+
+#endif //SIMPLE_FLUID_SIMULATOR_CHECKPOINT_H
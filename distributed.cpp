@@ -0,0 +1,245 @@
+//
+// Created by Leo on 2026/10/19.
+//
+// Runs a scenario with its domain split between several local processes, see DistributedSystem.
+//
+//   Simple_Fluid_Distributed [--ranks N] [--transport socket|shm] [--split slabs|kd] [--scenario name]
+//                            [--size N] [--sim-time seconds] [--rebalance ticks] [--threads N] [--compare]
+//
+// The ranks are forked from this process and talk over Unix sockets or shared memory. Every rank prints its
+// region and timers at the end. With --compare rank 0 runs the same scenario in one system afterwards and
+// reports how far the particles of both runs are apart and the time per tick of both.
+//
+
+#include "distributed_system.h"
+#include "scenario.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+struct DistributedOptions
+{
+    int rankCounts;
+    bool sharedMemory;
+    DomainSplit split;
+    ScenarioType scenario;
+    unsigned int size;
+    float simTime;
+    unsigned int rebalanceInterval;
+    unsigned int threadCounts;
+    bool compare;
+};
+
+static int runRank(RankTransport* transport, const DistributedOptions& options)
+{
+    SPHSystem source;
+    if (!setupScenario(&source, options.scenario, options.size))
+    {
+        std::printf("rank %d: the scene holds more particles than a system can address\n", transport->getRank());
+        return 1;
+    }
+
+    DistributedSystem system(transport);
+    system.setSplit(options.split);
+    system.setRebalance(options.rebalanceInterval);
+    system.getSystem().setThreadCounts(options.threadCounts);
+    if (!system.init(source))
+    {
+        std::printf("rank %d: the region holds more particles than a system can address\n", transport->getRank());
+        return 1;
+    }
+
+    unsigned int ticks = (unsigned int)(options.simTime / source.getDeltaTime() + 0.5f);
+    if (ticks == 0) ticks = 1;
+
+    double computeTime = 0.0;
+    double exchangeTime = 0.0;
+    unsigned int migratedCounts = 0;
+    unsigned int ghostCounts = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ticks; i++)
+    {
+        if (!system.tick())
+        {
+            std::printf("rank %d: tick %u failed\n", transport->getRank(), i);
+            return 1;
+        }
+        const DistributedStats& stats = system.getStats();
+        computeTime += stats.computeTime;
+        exchangeTime += stats.exchangeTime;
+        migratedCounts += stats.migratedCounts;
+        ghostCounts += stats.ghostCounts;
+    }
+    double wallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const DistributedStats& stats = system.getStats();
+    const ParticleBox3& region = system.getRegions()[transport->getRank()];
+    std::printf("rank %d: region (%.1f %.1f %.1f)-(%.1f %.1f %.1f), %u owned, %.0f ghosts and %.1f migrated per tick, "
+                "compute %.3f ms and exchange %.3f ms per tick, %.2f MB sent, %u rebalances, imbalance %.2f\n",
+                transport->getRank(), region.min.x, region.min.y, region.min.z, region.max.x, region.max.y, region.max.z,
+                stats.ownedCounts, (double)ghostCounts / ticks, (double)migratedCounts / ticks,
+                computeTime / ticks, exchangeTime / ticks, stats.sentBytes / 1e6, stats.rebalanceCounts, stats.imbalance);
+    std::fflush(stdout);
+
+    std::vector<Particle> particles;
+    std::vector<uint32_t> ids;
+    if (!system.gather(particles, ids)) return 1;
+    if (transport->getRank() != 0) return 0;
+
+    std::printf("%u particles on %d ranks, %u ticks in %.3f s, %.3f ms per tick\n",
+                (unsigned int)particles.size(), transport->getRankCounts(), ticks, wallTime / 1000.0, wallTime / ticks);
+    if (particles.size() != source.getPointCounts())
+    {
+        std::printf("lost particles, %u at the start\n", source.getPointCounts());
+        return 1;
+    }
+    if (!options.compare) return 0;
+
+    source.setThreadCounts(options.threadCounts);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ticks; i++) source.tick();
+    double referenceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    //ids of a fresh scenario are the buffer indices, the reference keeps its order
+    double maxDistance = 0.0;
+    double distanceSum2 = 0.0;
+    const Particle* reference = source.getParticles();
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        double distance = glm::length(particles[i].pos - reference[ids[i]].pos);
+        maxDistance = std::max(maxDistance, distance);
+        distanceSum2 += distance * distance;
+    }
+    std::printf("single system %.3f ms per tick, particles apart by %.3g at most and %.3g rms (world units)\n",
+                referenceTime / ticks, maxDistance, std::sqrt(distanceSum2 / particles.size()));
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    DistributedOptions options;
+    options.rankCounts = 2;
+    options.sharedMemory = false;
+    options.split = DOMAIN_SLABS;
+    options.scenario = SCENARIO_DAM_BREAK;
+    options.size = 20000;
+    options.simTime = 0.3f;
+    options.rebalanceInterval = 20;
+    options.threadCounts = 1;
+    options.compare = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--ranks") && hasValue) options.rankCounts = std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--transport") && hasValue) options.sharedMemory = !strcmp(argv[++i], "shm");
+        else if (!strcmp(argv[i], "--split") && hasValue) options.split = !strcmp(argv[++i], "kd") ? DOMAIN_KD : DOMAIN_SLABS;
+        else if (!strcmp(argv[i], "--size") && hasValue) options.size = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--sim-time") && hasValue) options.simTime = (float)std::atof(argv[++i]);
+        else if (!strcmp(argv[i], "--rebalance") && hasValue) options.rebalanceInterval = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && hasValue) options.threadCounts = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--compare")) options.compare = true;
+        else if (!strcmp(argv[i], "--scenario") && hasValue)
+        {
+            const char* name = argv[++i];
+            int type = 0;
+            while (type < SCENARIO_COUNTS && strcmp(name, getScenarioName((ScenarioType)type)) != 0) type++;
+            if (type == SCENARIO_COUNTS)
+            {
+                std::cout << "unknown scenario " << name << std::endl;
+                return 2;
+            }
+            options.scenario = (ScenarioType)type;
+        }
+        else
+        {
+            std::cout << "unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (options.rankCounts < 1) options.rankCounts = 1;
+    if (options.threadCounts == 0) options.threadCounts = 1;
+
+#ifdef _WIN32
+    std::cout << "distributed runs fork their ranks, posix only" << std::endl;
+    return 1;
+#else
+    SocketTransport sockets;
+    SharedMemoryTransport sharedMemory;
+    char segmentName[64];
+    std::snprintf(segmentName, sizeof(segmentName), "/sph_ranks_%d", (int)getpid());
+    bool created = options.sharedMemory ? sharedMemory.create(segmentName, options.rankCounts)
+                                        : sockets.create(options.rankCounts);
+    if (!created)
+    {
+        std::cout << "Failed to create the transport for " << options.rankCounts << " ranks" << std::endl;
+        return 1;
+    }
+
+    std::printf("%d ranks over %s, %s split\n", options.rankCounts, options.sharedMemory ? "shared memory" : "unix sockets",
+                options.split == DOMAIN_KD ? "k-d" : "slab");
+    std::fflush(stdout);
+
+    std::vector<pid_t> ranks;
+    for (int rank = 0; rank < options.rankCounts; rank++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            RankTransport* transport = &sockets;
+            bool attached;
+            if (options.sharedMemory)
+            {
+                transport = &sharedMemory;
+                attached = sharedMemory.attach(segmentName, rank);
+            }
+            else attached = sockets.attach(rank);
+            int code = attached ? runRank(transport, options) : 1;
+            std::fflush(stdout);
+            sockets.close();
+            sharedMemory.close();
+            _exit(code);
+        }
+        if (pid < 0)
+        {
+            std::cout << "Failed to fork rank " << rank << std::endl;
+            for (pid_t started : ranks) kill(started, SIGTERM);
+            break;
+        }
+        ranks.push_back(pid);
+    }
+    //the parent keeps no ends of the sockets, a rank that dies is seen by its peers
+    sockets.close();
+
+    //a failed rank would leave the others waiting on it
+    int result = (int)ranks.size() == options.rankCounts ? 0 : 1;
+    for (size_t remaining = ranks.size(); remaining > 0; remaining--)
+    {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if (result == 0)
+            {
+                for (pid_t other : ranks) kill(other, SIGTERM);
+            }
+            result = 1;
+        }
+    }
+    sharedMemory.close();
+    return result;
+#endif
+}
@@ -0,0 +1,509 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "distributed_system.h"
+#include "checkpoint.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // samples of its particles every rank contributes to a split
+    const unsigned int MAX_SAMPLES = 4096;
+
+    struct MigrateRecord
+    {
+        Particle particle;
+        uint32_t id;
+        float mass;
+        float radius;
+    };
+
+    struct GhostRecord
+    {
+        glm::vec3 pos;
+        glm::vec3 velocity;
+        uint32_t id;
+        float mass;
+        float radius;
+    };
+
+    struct DensityRecord
+    {
+        float density;
+        float pressure;
+    };
+
+    struct CostHeader
+    {
+        float computeTime;              // ms per tick
+        uint32_t ownedCounts;
+    };
+
+    struct SampleRecord
+    {
+        glm::vec3 pos;
+        float weight;
+    };
+
+    template <typename T>
+    void appendRecord(std::vector<char>& buf, const T& record)
+    {
+        size_t offset = buf.size();
+        buf.resize(offset + sizeof(T));
+        memcpy(&buf[offset], &record, sizeof(T));
+    }
+
+    template <typename T>
+    T readRecord(const std::vector<char>& buf, size_t offset)
+    {
+        T record;
+        memcpy(&record, buf.data() + offset, sizeof(T));
+        return record;
+    }
+
+    float elapsedMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop)
+    {
+        return std::chrono::duration<float, std::milli>(stop - start).count();
+    }
+}
+
+DistributedSystem::DistributedSystem(RankTransport *transport)
+        : m_transport(transport)
+        , m_split(DOMAIN_SLABS)
+        , m_slabAxis(0)
+        , m_rebalanceInterval(20)
+        , m_rebalanceThreshold(1.1f)
+        , m_wallBox(glm::vec3(0.f), glm::vec3(0.f))
+        , m_ownedCounts(0)
+        , m_costTime(0.f)
+        , m_costTicks(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool DistributedSystem::init(const SPHSystem &source)
+{
+    CheckpointState state;
+    source.getCheckpointState(state);
+    return init(state, source.getPointIds());
+}
+
+bool DistributedSystem::init(const CheckpointState &state, const uint32_t *ids)
+{
+    int rankCounts = getRankCounts();
+    if (!m_transport->isAttached() || m_system.isAdaptiveResolution()) return false;
+
+    m_wallBox = ParticleBox3(glm::vec3(state.grid.wallMin[0], state.grid.wallMin[1], state.grid.wallMin[2]),
+                             glm::vec3(state.grid.wallMax[0], state.grid.wallMax[1], state.grid.wallMax[2]));
+
+    //every rank sees all particles here, the first split is by counts
+    unsigned int stride = std::max(1u, state.pointCounts / (MAX_SAMPLES * rankCounts));
+    std::vector<Sample> samples;
+    samples.reserve(state.pointCounts / stride + 1);
+    for (unsigned int i = 0; i < state.pointCounts; i += stride)
+    {
+        samples.push_back({ state.particles[i].pos, (float)stride });
+    }
+    _split(samples);
+
+    m_particles.clear();
+    m_ids.clear();
+    m_masses.clear();
+    m_radii.clear();
+    if (!ids) ids = state.ids;
+    for (unsigned int i = 0; i < state.pointCounts; i++)
+    {
+        if (_findOwner(state.particles[i].pos) != getRank()) continue;
+        m_particles.push_back(state.particles[i]);
+        m_ids.push_back(ids ? ids[i] : i);
+        m_masses.push_back(state.masses ? state.masses[i] : state.parameters.particleMass);
+        m_radii.push_back(state.radii ? state.radii[i] : state.parameters.smoothRadius);
+    }
+    m_ownedCounts = (unsigned int)m_particles.size();
+
+    //parameters and grid of the whole domain, then the particles of this rank
+    CheckpointState local = state;
+    local.particles = nullptr;
+    local.pointCounts = 0;
+    local.pointCapacity = 0;
+    if (!m_system.setCheckpointState(local) ||
+        !m_system.setParticles(m_particles.data(), m_ids.data(), m_ownedCounts, m_masses.data(), m_radii.data())) return false;
+
+    m_sendBufs.resize(rankCounts);
+    m_recvBufs.resize(rankCounts);
+    m_haloIndices.resize(rankCounts);
+    m_ghostStarts.assign(rankCounts + 1, m_ownedCounts);
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.ownedCounts = m_ownedCounts;
+    m_stats.totalCounts = state.pointCounts;
+    m_stats.imbalance = 1.f;
+    m_costTime = 0.f;
+    m_costTicks = 0;
+    return true;
+}
+
+void DistributedSystem::_split(std::vector<Sample> &samples)
+{
+    m_nodes.clear();
+    m_regions.assign(getRankCounts(), m_wallBox);
+    _splitNode(samples, 0, (unsigned int)samples.size(), 0, getRankCounts(), m_wallBox);
+}
+
+int DistributedSystem::_splitNode(std::vector<Sample> &samples, unsigned int begin, unsigned int end,
+                                  int rankBegin, int rankEnd, const ParticleBox3 &region)
+{
+    int index = (int)m_nodes.size();
+    m_nodes.push_back({ 0, 0.f, { -1, -1 }, -1 });
+
+    if (rankEnd - rankBegin == 1)
+    {
+        m_nodes[index].rank = rankBegin;
+        m_regions[rankBegin] = region;
+        return index;
+    }
+
+    glm::vec3 size = region.max - region.min;
+    int axis = m_slabAxis;
+    if (m_split == DOMAIN_KD)
+    {
+        axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+    }
+
+    //the lower part gets its share of the ranks and the same share of the cost
+    int lowerRanks = (rankEnd - rankBegin) / 2;
+    float fraction = (float)lowerRanks / (rankEnd - rankBegin);
+    std::sort(samples.begin() + begin, samples.begin() + end,
+              [axis](const Sample& a, const Sample& b) { return a.pos[axis] < b.pos[axis]; });
+
+    float total = 0.f;
+    for (unsigned int i = begin; i < end; i++) total += samples[i].weight;
+
+    float position;
+    unsigned int cut = begin;
+    if (total > 0.f)
+    {
+        float target = total * fraction;
+        float sum = 0.f;
+        while (cut < end && sum + 0.5f * samples[cut].weight < target) sum += samples[cut++].weight;
+
+        if (cut == begin) position = samples[begin].pos[axis];
+        else if (cut == end) position = std::nextafter(samples[end - 1].pos[axis], std::numeric_limits<float>::max());
+        else position = 0.5f * (samples[cut - 1].pos[axis] + samples[cut].pos[axis]);
+    }
+    else
+    {
+        //nothing to weigh, cut the region by its size
+        position = region.min[axis] + size[axis] * fraction;
+        cut = end;
+    }
+
+    ParticleBox3 lower = region;
+    ParticleBox3 upper = region;
+    float clamped = std::min(std::max(position, region.min[axis]), region.max[axis]);
+    lower.max[axis] = clamped;
+    upper.min[axis] = clamped;
+
+    int lowerNode = _splitNode(samples, begin, cut, rankBegin, rankBegin + lowerRanks, lower);
+    int upperNode = _splitNode(samples, cut, end, rankBegin + lowerRanks, rankEnd, upper);
+
+    SplitNode& node = m_nodes[index];
+    node.axis = axis;
+    node.position = position;
+    node.children[0] = lowerNode;
+    node.children[1] = upperNode;
+    return index;
+}
+
+int DistributedSystem::_findOwner(const glm::vec3 &pos) const
+{
+    int node = 0;
+    while (m_nodes[node].rank < 0)
+    {
+        const SplitNode& split = m_nodes[node];
+        node = split.children[pos[split.axis] < split.position ? 0 : 1];
+    }
+    return m_nodes[node].rank;
+}
+
+void DistributedSystem::_findGhostRanks(int node, const glm::vec3 &pos, float width, std::vector<int> &ranks) const
+{
+    const SplitNode& split = m_nodes[node];
+    if (split.rank >= 0)
+    {
+        if (split.rank != getRank()) ranks.push_back(split.rank);
+        return;
+    }
+    if (pos[split.axis] - width < split.position) _findGhostRanks(split.children[0], pos, width, ranks);
+    if (pos[split.axis] + width >= split.position) _findGhostRanks(split.children[1], pos, width, ranks);
+}
+
+bool DistributedSystem::tick()
+{
+    TRACE_SCOPE("distributed tick");
+
+    //a split or merge would change the owned particles in the middle of the exchange
+    if (m_system.isAdaptiveResolution()) return false;
+
+    auto start = std::chrono::steady_clock::now();
+    if (!_migrate() || !_exchangeHalo()) return false;
+    if (!m_system.setParticles(m_particles.data(), m_ids.data(), (unsigned int)m_particles.size(),
+                               m_masses.data(), m_radii.data())) return false;
+
+    auto densityStart = std::chrono::steady_clock::now();
+    m_system.tickDensity(m_ownedCounts);
+    auto densityStop = std::chrono::steady_clock::now();
+
+    if (!_exchangeDensity()) return false;
+
+    auto forceStart = std::chrono::steady_clock::now();
+    m_system.tickForce(m_ownedCounts);
+    auto stop = std::chrono::steady_clock::now();
+
+    m_stats.ownedCounts = m_ownedCounts;
+    m_stats.ghostCounts = (unsigned int)m_particles.size() - m_ownedCounts;
+    m_stats.computeTime = elapsedMs(densityStart, densityStop) + elapsedMs(forceStart, stop);
+    m_stats.exchangeTime = elapsedMs(start, stop) - m_stats.computeTime;
+    m_stats.sentBytes = m_transport->getSentBytes();
+
+    //every rank counts the same ticks, so all of them check the balance together
+    m_costTime += m_stats.computeTime;
+    m_costTicks++;
+    if (m_rebalanceInterval > 0 && m_costTicks >= m_rebalanceInterval) return _rebalance();
+    return true;
+}
+
+bool DistributedSystem::_migrate()
+{
+    TRACE_SCOPE("migrate");
+
+    int rank = getRank();
+    const Particle* particles = m_system.getParticles();
+    const uint32_t* ids = m_system.getPointIds();
+    const float* masses = m_system.getPointMasses();
+    const float* radii = m_system.getPointSmoothRadii();
+    for (std::vector<char>& buf : m_sendBufs) buf.clear();
+
+    m_particles.clear();
+    m_ids.clear();
+    m_masses.clear();
+    m_radii.clear();
+    m_stats.migratedCounts = 0;
+    for (unsigned int i = 0; i < m_ownedCounts; i++)
+    {
+        int owner = _findOwner(particles[i].pos);
+        if (owner == rank)
+        {
+            m_particles.push_back(particles[i]);
+            m_ids.push_back(ids[i]);
+            m_masses.push_back(masses[i]);
+            m_radii.push_back(radii[i]);
+            continue;
+        }
+        appendRecord(m_sendBufs[owner], MigrateRecord{ particles[i], ids[i], masses[i], radii[i] });
+        m_stats.migratedCounts++;
+    }
+
+    if (!m_transport->exchange(m_sendBufs, m_recvBufs)) return false;
+
+    //in rank order, so the particle order only depends on the state
+    for (int from = 0; from < getRankCounts(); from++)
+    {
+        if (from == rank) continue;
+        const std::vector<char>& buf = m_recvBufs[from];
+        for (size_t offset = 0; offset + sizeof(MigrateRecord) <= buf.size(); offset += sizeof(MigrateRecord))
+        {
+            MigrateRecord record = readRecord<MigrateRecord>(buf, offset);
+            m_particles.push_back(record.particle);
+            m_ids.push_back(record.id);
+            m_masses.push_back(record.mass);
+            m_radii.push_back(record.radius);
+        }
+    }
+    m_ownedCounts = (unsigned int)m_particles.size();
+    return true;
+}
+
+bool DistributedSystem::_exchangeHalo()
+{
+    TRACE_SCOPE("exchange halo");
+
+    int rank = getRank();
+    float width = m_system.getSmoothRadius();
+    for (int to = 0; to < getRankCounts(); to++)
+    {
+        m_sendBufs[to].clear();
+        m_haloIndices[to].clear();
+    }
+
+    for (unsigned int i = 0; i < m_ownedCounts; i++)
+    {
+        const Particle& p = m_particles[i];
+        m_ranks.clear();
+        _findGhostRanks(0, p.pos, width, m_ranks);
+        for (int to : m_ranks)
+        {
+            m_haloIndices[to].push_back(i);
+            appendRecord(m_sendBufs[to], GhostRecord{ p.pos, p.velocity, m_ids[i], m_masses[i], m_radii[i] });
+        }
+    }
+
+    if (!m_transport->exchange(m_sendBufs, m_recvBufs)) return false;
+
+    //ghosts only need what the neighbor search and the forces read, density and pressure follow
+    for (int from = 0; from < getRankCounts(); from++)
+    {
+        m_ghostStarts[from] = (unsigned int)m_particles.size();
+        if (from == rank) continue;
+        const std::vector<char>& buf = m_recvBufs[from];
+        for (size_t offset = 0; offset + sizeof(GhostRecord) <= buf.size(); offset += sizeof(GhostRecord))
+        {
+            GhostRecord record = readRecord<GhostRecord>(buf, offset);
+            Particle ghost = {};
+            ghost.pos = record.pos;
+            ghost.velocity = record.velocity;
+            m_particles.push_back(ghost);
+            m_ids.push_back(record.id);
+            m_masses.push_back(record.mass);
+            m_radii.push_back(record.radius);
+        }
+    }
+    m_ghostStarts[getRankCounts()] = (unsigned int)m_particles.size();
+    return true;
+}
+
+bool DistributedSystem::_exchangeDensity()
+{
+    TRACE_SCOPE("exchange density");
+
+    int rank = getRank();
+    Particle* particles = m_system.getParticles();
+    for (int to = 0; to < getRankCounts(); to++)
+    {
+        m_sendBufs[to].clear();
+        for (unsigned int i : m_haloIndices[to])
+        {
+            appendRecord(m_sendBufs[to], DensityRecord{ particles[i].density, particles[i].pressure });
+        }
+    }
+
+    if (!m_transport->exchange(m_sendBufs, m_recvBufs)) return false;
+
+    //records come in the order the ghosts were sent
+    for (int from = 0; from < getRankCounts(); from++)
+    {
+        if (from == rank) continue;
+        unsigned int ghostCounts = m_ghostStarts[from + 1] - m_ghostStarts[from];
+        if (m_recvBufs[from].size() != ghostCounts * sizeof(DensityRecord)) return false;
+        for (unsigned int k = 0; k < ghostCounts; k++)
+        {
+            DensityRecord record = readRecord<DensityRecord>(m_recvBufs[from], k * sizeof(DensityRecord));
+            Particle& ghost = particles[m_ghostStarts[from] + k];
+            ghost.density = record.density;
+            ghost.pressure = record.pressure;
+        }
+    }
+    return true;
+}
+
+bool DistributedSystem::_rebalance()
+{
+    TRACE_SCOPE("rebalance");
+
+    int rankCounts = getRankCounts();
+    float computeTime = m_costTime / m_costTicks;
+    m_costTime = 0.f;
+    m_costTicks = 0;
+
+    //the cost of a rank is spread evenly over its particles
+    const Particle* particles = m_system.getParticles();
+    unsigned int stride = std::max(1u, m_ownedCounts / MAX_SAMPLES);
+    float weight = m_ownedCounts > 0 ? computeTime * stride / m_ownedCounts : 0.f;
+
+    std::vector<char>& message = m_sendBufs[getRank()];
+    message.clear();
+    appendRecord(message, CostHeader{ computeTime, m_ownedCounts });
+    for (unsigned int i = 0; i < m_ownedCounts; i += stride)
+    {
+        appendRecord(message, SampleRecord{ particles[i].pos, weight });
+    }
+    for (int to = 0; to < rankCounts; to++)
+    {
+        if (to != getRank()) m_sendBufs[to] = message;
+    }
+
+    if (!m_transport->exchange(m_sendBufs, m_recvBufs)) return false;
+
+    //all ranks have the same messages in the same order and come to the same split
+    float maxTime = 0.f;
+    float timeSum = 0.f;
+    unsigned int totalCounts = 0;
+    std::vector<Sample> samples;
+    for (int from = 0; from < rankCounts; from++)
+    {
+        const std::vector<char>& buf = m_recvBufs[from];
+        if (buf.size() < sizeof(CostHeader)) return false;
+        CostHeader header = readRecord<CostHeader>(buf, 0);
+        maxTime = std::max(maxTime, header.computeTime);
+        timeSum += header.computeTime;
+        totalCounts += header.ownedCounts;
+        for (size_t offset = sizeof(CostHeader); offset + sizeof(SampleRecord) <= buf.size(); offset += sizeof(SampleRecord))
+        {
+            SampleRecord record = readRecord<SampleRecord>(buf, offset);
+            samples.push_back({ record.pos, record.weight });
+        }
+    }
+
+    float averageTime = timeSum / rankCounts;
+    m_stats.totalCounts = totalCounts;
+    m_stats.imbalance = averageTime > 0.f ? maxTime / averageTime : 1.f;
+    if (m_stats.imbalance <= m_rebalanceThreshold) return true;
+
+    _split(samples);
+    m_stats.rebalanceCounts++;
+    return true;
+}
+
+bool DistributedSystem::gather(std::vector<Particle> &particles, std::vector<uint32_t> &ids)
+{
+    const Particle* owned = m_system.getParticles();
+    const uint32_t* ownedIds = m_system.getPointIds();
+    const float* ownedMasses = m_system.getPointMasses();
+    const float* ownedRadii = m_system.getPointSmoothRadii();
+    for (std::vector<char>& buf : m_sendBufs) buf.clear();
+    for (unsigned int i = 0; i < m_ownedCounts; i++)
+    {
+        appendRecord(m_sendBufs[0], MigrateRecord{ owned[i], ownedIds[i], ownedMasses[i], ownedRadii[i] });
+    }
+
+    particles.clear();
+    ids.clear();
+    if (!m_transport->exchange(m_sendBufs, m_recvBufs)) return false;
+    if (getRank() != 0) return true;
+
+    std::vector<MigrateRecord> records;
+    for (const std::vector<char>& buf : m_recvBufs)
+    {
+        for (size_t offset = 0; offset + sizeof(MigrateRecord) <= buf.size(); offset += sizeof(MigrateRecord))
+        {
+            records.push_back(readRecord<MigrateRecord>(buf, offset));
+        }
+    }
+    std::sort(records.begin(), records.end(), [](const MigrateRecord& a, const MigrateRecord& b) { return a.id < b.id; });
+
+    particles.reserve(records.size());
+    ids.reserve(records.size());
+    for (const MigrateRecord& record : records)
+    {
+        particles.push_back(record.particle);
+        ids.push_back(record.id);
+    }
+    return true;
+}
@@ -0,0 +1,144 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_DISTRIBUTED_SYSTEM_H
+#define SIMPLE_FLUID_SIMULATOR_DISTRIBUTED_SYSTEM_H
+
+#include "particle_box.h"
+#include "rank_transport.h"
+#include "sph_system.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct CheckpointState;
+
+/** how the domain is cut into the regions of the ranks */
+enum DomainSplit
+{
+    DOMAIN_SLABS,                       // every cut along the slab axis
+    DOMAIN_KD,                          // recursive bisection, every cut across the longest side of the region
+};
+
+/** counters and timers of one rank */
+struct DistributedStats
+{
+    unsigned int ownedCounts;
+    unsigned int ghostCounts;           // copies of particles of other ranks in the last tick
+    unsigned int migratedCounts;        // particles handed to other ranks by the last tick
+    unsigned int totalCounts;           // particles of all ranks, counted at the last rebalance
+    unsigned int rebalanceCounts;
+    float computeTime;                  // ms, density and force of the last tick
+    float exchangeTime;                 // ms, migration and halos of the last tick, includes waiting for other ranks
+    float imbalance;                    // slowest rank over the average compute time, at the last rebalance check
+    uint64_t sentBytes;
+};
+
+/** one rank of a system whose domain is split between several processes.
+ *  every rank owns the particles in its region and keeps them in its own SPHSystem, together with ghosts: copies
+ *  of the particles of other ranks within one smoothing radius of the region. a tick hands the particles which
+ *  left the region to their new owner, sends the positions of the halo, the owned particles other ranks need as
+ *  ghosts, computes the density, sends the density of the halo and moves the owned particles with the forces.
+ *  the regions are leaves of a k-d tree which every rank builds the same way from weighted samples of all
+ *  particles, the weight of a particle is the measured compute time per particle of its rank. rebalancing moves
+ *  the cuts so that every rank gets the same cost, particles follow with the next migration */
+class DistributedSystem
+{
+public:
+    /** call before init */
+    void setSplit(DomainSplit split, int slabAxis = 0) { m_split = split; m_slabAxis = slabAxis; }
+    /** check the balance every interval ticks and cut the domain again when the slowest rank is more than
+     *  threshold times the average, 0 keeps the first split */
+    void setRebalance(unsigned int interval, float threshold = 1.1f) { m_rebalanceInterval = interval; m_rebalanceThreshold = threshold; }
+
+    /** every rank passes the same global state, the domain is split by particle counts and every rank keeps the
+     *  particles of its region. ids are the ones of state if null, or the indices in state if it has none either.
+     *  false if the region holds more particles than a system can address, or if adaptive resolution is enabled
+     *  on getSystem(): particles keep the masses and radii of state but are never split or merged across ranks */
+    bool init(const CheckpointState& state, const uint32_t* ids = nullptr);
+    bool init(const SPHSystem& source);
+
+    /** advance all ranks by one step, every rank has to call it. false if a rank is gone, a region holds more
+     *  particles than a system can address or adaptive resolution was enabled on getSystem() */
+    bool tick();
+
+    /** collect the particles of all ranks on rank 0, ordered by id. the other ranks get none */
+    bool gather(std::vector<Particle>& particles, std::vector<uint32_t>& ids);
+
+    int getRank() const { return m_transport->getRank(); }
+    int getRankCounts() const { return m_transport->getRankCounts(); }
+    /** the region of every rank, the outer ones are clipped to the wall box */
+    const std::vector<ParticleBox3>& getRegions() const { return m_regions; }
+    /** the system of this rank, its first getOwnedCounts particles are owned and the ghosts of the last tick
+     *  follow them */
+    const SPHSystem& getSystem() const { return m_system; }
+    SPHSystem& getSystem() { return m_system; }
+    unsigned int getOwnedCounts() const { return m_ownedCounts; }
+    const DistributedStats& getStats() const { return m_stats; }
+
+private:
+    // a leaf when rank >= 0, otherwise positions below the cut go to the first child
+    struct SplitNode
+    {
+        int axis;
+        float position;
+        int children[2];
+        int rank;
+    };
+
+    struct Sample
+    {
+        glm::vec3 pos;
+        float weight;
+    };
+
+    void _split(std::vector<Sample>& samples);
+    int _splitNode(std::vector<Sample>& samples, unsigned int begin, unsigned int end,
+                   int rankBegin, int rankEnd, const ParticleBox3& region);
+    int _findOwner(const glm::vec3& pos) const;
+    void _findGhostRanks(int node, const glm::vec3& pos, float width, std::vector<int>& ranks) const;
+    bool _migrate();
+    bool _exchangeHalo();
+    bool _exchangeDensity();
+    bool _rebalance();
+
+private:
+    RankTransport* m_transport;
+    SPHSystem m_system;
+    DomainSplit m_split;
+    int m_slabAxis;
+    unsigned int m_rebalanceInterval;
+    float m_rebalanceThreshold;
+
+    std::vector<SplitNode> m_nodes;                         // the root first
+    std::vector<ParticleBox3> m_regions;
+    ParticleBox3 m_wallBox;
+
+    // owned particles then ghosts, copied into the system every tick
+    std::vector<Particle> m_particles;
+    std::vector<uint32_t> m_ids;
+    std::vector<float> m_masses;                            // kg
+    std::vector<float> m_radii;                             // smoothing radius in metres
+    unsigned int m_ownedCounts;
+    std::vector<std::vector<unsigned int> > m_haloIndices;  // owned particles sent to every rank, in sent order
+    std::vector<unsigned int> m_ghostStarts;                // ghosts of rank r are [m_ghostStarts[r], m_ghostStarts[r + 1])
+
+    std::vector<std::vector<char> > m_sendBufs;
+    std::vector<std::vector<char> > m_recvBufs;
+    std::vector<int> m_ranks;
+
+    DistributedStats m_stats;
+    float m_costTime;                                       // ms of compute since the last rebalance check
+    unsigned int m_costTicks;
+
+public:
+    /** the transport is attached and outlives the system */
+    explicit DistributedSystem(RankTransport* transport);
+
+    DistributedSystem(const DistributedSystem&) = delete;
+    DistributedSystem& operator=(const DistributedSystem&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_DISTRIBUTED_SYSTEM_H
@@ -0,0 +1,125 @@
+//
+// Created by Leo on 2026/10/19.
+//
+// Runs a parameter sweep as an ensemble of independent systems in one process.
+//
+//   Simple_Fluid_Ensemble [--threads N] [--sim-time seconds] [--sweep sweep.csv] [--scenarios s1,s2,..]
+//                         [--sizes n1,n2,..] [--viscosities v1,v2,..] [--gas-constants k1,k2,..]
+//                         [--summary summary.csv]
+//
+// Without --sweep every combination of scenarios, sizes, viscosities and gas constants is a member, see
+// EnsembleRunner::loadSweep for the sweep file. The results of all members go to one summary file, the
+// aggregate throughput is printed at the end.
+//
+
+#include "sph_ensemble.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::vector<std::string> splitList(const char* text)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(text);
+    std::string field;
+    while (std::getline(ss, field, ','))
+    {
+        if (!field.empty()) fields.push_back(field);
+    }
+    return fields;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threadCounts = std::thread::hardware_concurrency();
+    float simTime = 0.3f;
+    const char* sweepPath = nullptr;
+    const char* summaryPath = "sph_ensemble.csv";
+    std::vector<ScenarioType> scenarios{ SCENARIO_DAM_BREAK };
+    std::vector<unsigned int> sizes{ 1000 };
+    std::vector<float> viscosities{ 0.5f, 1.f, 2.f };
+    std::vector<float> gasConstants{ 0.5f, 1.f, 2.f };
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--threads") && hasValue) threadCounts = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--sim-time") && hasValue) simTime = (float)std::atof(argv[++i]);
+        else if (!strcmp(argv[i], "--sweep") && hasValue) sweepPath = argv[++i];
+        else if (!strcmp(argv[i], "--summary") && hasValue) summaryPath = argv[++i];
+        else if (!strcmp(argv[i], "--scenarios") && hasValue)
+        {
+            scenarios.clear();
+            for (const std::string& name : splitList(argv[++i]))
+            {
+                int type = 0;
+                while (type < SCENARIO_COUNTS && name != getScenarioName((ScenarioType)type)) type++;
+                if (type == SCENARIO_COUNTS)
+                {
+                    std::cout << "unknown scenario " << name << std::endl;
+                    return 2;
+                }
+                scenarios.push_back((ScenarioType)type);
+            }
+        }
+        else if (!strcmp(argv[i], "--sizes") && hasValue)
+        {
+            sizes.clear();
+            for (const std::string& size : splitList(argv[++i])) sizes.push_back((unsigned int)std::atoi(size.c_str()));
+        }
+        else if (!strcmp(argv[i], "--viscosities") && hasValue)
+        {
+            viscosities.clear();
+            for (const std::string& value : splitList(argv[++i])) viscosities.push_back((float)std::atof(value.c_str()));
+        }
+        else if (!strcmp(argv[i], "--gas-constants") && hasValue)
+        {
+            gasConstants.clear();
+            for (const std::string& value : splitList(argv[++i])) gasConstants.push_back((float)std::atof(value.c_str()));
+        }
+        else
+        {
+            std::cout << "unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (threadCounts == 0) threadCounts = 1;
+
+    EnsembleRunner runner(threadCounts);
+    if (sweepPath)
+    {
+        if (!runner.loadSweep(sweepPath, simTime))
+        {
+            std::cout << "Failed to load sweep " << sweepPath << std::endl;
+            return 1;
+        }
+    }
+    else runner.addSweep(scenarios, sizes, viscosities, gasConstants, simTime);
+
+    std::cout << "running " << runner.getMemberCounts() << " members on " << runner.getThreadCounts() << " threads" << std::endl;
+    runner.run();
+
+    unsigned int failedCounts = 0;
+    unsigned int unbuiltCounts = 0;
+    for (unsigned int i = 0; i < runner.getMemberCounts(); i++)
+    {
+        if (!runner.getResult(i).built) unbuiltCounts++;
+        else if (!runner.getResult(i).finite) failedCounts++;
+    }
+    std::printf("%u members in %.3f s, %.3g particle updates per second, %u blew up, %u too large to build\n",
+                runner.getMemberCounts(), runner.getWallTime(), runner.getThroughput(), failedCounts, unbuiltCounts);
+
+    if (!runner.writeSummary(summaryPath))
+    {
+        std::cout << "Failed to write summary " << summaryPath << std::endl;
+        return 1;
+    }
+    std::cout << "summary written to " << summaryPath << std::endl;
+    return 0;
+}
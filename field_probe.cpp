@@ -0,0 +1,201 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "field_probe.h"
+#include "sph_system.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    float elapsedMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop)
+    {
+        return std::chrono::duration<float, std::milli>(stop - start).count();
+    }
+}
+
+FieldProbe::FieldProbe(unsigned int threadCounts)
+        : m_taskPool(threadCounts)
+        , m_workerCounters(m_taskPool.getThreadCounts())
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+unsigned int FieldProbe::getComponentCounts(unsigned int fields)
+{
+    unsigned int counts = 0;
+    if (fields & PROBE_DENSITY) counts += 1;
+    if (fields & PROBE_PRESSURE) counts += 1;
+    if (fields & PROBE_VELOCITY) counts += 3;
+    return counts;
+}
+
+void FieldProbe::_sortProbes(const SPHSystem &system, const glm::vec3 *points, unsigned int counts)
+{
+    TRACE_SCOPE("sort probes");
+
+    const ParticleGridContainer& grid = system.getGridContainer();
+    const glm::ivec3 gridRes = *grid.getGridRes();
+    const glm::vec3 gridMin = *grid.getGridMin();
+    const glm::vec3 gridDelta = glm::vec3(gridRes) / *grid.getGridSize();
+    unsigned int cellCounts = grid.getCellCounts();
+
+    //probes off the grid go to the extra bucket at the end, they keep their place in the order
+    m_probeCells.resize(counts);
+    for (unsigned int i = 0; i < counts; i++)
+    {
+        glm::ivec3 cell = glm::ivec3((points[i] - gridMin) * gridDelta);
+        bool inside = cellCounts > 0 && cell.x >= 0 && cell.y >= 0 && cell.z >= 0 &&
+                      cell.x < gridRes.x && cell.y < gridRes.y && cell.z < gridRes.z;
+        m_probeCells[i] = inside ? (unsigned int)((cell.z * gridRes.y + cell.y) * gridRes.x + cell.x) : cellCounts;
+    }
+
+    //counting sort, stable so probes of one cell stay in input order
+    m_cellStarts.assign(cellCounts + 2, 0);
+    for (unsigned int i = 0; i < counts; i++) m_cellStarts[m_probeCells[i] + 1]++;
+    for (unsigned int c = 0; c <= cellCounts; c++) m_cellStarts[c + 1] += m_cellStarts[c];
+
+    m_order.resize(counts);
+    for (unsigned int i = 0; i < counts; i++) m_order[m_cellStarts[m_probeCells[i]]++] = i;
+}
+
+void FieldProbe::sample(const SPHSystem &system, const glm::vec3 *points, unsigned int counts, unsigned int fields, float *out)
+{
+    TRACE_SCOPE("sample probes");
+
+    auto start = std::chrono::steady_clock::now();
+    _sortProbes(system, points, counts);
+    auto sorted = std::chrono::steady_clock::now();
+
+    const ParticleGridContainer& grid = system.getGridContainer();
+    const Particle* particles = system.getParticles();
+    const glm::ivec3 gridRes = *grid.getGridRes();
+    const glm::vec3 gridMin = *grid.getGridMin();
+    const glm::vec3 gridDelta = glm::vec3(gridRes) / *grid.getGridSize();
+    const bool hasGrid = grid.getCellCounts() > 0;
+
+    const float unitScale = system.getUnitScale();
+    const unsigned int components = getComponentCounts(fields);
+    const bool needsVolume = (fields & (PROBE_PRESSURE | PROBE_VELOCITY)) != 0;
+
+    //a probe has the base radius, with particles of their own mass and radius a pair uses the mean of both radii
+    //like the adaptive density pass. W(r, h) = 315 / (64 pi h^9) * (h^2 - r^2)^3
+    const float poly6 = 315.0f / (64.0f * 3.141592f);
+    const float* masses = system.getPointMasses();
+    const float* radii = system.getPointSmoothRadii();
+    const bool uniform = system.isUniformMass();
+    const float probeRadius = system.getSmoothRadius() * unitScale;
+    float maxRadius = probeRadius;
+    if (!uniform)
+    {
+        for (unsigned int i = 0; i < system.getPointCounts(); i++) maxRadius = std::max(maxRadius, radii[i]);
+    }
+    const float baseH2 = probeRadius * probeRadius;
+    const float massPoly6 = system.getParticleMass() * system.getKernelPoly6();
+
+    //particles moved by one step since the grid was built, widen the searched cells by that distance
+    const float radius = 0.5f * (probeRadius + maxRadius) / unitScale + system.getDiagnostics().maxSpeed * system.getDeltaTime() / unitScale;
+
+    m_taskPool.parallelFor(counts, [&](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        WorkerCounters& counters = m_workerCounters[worker];
+        counters.outsideProbeCounts = 0;
+        counters.visitedPointCounts = 0;
+        counters.neighborCounts = 0;
+
+        for (unsigned int k = begin; k < end; k++)
+        {
+            unsigned int probe = m_order[k];
+            const glm::vec3 p = points[probe];
+
+            float density = 0.f;
+            float pressure = 0.f;
+            glm::vec3 velocity(0.f);
+
+            glm::ivec3 cellMin = glm::ivec3(glm::floor((p - radius - gridMin) * gridDelta));
+            glm::ivec3 cellMax = glm::ivec3(glm::floor((p + radius - gridMin) * gridDelta));
+            cellMin = glm::max(cellMin, glm::ivec3(0));
+            cellMax = glm::min(cellMax, gridRes - 1);
+
+            if (!hasGrid || cellMin.x > cellMax.x || cellMin.y > cellMax.y || cellMin.z > cellMax.z)
+            {
+                counters.outsideProbeCounts++;
+            }
+            else
+            {
+                for (int z = cellMin.z; z <= cellMax.z; z++)
+                for (int y = cellMin.y; y <= cellMax.y; y++)
+                for (int x = cellMin.x; x <= cellMax.x; x++)
+                {
+                    int pndx = grid.getGridData((z * gridRes.y + y) * gridRes.x + x);
+                    while (pndx != -1)
+                    {
+                        const Particle* pj = particles + pndx;
+                        counters.visitedPointCounts++;
+
+                        glm::vec3 p_pj = (p - pj->pos) * unitScale;
+                        float r2 = glm::dot(p_pj, p_pj);
+                        float h2 = baseH2;
+                        if (!uniform)
+                        {
+                            float h = 0.5f * (probeRadius + radii[pndx]);
+                            h2 = h * h;
+                        }
+                        if (h2 > r2)
+                        {
+                            //same weight as the density pass, m * kernelPoly6 * (h^2-r^2)^3
+                            float h2_r2 = h2 - r2;
+                            float weight;
+                            if (uniform) weight = massPoly6 * h2_r2 * h2_r2 * h2_r2;
+                            else
+                            {
+                                float invH3 = 1.f / (h2 * std::sqrt(h2));
+                                weight = poly6 * masses[pndx] * h2_r2 * h2_r2 * h2_r2 * invH3 * invH3 * invH3;
+                            }
+                            density += weight;
+                            if (needsVolume && pj->density > 0.f)
+                            {
+                                float volumeWeight = weight / pj->density;
+                                pressure += volumeWeight * pj->pressure;
+                                velocity += volumeWeight * pj->velocity;
+                            }
+                            counters.neighborCounts++;
+                        }
+                        pndx = pj->next;
+                    }
+                }
+            }
+
+            float* result = out + (size_t)probe * components;
+            if (fields & PROBE_DENSITY) *result++ = density;
+            if (fields & PROBE_PRESSURE) *result++ = pressure;
+            if (fields & PROBE_VELOCITY)
+            {
+                *result++ = velocity.x;
+                *result++ = velocity.y;
+                *result++ = velocity.z;
+            }
+        }
+    });
+    auto sampled = std::chrono::steady_clock::now();
+
+    m_stats.probeCounts = counts;
+    m_stats.outsideProbeCounts = 0;
+    m_stats.visitedPointCounts = 0;
+    m_stats.neighborCounts = 0;
+    for (const WorkerCounters& counters : m_workerCounters)
+    {
+        m_stats.outsideProbeCounts += counters.outsideProbeCounts;
+        m_stats.visitedPointCounts += counters.visitedPointCounts;
+        m_stats.neighborCounts += counters.neighborCounts;
+    }
+    m_stats.sortTime = elapsedMs(start, sorted);
+    m_stats.sampleTime = elapsedMs(sorted, sampled);
+    m_stats.totalTime = elapsedMs(start, sampled);
+    m_stats.timePerProbe = counts > 0 ? m_stats.totalTime * 1000.f / counts : 0.f;
+}
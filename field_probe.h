@@ -0,0 +1,78 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_FIELD_PROBE_H
+#define SIMPLE_FLUID_SIMULATOR_FIELD_PROBE_H
+
+#include "task_pool.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class SPHSystem;
+
+/** fields a probe can sample, or them together. the components of the selected fields follow each other in
+ *  this order in the output of every probe */
+enum ProbeField
+{
+    PROBE_DENSITY = 1,                  // 1 float, kg per m^3
+    PROBE_PRESSURE = 2,                 // 1 float
+    PROBE_VELOCITY = 4,                 // 3 floats, metres per second
+};
+
+/** counters and timers of the last sample */
+struct ProbeStats
+{
+    unsigned int probeCounts;
+    unsigned int outsideProbeCounts;    // probes too far from the grid to have neighbors
+    unsigned int visitedPointCounts;    // particles of the searched cells
+    unsigned int neighborCounts;        // particles within the smoothing radius
+    float sortTime;                     // ms
+    float sampleTime;                   // ms
+    float totalTime;                    // ms
+    float timePerProbe;                 // us
+};
+
+/** evaluates the SPH interpolant of density, pressure and velocity at arbitrary points.
+ *  the probes are sorted by grid cell first, so neighboring probes walk the same cells of ParticleGridContainer
+ *  one after another, then sampled in parallel on a task pool. density uses the poly6 kernel exactly as the
+ *  density pass of tick does, a probe has the base radius and pairs with particles of their own mass and radius
+ *  use the mean radius like the adaptive pass. the other fields are weighted by mass over density of every neighbor */
+class FieldProbe
+{
+public:
+    /** sample counts points given in world units, out gets getComponentCounts(fields) floats per point.
+     *  reads the grid built by the last tick, the system must not tick meanwhile */
+    void sample(const SPHSystem& system, const glm::vec3* points, unsigned int counts, unsigned int fields, float* out);
+
+    const ProbeStats& getStats() const { return m_stats; }
+    unsigned int getThreadCounts() const { return m_taskPool.getThreadCounts(); }
+
+    /** floats written per probe for a set of fields */
+    static unsigned int getComponentCounts(unsigned int fields);
+
+private:
+    void _sortProbes(const SPHSystem& system, const glm::vec3* points, unsigned int counts);
+
+private:
+    struct WorkerCounters
+    {
+        unsigned int outsideProbeCounts;
+        unsigned int visitedPointCounts;
+        unsigned int neighborCounts;
+    };
+
+    TaskPool m_taskPool;
+
+    std::vector<unsigned int> m_cellStarts;         // counting sort buckets, one per cell and one for outside
+    std::vector<unsigned int> m_probeCells;
+    std::vector<unsigned int> m_order;              // probes sorted by cell
+    std::vector<WorkerCounters> m_workerCounters;
+    ProbeStats m_stats;
+
+public:
+    explicit FieldProbe(unsigned int threadCounts);
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_FIELD_PROBE_H
@@ -0,0 +1,148 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "image_writer.h"
+#include "trace.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <glfw/deps/stb_image_write.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+ImageWriter::ImageWriter()
+        : m_width(0)
+        , m_height(0)
+        , m_format(FORMAT_PNG)
+        , m_quit(false)
+        , m_submittedFrameCounts(0)
+        , m_waitTime(0.0)
+        , m_frameCounts(0)
+        , m_failedFrameCounts(0)
+        , m_encodeMicroseconds(0)
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+    close();
+}
+
+bool ImageWriter::open(const char *prefix, unsigned int width, unsigned int height, Format format, unsigned int slotCounts)
+{
+    close();
+    if (width == 0 || height == 0) return false;
+
+    m_prefix = prefix;
+    m_width = width;
+    m_height = height;
+    m_format = format;
+
+    if (slotCounts == 0) slotCounts = 1;
+    m_slots.assign(slotCounts, std::vector<unsigned char>((size_t)width * height * 4));
+    m_slotFrames.assign(slotCounts, 0);
+    m_freeSlots.clear();
+    m_readySlots.clear();
+    for (unsigned int i = 0; i < slotCounts; i++) m_freeSlots.push_back(i);
+
+    m_quit = false;
+    m_submittedFrameCounts = 0;
+    m_waitTime = 0.0;
+    m_frameCounts = 0;
+    m_failedFrameCounts = 0;
+    m_encodeMicroseconds = 0;
+
+    m_thread = std::thread(&ImageWriter::_writerLoop, this);
+    return true;
+}
+
+void ImageWriter::submit(const unsigned char *pixels)
+{
+    if (!isOpen()) return;
+
+    unsigned int slot;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_freeSlots.empty())
+        {
+            TRACE_SCOPE("wait for encoder");
+            auto start = std::chrono::steady_clock::now();
+            m_cond.wait(lock, [&] { return !m_freeSlots.empty(); });
+            m_waitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        slot = m_freeSlots.front();
+        m_freeSlots.pop_front();
+    }
+
+    //flip while copying, image files start with the top row
+    std::vector<unsigned char>& image = m_slots[slot];
+    size_t rowBytes = (size_t)m_width * 4;
+    for (unsigned int y = 0; y < m_height; y++)
+    {
+        memcpy(&image[(m_height - 1 - y) * rowBytes], pixels + y * rowBytes, rowBytes);
+    }
+    m_slotFrames[slot] = m_submittedFrameCounts++;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_readySlots.push_back(slot);
+    }
+    m_cond.notify_all();
+}
+
+void ImageWriter::close()
+{
+    if (!isOpen()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void ImageWriter::_writerLoop()
+{
+    TraceRecorder::get()->setThreadName("image writer");
+
+    for (;;)
+    {
+        unsigned int slot;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return !m_readySlots.empty() || m_quit; });
+            if (m_readySlots.empty()) return;   //quit and nothing left
+            slot = m_readySlots.front();
+            m_readySlots.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!_encode(m_slotFrames[slot], m_slots[slot])) m_failedFrameCounts++;
+        m_encodeMicroseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        m_frameCounts++;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_freeSlots.push_back(slot);
+        }
+        m_cond.notify_all();
+    }
+}
+
+bool ImageWriter::_encode(unsigned int frame, const std::vector<unsigned char> &pixels)
+{
+    TRACE_SCOPE("encode image");
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s_%06u.%s", m_prefix.c_str(), frame, m_format == FORMAT_PNG ? "png" : "tga");
+
+    if (m_format == FORMAT_PNG)
+    {
+        return stbi_write_png(path, (int)m_width, (int)m_height, 4, pixels.data(), (int)m_width * 4) != 0;
+    }
+    return stbi_write_tga(path, (int)m_width, (int)m_height, 4, pixels.data()) != 0;
+}
@@ -0,0 +1,79 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_IMAGE_WRITER_H
+#define SIMPLE_FLUID_SIMULATOR_IMAGE_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** encodes a sequence of RGBA frames to numbered image files on a background thread.
+ *  submit copies the pixels into a free slot, it only waits when every slot is still being encoded */
+class ImageWriter
+{
+public:
+    enum Format
+    {
+        FORMAT_PNG,
+        FORMAT_TGA,                     // run length encoded, much cheaper to encode than png
+    };
+
+    /** files are written to <prefix>_000000.png, <prefix>_000001.png, ... */
+    bool open(const char* prefix, unsigned int width, unsigned int height, Format format, unsigned int slotCounts = 4);
+    /** queue a frame with the bottom row first, as returned by glReadPixels */
+    void submit(const unsigned char* pixels);
+    /** encode the pending frames and stop the thread */
+    void close();
+    bool isOpen() const { return m_thread.joinable(); }
+
+    unsigned int getSubmittedFrameCounts() const { return m_submittedFrameCounts; }
+    unsigned int getFrameCounts() const { return m_frameCounts.load(); }
+    unsigned int getFailedFrameCounts() const { return m_failedFrameCounts.load(); }
+    /** seconds the writer thread spent encoding */
+    double getEncodeTime() const { return m_encodeMicroseconds.load() * 1e-6; }
+    /** seconds submit waited for a free slot */
+    double getWaitTime() const { return m_waitTime; }
+
+private:
+    void _writerLoop();
+    bool _encode(unsigned int frame, const std::vector<unsigned char>& pixels);
+
+private:
+    std::string m_prefix;
+    unsigned int m_width;
+    unsigned int m_height;
+    Format m_format;
+
+    std::vector<std::vector<unsigned char>> m_slots;
+    std::vector<unsigned int> m_slotFrames;
+    std::deque<unsigned int> m_freeSlots;
+    std::deque<unsigned int> m_readySlots;    // in submit order
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_quit;
+
+    ////// submitting thread only
+    unsigned int m_submittedFrameCounts;
+    double m_waitTime;
+
+    std::atomic<unsigned int> m_frameCounts;
+    std::atomic<unsigned int> m_failedFrameCounts;
+    std::atomic<uint64_t> m_encodeMicroseconds;
+
+public:
+    ImageWriter();
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_IMAGE_WRITER_H
@@ -15,9 +15,38 @@
 #include <shader.h>
 #include <camera.h>
 #include <model.h>
+#include <instance_buffer.h>
+#include <gpu_timer.h>
+#include <sphere_mesh.h>
+#include <frame_capture.h>
+#ifdef SPH_OFFSCREEN_EGL
+#include <headless_context.h>
+#endif
 #include "sph_system.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "trajectory.h"
+#include "trajectory_player.h"
+#include "simulation_thread.h"
+#include "particle_culler.h"
+#include "state_interpolator.h"
+#include "image_writer.h"
+#include "surface_extractor.h"
+#include "point_export.h"
+#include "shared_frame_publisher.h"
+#include "mesh_seeder.h"
+#include "asset_cache.h"
 
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
@@ -37,7 +66,69 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 const unsigned int MAX_PARTICLE_COUNTS = 4096;
-SPHSystem*				g_pSPHSystem = nullptr;
+const unsigned int STATS_DUMP_INTERVAL = 60;    // ticks between two stats records
+int                     g_traceFrameCounts = 120;   // frames written by a trace dump
+const char*             CHECKPOINT_PATH = "sph_checkpoint.bin";
+const unsigned int      CHECKPOINT_INTERVAL = 600;  // ticks between two autosaves
+CheckpointWriter        g_checkpointWriter;         // simulation thread only
+std::atomic<bool>       g_autosaveCheckpoint{ false };
+std::atomic<uint64_t>   g_autosaveBytes{ 0 };       // written by the last autosave
+const char*             TRAJECTORY_PATH = "sph_trajectory.bin";
+const unsigned int      TRAJECTORY_INTERVAL = 4;    // ticks between two trajectory frames
+TrajectoryWriter        g_trajectoryWriter;         // opened and closed on the simulation thread
+bool                    g_recordTrajectory = false;
+TrajectoryPlayer        g_trajectoryPlayer;         // replaces the simulation while open
+int                     g_playbackFrame = 0;
+int                     g_playbackDirection = 0;    // 1 forward, -1 backward, 0 paused
+std::vector<glm::vec3>  g_playbackPositions;
+SPHSystem*				g_pSPHSystem = nullptr;    // owned by g_simulationThread once it runs
+SimulationThread        g_simulationThread;
+SPHStatsWriter          g_statsWriter;              // simulation thread only
+enum RenderMode
+{
+    RENDER_MESH,                                    // instanced water.obj
+    RENDER_IMPOSTOR,                                // ray cast sphere on a quad
+};
+int                     g_renderMode = RENDER_MESH;
+bool                    g_cullingEnabled = true;
+float                   g_lodDistances[CULL_LOD_COUNTS - 1] = { 60.f, 120.f };
+bool                    g_surfaceOnly = false;      // draw the surface particles and a sample of the interior
+int                     g_interiorStride = 16;      // every n-th interior particle is kept, 0 for none
+std::vector<unsigned char> g_renderSelection;
+std::vector<unsigned int> g_renderIndices;
+const char*             POINTS_PATH = "sph_points.ply";
+const float             PLAYBACK_CULL_CELL_SIZE = 5.f;  // trajectories don't store the grid
+int                     g_interpolationMode = StateInterpolator::MODE_INTERPOLATE;
+float                   g_simulationTickRate = 0.f;     // ticks per second, 0 for as fast as possible
+const char*             SURFACE_PATH = "sph_surface.obj";
+const unsigned int      SURFACE_INTERVAL = 10;      // ticks between two surface extractions
+SurfaceExtractor        g_surfaceExtractor(std::thread::hardware_concurrency());   // simulation thread only
+std::atomic<bool>       g_extractSurface{ false };
+std::mutex              g_surfaceStatsMutex;
+SurfaceStats            g_surfaceStats;             // of the last extraction
+// offscreen mode renders into a framebuffer object and writes every frame to an image, see main
+bool                    g_offscreen = false;
+unsigned int            g_offscreenFrameCounts = 300;
+unsigned int            g_offscreenTickInterval = 1;    // ticks between two images
+const char*             g_offscreenPrefix = "sph_frame";
+ImageWriter::Format     g_offscreenFormat = ImageWriter::FORMAT_PNG;
+// frames published to shared memory for viewers in other processes, or shown from there in reader mode
+const char*             g_sharedFrameName = "/sph_frames";
+SharedFramePublisher    g_sharedFramePublisher;     // simulation thread only
+std::atomic<double>     g_sharedPublishTime{ 0.0 };     // microseconds per frame
+bool                    g_headless = false;
+uint64_t                g_headlessTickCounts = 0;   // 0 runs until interrupted
+std::atomic<bool>       g_headlessQuit{ false };
+bool                    g_readerMode = false;
+SharedFrameReader       g_sharedFrameReader;
+SharedFrame             g_readerFrame = {};         // last frame copied in reader mode
+std::vector<glm::vec3>  g_readerPositions;
+double                  g_readerOpenTime = 0.0;
+// meshes and program binaries of earlier starts, keyed by the content of their sources
+AssetCache              g_assetCache;
+// the initial fluid takes the shape of a closed mesh instead of a box
+MeshSeeder              g_meshSeeder(std::thread::hardware_concurrency());
+std::vector<glm::vec3>  g_seedPositions;
 glm::vec3 			    g_wallMin{ -25, 00, -25 };
 glm::vec3 			    g_wallMax{ 25, 30, 25 };
 
@@ -46,7 +137,75 @@ void resetSPHSystem()
     glm::vec3 fluid_min{ -15, 5, -15 };
     glm::vec3 fluid_max{ 15, 28, 15 };
     glm::vec3 gravity{ 0.0, -9.8f, 0 };
-    g_pSPHSystem->init(MAX_PARTICLE_COUNTS, g_wallMin, g_wallMax, fluid_min, fluid_max, gravity);
+    if (g_meshSeeder.isEmpty())
+    {
+        g_pSPHSystem->init(MAX_PARTICLE_COUNTS, g_wallMin, g_wallMax, fluid_min, fluid_max, gravity);
+        return;
+    }
+
+    //an inverted fluid box holds no particles, the mesh is fitted into the box instead
+    g_pSPHSystem->init(MAX_PARTICLE_COUNTS, g_wallMin, g_wallMax, fluid_max, fluid_min, gravity);
+    g_meshSeeder.seed(ParticleBox3(fluid_min, fluid_max), g_pSPHSystem->getPointDistance(), g_seedPositions);
+    unsigned int addedCounts = g_pSPHSystem->addParticles(g_seedPositions.data(), (unsigned int)g_seedPositions.size());
+
+    const SeedStats& stats = g_meshSeeder.getStats();
+    printf("seeded %u particles (%u placed) from %u triangles in %.2f ms, bin %.2f ms, fill %.2f ms, %u unclosed rows\n",
+           addedCounts, stats.pointCounts, stats.triangleCounts, stats.totalTime, stats.binTime, stats.fillTime,
+           stats.unclosedRowCounts);
+}
+
+// reads the triangles of every mesh in the file through assimp, as Model does but without creating GL buffers
+bool loadSeedMesh(const char* path)
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_PreTransformVertices);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    g_meshSeeder.clear();
+    std::vector<unsigned int> indices;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        indices.clear();
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+        {
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3) continue;    //points and lines
+            indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
+        }
+        g_meshSeeder.addMesh((const glm::vec3*)mesh->mVertices, mesh->mNumVertices, sizeof(aiVector3D),
+                             indices.data(), (unsigned int)indices.size());
+    }
+    return !g_meshSeeder.isEmpty();
+}
+
+// runs on the simulation thread after every tick
+void onSimulationTick(SPHSystem* system)
+{
+    if (system->isStatsEnabled()) g_statsWriter.update(system->getStats());
+    if (g_autosaveCheckpoint && system->getStats().tickCounts % CHECKPOINT_INTERVAL == 0)
+    {
+        CheckpointState state;
+        system->getCheckpointState(state);
+        g_checkpointWriter.write(CHECKPOINT_PATH, state, true);
+        g_autosaveBytes = g_checkpointWriter.getLastWrittenBytes();
+    }
+    g_trajectoryWriter.record(*system);
+    if (g_sharedFramePublisher.isOpen())
+    {
+        g_sharedFramePublisher.publish(*system);
+        g_sharedPublishTime = g_sharedFramePublisher.getAveragePublishTime();
+    }
+    if (g_extractSurface && system->getStats().tickCounts % SURFACE_INTERVAL == 0)
+    {
+        g_surfaceExtractor.extract(*system);
+        std::lock_guard<std::mutex> lock(g_surfaceStatsMutex);
+        g_surfaceStats = g_surfaceExtractor.getStats();
+    }
 }
 
 SPHSystem* getSPHSystem()
@@ -55,55 +214,203 @@ SPHSystem* getSPHSystem()
     return &s_theSystem;
 }
 
-int main()
+// Simple_Fluid_Simulator [--offscreen] [--frames N] [--tick-interval N] [--output prefix] [--format png|tga]
+//                        [--impostor] [--surface-only] [--seed-model path [--seed-parity] [--seed-jitter]]
+//                        [--no-asset-cache] [--adaptive]
+// Simple_Fluid_Simulator --headless [--ticks N] [--publish name]
+// Simple_Fluid_Simulator --reader [name]
+//
+// --offscreen renders frames images without showing a window, one every tick-interval ticks, and reports the
+// frames per second of the simulation, the rendering and the encoding. Without a display it falls back to a
+// surfaceless EGL context, so it also runs on llvmpipe in a container.
+//
+// --headless runs the simulation without a window until it is interrupted or ran N ticks. With --publish
+// every tick goes to the shared memory segment name, where --reader shows it from another process, so a
+// crashed viewer doesn't take a long run down.
+//
+// Meshes and linked shader programs are kept in asset_cache/ after the first start, --no-asset-cache builds
+// them from the sources every time. The startup time is printed either way.
+//
+// --seed-model fills the inside of a closed mesh with the initial fluid, in every mode. The mesh is scaled to
+// fit the initial fluid box. Inside is a nonzero winding number, or an odd number of surfaces with
+// --seed-parity for meshes with inconsistent winding. --seed-jitter moves the particles off the lattice.
+//
+// --adaptive splits particles near the surface and in vortices and merges them in calm bulk fluid, see
+// SPHSystem::setAdaptiveResolution.
+static void onInterrupt(int)
+{
+    g_headlessQuit = true;
+}
+
+static int runHeadless()
 {
+    g_pSPHSystem = getSPHSystem();
+    resetSPHSystem();
+
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+    g_simulationThread.setTickCallback(onSimulationTick);
+    g_simulationThread.start(g_pSPHSystem);
+
+    uint64_t lastTickCounts = 0;
+    while (!g_headlessQuit)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        const SimulationSnapshot& snapshot = g_simulationThread.acquireSnapshot();
+        double publishTime = g_sharedPublishTime;
+        printf("tick %llu, %llu ticks/s, tick %.3f ms, publish %.1f us (%.2f%% of a tick)\n",
+               (unsigned long long)snapshot.tickCounts, (unsigned long long)(snapshot.tickCounts - lastTickCounts),
+               snapshot.stats.tickTime, publishTime,
+               snapshot.stats.tickTime > 0.f ? 0.1 * publishTime / snapshot.stats.tickTime : 0.0);
+        lastTickCounts = snapshot.tickCounts;
+        if (g_headlessTickCounts > 0 && snapshot.tickCounts >= g_headlessTickCounts) break;
+    }
+
+    g_simulationThread.stop();
+    g_sharedFramePublisher.close();
+    g_trajectoryWriter.close();
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--offscreen")) g_offscreen = true;
+        else if (!strcmp(argv[i], "--frames") && hasValue) g_offscreenFrameCounts = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--tick-interval") && hasValue) g_offscreenTickInterval = (unsigned int)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--output") && hasValue) g_offscreenPrefix = argv[++i];
+        else if (!strcmp(argv[i], "--format") && hasValue)
+        {
+            g_offscreenFormat = !strcmp(argv[++i], "tga") ? ImageWriter::FORMAT_TGA : ImageWriter::FORMAT_PNG;
+        }
+        else if (!strcmp(argv[i], "--impostor")) g_renderMode = RENDER_IMPOSTOR;
+        else if (!strcmp(argv[i], "--surface-only")) g_surfaceOnly = true;
+        else if (!strcmp(argv[i], "--headless")) g_headless = true;
+        else if (!strcmp(argv[i], "--ticks") && hasValue) g_headlessTickCounts = (uint64_t)std::atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--publish") && hasValue)
+        {
+            g_sharedFrameName = argv[++i];
+            if (!g_sharedFramePublisher.open(g_sharedFrameName))
+            {
+                std::cout << "Failed to create shared memory " << g_sharedFrameName << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--seed-model") && hasValue)
+        {
+            const char* path = argv[++i];
+            if (!loadSeedMesh(path))
+            {
+                std::cout << "Failed to load a mesh from " << path << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--no-asset-cache")) g_assetCache.setDirectory("");
+        else if (!strcmp(argv[i], "--seed-parity")) g_meshSeeder.setFillRule(SEED_PARITY);
+        else if (!strcmp(argv[i], "--seed-jitter")) g_meshSeeder.setLayout(SEED_JITTER);
+        else if (!strcmp(argv[i], "--adaptive")) getSPHSystem()->setAdaptiveResolution(true);
+        else if (!strcmp(argv[i], "--reader"))
+        {
+            g_readerMode = true;
+            if (hasValue && argv[i + 1][0] != '-') g_sharedFrameName = argv[++i];
+        }
+        else
+        {
+            std::cout << "unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+
+    if (g_headless) return runHeadless();
+
+    // assets are read on a worker while the window, GL and the simulation start, GL objects are made after that.
+    // returning early waits for the worker in the destructor of the future
+    auto startupBegin = std::chrono::steady_clock::now();
+    ShaderSource particleShaderSource;
+    ShaderSource impostorShaderSource;
+    ModelData waterModelData;
+    double assetLoadTime = 0.0;
+    std::future<void> assetsLoaded = std::async(std::launch::async, [&]()
+    {
+        auto begin = std::chrono::steady_clock::now();
+        particleShaderSource.read("../resources/waterParticle.vs", "../resources/waterParticle.fs");
+        impostorShaderSource.read("../resources/waterImpostor.vs", "../resources/waterImpostor.fs");
+        Model::loadData("../resources/water.obj", waterModelData, &g_assetCache);
+        assetLoadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    });
+
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+    GLFWwindow* window = NULL;
     const char* glsl_version = "#version 130";
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (glfwInit())
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, g_offscreen ? GLFW_FALSE : GLFW_TRUE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Simple Fluid Simulator By Long Liu", NULL, NULL);
-    if (window == NULL)
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Simple Fluid Simulator By Long Liu", NULL, NULL);
+    }
+
+    GLADloadproc loadProc = (GLADloadproc)glfwGetProcAddress;
+    bool hasContext = window != NULL;
+#ifdef SPH_OFFSCREEN_EGL
+    // no display to open a window on
+    HeadlessContext headlessContext;
+    if (!hasContext && g_offscreen && headlessContext.create(3, 3))
+    {
+        loadProc = (GLADloadproc)HeadlessContext::getProcAddress;
+        hasContext = true;
+    }
+#endif
+    if (!hasContext)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    if (window)
+    {
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    }
 
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!gladLoadGLLoader(loadProc))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
 
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+    if (!g_offscreen)
+    {
+        // Setup Dear ImGui context
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+        //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
 
-    // Setup Dear ImGui style
-    ImGui::StyleColorsDark();
-    //ImGui::StyleColorsClassic();
+        // Setup Dear ImGui style
+        ImGui::StyleColorsDark();
+        //ImGui::StyleColorsClassic();
 
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
+        // Setup Platform/Renderer backends
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init(glsl_version);
+    }
 
     glEnable(GL_DEPTH_TEST);
 
@@ -111,96 +418,266 @@ int main()
     g_pSPHSystem = getSPHSystem();
     resetSPHSystem();
 
-    Shader waterParticleShader(
-            "../resources/waterParticle.vs",
-            "../resources/waterParticle.fs");
+    auto waitBegin = std::chrono::steady_clock::now();
+    assetsLoaded.get();
+    auto createBegin = std::chrono::steady_clock::now();
+
+    Shader waterParticleShader(particleShaderSource, &g_assetCache, loadProc);
+
+    Model waterParticle(waterModelData);
+
+    // the impostor quad corners come from gl_VertexID, only the instance positions are attributes
+    Shader waterImpostorShader(impostorShaderSource, &g_assetCache, loadProc);
+
+    auto createEnd = std::chrono::steady_clock::now();
+    printf("startup %.1f ms: assets %.1f ms on the worker, %.1f ms waited for them, %.1f ms to create GL objects, "
+           "cache %s (%u hits, %u misses, %u stored)\n",
+           std::chrono::duration<double, std::milli>(createEnd - startupBegin).count(), assetLoadTime,
+           std::chrono::duration<double, std::milli>(createBegin - waitBegin).count(),
+           std::chrono::duration<double, std::milli>(createEnd - createBegin).count(),
+           !g_assetCache.isEnabled() ? "off" : (g_assetCache.getMissCounts() > 0 ? "cold" : "warm"),
+           g_assetCache.getHitCounts(), g_assetCache.getMissCounts(), g_assetCache.getStoreCounts());
+    unsigned int impostorVAO;
+    glGenVertexArrays(1, &impostorVAO);
+    GpuTimer drawTimer;
 
-    Model waterParticle("../resources/water.obj");
+    // lod 0 is water.obj, the farther buckets use coarser spheres
+    SphereMesh lodSpheres[CULL_LOD_COUNTS - 1];
+    lodSpheres[0].init(10, 6);
+    lodSpheres[1].init(6, 4);
+    unsigned int lodVAOs[CULL_LOD_COUNTS] = { waterParticle.meshes[0].VAO, lodSpheres[0].VAO, lodSpheres[1].VAO };
+    unsigned int lodIndexCounts[CULL_LOD_COUNTS] = { (unsigned int)waterParticle.meshes[0].indices.size(),
+                                                    lodSpheres[0].indexCounts, lodSpheres[1].indexCounts };
+    ParticleCuller culler(std::thread::hardware_concurrency());
 
+    // instance positions, the vertex shader scales and moves the sphere
     unsigned int amount = g_pSPHSystem->getPointCounts();
-    glm::mat4* modelMatrices;
-    modelMatrices = new glm::mat4[amount];
-    const glm::vec3 * p = g_pSPHSystem->getPointBuf();
     float sphere_scale = 0.08f;
-    for (unsigned int i = 0; i < amount; i++)
+    InstanceBuffer instanceBuffer;
+    instanceBuffer.init(amount, loadProc, 2);     // offset and delta, see StateInterpolator
+    StateInterpolator interpolator;
+
+    // offscreen frames are read back through a ring of pixel buffers and encoded on the image writer thread
+    FrameCapture frameCapture;
+    ImageWriter imageWriter;
+    unsigned int renderedFrameCounts = 0;
+    uint64_t nextCaptureTick = 0;
+    double renderBusyTime = 0.0;        // seconds from the snapshot to the hand over to the image writer
+    if (g_offscreen)
     {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(p->x,p->y,p->z));
-        model = glm::scale(model, glm::vec3(sphere_scale));
-        modelMatrices[i] = model;
-        p = (const glm::vec3 *)(((const char*)p) + g_pSPHSystem->getPointStride());
+        if (!frameCapture.init(SCR_WIDTH, SCR_HEIGHT) ||
+            !imageWriter.open(g_offscreenPrefix, SCR_WIDTH, SCR_HEIGHT, g_offscreenFormat))
+        {
+            std::cout << "Failed to set up offscreen rendering" << std::endl;
+            return -1;
+        }
     }
 
+    TraceRecorder::get()->setThreadName("main");
 
-    unsigned int buffer;
-    glGenBuffers(1, &buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_DYNAMIC_DRAW);
+    g_simulationThread.setTickCallback(onSimulationTick);
+    // the frames come from another process, the own system rests
+    if (g_readerMode) g_simulationThread.setPaused(true);
+    g_simulationThread.start(g_pSPHSystem);
+    double startTime = SimulationThread::getWallTime();
 
-    unsigned int VAO = waterParticle.meshes[0].VAO;
-    glBindVertexArray(VAO);
-    // set attribute pointers for matrix (4 times vec4)
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
+    while (g_offscreen ? renderedFrameCounts < g_offscreenFrameCounts : !glfwWindowShouldClose(window))
+    {
+        TraceRecorder::get()->nextFrame();
 
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-    glVertexAttribDivisor(5, 1);
-    glVertexAttribDivisor(6, 1);
+        // every image shows a different tick
+        while (g_offscreen && g_simulationThread.acquireSnapshot().tickCounts < nextCaptureTick)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        double frameStartTime = SimulationThread::getWallTime();
 
-    glBindVertexArray(0);
+        // the latest finished tick, it stays valid until the next acquire
+        const SimulationSnapshot& snapshot = g_simulationThread.acquireSnapshot();
 
-    while (!glfwWindowShouldClose(window))
-    {
-        g_pSPHSystem->tick();
-        const glm::vec3 * p = g_pSPHSystem->getPointBuf();
-        for (int i = 0; i < amount; ++i)
+        CullGrid grid;
+        if (g_trajectoryPlayer.isOpen())
+        {
+            // move on once the current frame was shown, a frame which is not decoded yet keeps the previous one
+            int lastFrame = (int)g_trajectoryPlayer.getFrameCounts() - 1;
+            g_trajectoryPlayer.request((unsigned int)g_playbackFrame, g_playbackDirection < 0 ? -1 : 1);
+            if (g_trajectoryPlayer.copyFrame((unsigned int)g_playbackFrame, g_playbackPositions.data()))
+            {
+                g_playbackFrame += g_playbackDirection;
+                if (g_playbackFrame < 0 || g_playbackFrame > lastFrame)
+                {
+                    g_playbackFrame = glm::clamp(g_playbackFrame, 0, lastFrame);
+                    g_playbackDirection = 0;
+                }
+            }
+            interpolator.setPositions(g_playbackPositions.data(), g_trajectoryPlayer.getPointCounts());
+
+            const TrajectoryHeader& header = g_trajectoryPlayer.getHeader();
+            grid = CullGrid::fromBox(glm::make_vec3(header.domainMin), glm::make_vec3(header.domainMax), PLAYBACK_CULL_CELL_SIZE);
+        }
+        else if (g_readerMode)
+        {
+            // map the segment again once a second while the publisher is gone, a restarted run makes a new one
+            if (!g_sharedFrameReader.isPublisherAlive() && frameStartTime - g_readerOpenTime > 1.0)
+            {
+                if (g_sharedFrameReader.open(g_sharedFrameName)) g_readerFrame.frame = 0;
+                g_readerOpenTime = frameStartTime;
+            }
+            SharedFrame frame;
+            if (g_sharedFrameReader.getLatestFrame() != g_readerFrame.frame &&
+                g_sharedFrameReader.copyLatest(frame, g_readerPositions, nullptr))
+            {
+                g_readerFrame = frame;
+            }
+            interpolator.setPositions(g_readerPositions.data(), (unsigned int)g_readerPositions.size());
+            grid = CullGrid::fromBox(g_readerFrame.domainMin, g_readerFrame.domainMax, PLAYBACK_CULL_CELL_SIZE);
+        }
+        else
+        {
+            interpolator.update(snapshot);
+            grid = snapshot.grid;
+        }
+
+        // a checkpoint or a trajectory may hold a different number of particles, the buffer grows on demand
+        amount = interpolator.getPointCounts();
+        const glm::vec3* points = interpolator.getPositions();
+
+        // the interior is hidden behind the surface particles, only a sample of it is drawn
+        const unsigned char* selection = nullptr;
+        unsigned int selectedCounts = amount;
+        if (g_surfaceOnly && !g_trajectoryPlayer.isOpen() && snapshot.surfaceFlags.size() == amount)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 translate = glm::translate(model, *p);
-            translate = glm::scale(translate,glm::vec3(sphere_scale));
-            modelMatrices[i] = translate;
-            p = (const glm::vec3 *)(((const char*)p) + g_pSPHSystem->getPointStride());
+            selectedCounts = selectSurfacePoints(snapshot.surfaceFlags.data(), amount, (unsigned int)g_interiorStride,
+                                                 g_renderSelection);
+            selection = g_renderSelection.data();
         }
 
-        // Send matrix data to GPU
-        glBindBuffer(GL_ARRAY_BUFFER, buffer);
-        void* data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-        memcpy(data, modelMatrices, sizeof(glm::mat4) * amount);
-        glUnmapBuffer(GL_ARRAY_BUFFER);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // a paused simulation shows the last tick as is
+        StateInterpolator::Mode interpolationMode = (StateInterpolator::Mode)g_interpolationMode;
+        if (g_trajectoryPlayer.isOpen() || g_readerMode || g_simulationThread.isPaused()) interpolationMode = StateInterpolator::MODE_LATEST;
+        float instanceBlend = interpolator.computeBlend(interpolationMode, SimulationThread::getWallTime());
 
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
+        float currentFrame = (float)(frameStartTime - startTime);
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        if (!g_offscreen) processInput(window);
+
+        // configure transformation matrices
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        // Send visible positions to GPU, bucket by bucket
+        unsigned int bucketBegin[CULL_LOD_COUNTS];
+        unsigned int bucketCounts[CULL_LOD_COUNTS];
+        unsigned int visibleCounts;
+        {
+            TRACE_SCOPE("upload");
+            if (g_cullingEnabled)
+            {
+                culler.setLodDistances(g_lodDistances[0], g_lodDistances[1]);
+                culler.cull(points, amount, grid, projection * view, camera.Position, sphere_scale, selection);
+
+                visibleCounts = culler.getVisibleCounts();
+                const std::vector<unsigned int>& indices = culler.getVisibleIndices();
+                glm::vec3* data = instanceBuffer.map(visibleCounts);
+                interpolator.gather(indices.data(), visibleCounts, data);
+                for (int lod = 0; lod < CULL_LOD_COUNTS; lod++)
+                {
+                    bucketBegin[lod] = culler.getBucketBegin(lod);
+                    bucketCounts[lod] = culler.getBucketCounts(lod);
+                }
+            }
+            else
+            {
+                visibleCounts = selectedCounts;
+                if (selection)
+                {
+                    g_renderIndices.clear();
+                    for (unsigned int i = 0; i < amount; i++)
+                    {
+                        if (selection[i]) g_renderIndices.push_back(i);
+                    }
+                }
+                glm::vec3* data = instanceBuffer.map(visibleCounts);
+                interpolator.gather(selection ? g_renderIndices.data() : nullptr, visibleCounts, data);
+                for (int lod = 0; lod < CULL_LOD_COUNTS; lod++)
+                {
+                    bucketBegin[lod] = lod == 0 ? 0 : visibleCounts;
+                    bucketCounts[lod] = lod == 0 ? visibleCounts : 0;
+                }
+            }
+            instanceBuffer.unmap();
+        }
 
         // render
         // ------
+        if (g_offscreen) frameCapture.bind();
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // configure transformation matrices
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        waterParticleShader.use();
-        waterParticleShader.setMat4("projection", projection);
-        waterParticleShader.setMat4("view", view);
+        {
+            TRACE_SCOPE("draw");
+            drawTimer.begin();
+            if (g_renderMode == RENDER_MESH)
+            {
+                waterParticleShader.use();
+                waterParticleShader.setMat4("projection", projection);
+                waterParticleShader.setMat4("view", view);
+                waterParticleShader.setFloat("sphereScale", sphere_scale);
+                waterParticleShader.setFloat("instanceBlend", instanceBlend);
+                for (int lod = 0; lod < CULL_LOD_COUNTS; lod++)
+                {
+                    if (bucketCounts[lod] == 0) continue;
+                    instanceBuffer.bindAttribute(lodVAOs[lod], 3, bucketBegin[lod]);
+                    glBindVertexArray(lodVAOs[lod]);
+                    glDrawElementsInstanced(GL_TRIANGLES, lodIndexCounts[lod], GL_UNSIGNED_INT, 0, bucketCounts[lod]);
+                }
+            }
+            else
+            {
+                // water.obj is a unit sphere
+                waterImpostorShader.use();
+                waterImpostorShader.setMat4("projection", projection);
+                waterImpostorShader.setMat4("view", view);
+                waterImpostorShader.setFloat("sphereRadius", sphere_scale);
+                waterImpostorShader.setFloat("instanceBlend", instanceBlend);
+                instanceBuffer.bindAttribute(impostorVAO, 3);
+                glBindVertexArray(impostorVAO);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, visibleCounts);
+            }
+            glBindVertexArray(0);
+            drawTimer.end();
+            instanceBuffer.fence();
+        }
 
-        glBindVertexArray(waterParticle.meshes[0].VAO);
-        glDrawElementsInstanced(GL_TRIANGLES, waterParticle.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, amount);
-        glBindVertexArray(0);
+        if (g_offscreen)
+        {
+            TRACE_SCOPE("readback");
+            frameCapture.readPixels();
+            // hand over every finished frame, only waits for the GPU when the ring is full
+            double waitTime = imageWriter.getWaitTime();
+            while (const unsigned char* pixels = frameCapture.map(frameCapture.isFull()))
+            {
+                imageWriter.submit(pixels);
+                frameCapture.unmap();
+            }
+            renderBusyTime += SimulationThread::getWallTime() - frameStartTime - (imageWriter.getWaitTime() - waitTime);
+
+            renderedFrameCounts++;
+            nextCaptureTick = snapshot.tickCounts + g_offscreenTickInterval;
+            if (renderedFrameCounts % 60 == 0)
+            {
+                std::cout << "frame " << renderedFrameCounts << " / " << g_offscreenFrameCounts
+                          << ", tick " << snapshot.tickCounts << std::endl;
+            }
+            // no ui and nothing to present
+            continue;
+        }
 
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -209,28 +686,346 @@ int main()
 
         ImGui::Begin("Panel");   // Pass a pointer to our bool variable (the window will have a closing button that will clear the bool when clicked)
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+        ImGui::RadioButton("mesh", &g_renderMode, RENDER_MESH);
+        ImGui::SameLine();
+        ImGui::RadioButton("impostor", &g_renderMode, RENDER_IMPOSTOR);
+        ImGui::SameLine();
+        ImGui::Text("draw %.3f ms (GPU)", drawTimer.getLastTime());
+        ImGui::Checkbox("Frustum culling and LOD", &g_cullingEnabled);
+        if (g_cullingEnabled)
+        {
+            ImGui::SliderFloat2("LOD distances", g_lodDistances, 1.f, 300.f);
+            ImGui::Text("visible %u / %u particles, %u / %u cells, lod %u / %u / %u", visibleCounts, amount,
+                        culler.getVisibleCellCounts(), culler.getCellCounts(), bucketCounts[0], bucketCounts[1], bucketCounts[2]);
+        }
+        ImGui::Checkbox("Surface particles only", &g_surfaceOnly);
+        if (g_surfaceOnly)
+        {
+            ImGui::SameLine();
+            ImGui::SliderInt("interior stride", &g_interiorStride, 0, 64);
+        }
+        unsigned int surfaceCounts = snapshot.diagnostics.surfacePointCounts;
+        unsigned int pointCounts = (unsigned int)snapshot.positions.size();
+        ImGui::Text("surface %u / %u particles (%.1f%%), drawing %u", surfaceCounts, pointCounts,
+                    pointCounts > 0 ? 100.f * surfaceCounts / pointCounts : 0.f, visibleCounts);
+        if (ImGui::Button("Write surface particles to sph_points.ply"))
+        {
+            std::vector<unsigned char> pointSelection;
+            selectSurfacePoints(snapshot.surfaceFlags.data(), pointCounts, (unsigned int)g_interiorStride, pointSelection);
+            if (!writePointsPly(POINTS_PATH, snapshot.positions.data(), snapshot.velocities.data(), pointCounts,
+                                pointSelection.data()))
+            {
+                std::cout << "Failed to write particles " << POINTS_PATH << std::endl;
+            }
+        }
+
+        bool paused = g_simulationThread.isPaused();
+        if (ImGui::Checkbox("Pause", &paused))
+        {
+            g_simulationThread.setPaused(paused);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Step"))
+        {
+            g_simulationThread.step();
+        }
+        ImGui::SameLine();
+        ImGui::Text("tick %llu", (unsigned long long)snapshot.tickCounts);
+        if (ImGui::SliderFloat("ticks per second (0 = max)", &g_simulationTickRate, 0.f, 240.f, "%.0f"))
+        {
+            g_simulationThread.setTickRate(g_simulationTickRate);
+        }
+        ImGui::RadioButton("latest", &g_interpolationMode, StateInterpolator::MODE_LATEST);
+        ImGui::SameLine();
+        ImGui::RadioButton("interpolate", &g_interpolationMode, StateInterpolator::MODE_INTERPOLATE);
+        ImGui::SameLine();
+        ImGui::RadioButton("extrapolate", &g_interpolationMode, StateInterpolator::MODE_EXTRAPOLATE);
+
+        bool statsEnabled = snapshot.statsEnabled;
+        if (ImGui::Checkbox("Solver stats", &statsEnabled))
+        {
+            g_simulationThread.post([statsEnabled](SPHSystem* system) { system->setStatsEnabled(statsEnabled); });
+        }
+        if (statsEnabled)
+        {
+            const SPHStats& stats = snapshot.stats;
+            ImGui::Text("tick %.3f ms (grid %.3f, density %.3f, force %.3f, advance %.3f)",
+                        stats.tickTime, stats.gridTime, stats.densityTime, stats.forceTime, stats.advanceTime);
+            ImGui::Text("neighbors avg %.1f max %d, truncated %u (total %llu)",
+                        stats.averageNeighborCounts, stats.maxNeighborCounts,
+                        stats.truncatedPointCounts, stats.totalTruncatedPointCounts);
+            ImGui::Text("neighbor table %.1f / %.1f KB, %.1f bytes per particle, %u grows",
+                        stats.neighborTableBytes / 1024.f, stats.neighborTableCapacity / 1024.f,
+                        stats.neighborBytesPerPoint, stats.neighborTableGrowCounts);
+            ImGui::Text("neighbor encode %.3f ms, decode %.3f ms for %u lists (summed over workers)",
+                        stats.neighborEncodeTime, stats.neighborDecodeTime, stats.neighborDecodeCounts);
+            ImGui::Text("grid %u / %u cells occupied (%.1f%%)", stats.occupiedCellCounts, stats.gridCellCounts,
+                        stats.gridCellCounts > 0 ? 100.f * stats.occupiedCellCounts / stats.gridCellCounts : 0.f);
+            ImGui::Text("adaptive %u splits, %u merges, %.3f ms", stats.splitCounts, stats.mergeCounts, stats.adaptTime);
+
+            const SPHDiagnostics& diagnostics = snapshot.diagnostics;
+            ImGui::Text("kinetic energy %.4g J, max speed %.3f m/s, max accel %.1f m/s^2",
+                        diagnostics.kineticEnergy, diagnostics.maxSpeed, diagnostics.maxAcceleration);
+            ImGui::Text("density error avg %.2f%% max %.2f%%",
+                        100.f * diagnostics.averageDensityError, 100.f * diagnostics.maxDensityError);
+
+            static int s_statsFormat = SPHStatsWriter::FORMAT_CSV;
+            static bool s_dumpStats = false;
+            if (ImGui::Checkbox("Dump stats", &s_dumpStats))
+            {
+                bool dumpStats = s_dumpStats;
+                SPHStatsWriter::Format format = (SPHStatsWriter::Format)s_statsFormat;
+                g_simulationThread.post([dumpStats, format](SPHSystem*)
+                {
+                    if (dumpStats)
+                    {
+                        bool csv = format == SPHStatsWriter::FORMAT_CSV;
+                        g_statsWriter.open(csv ? "sph_stats.csv" : "sph_stats.json", format, STATS_DUMP_INTERVAL);
+                    }
+                    else g_statsWriter.close();
+                });
+            }
+            ImGui::SameLine();
+            ImGui::RadioButton("csv", &s_statsFormat, SPHStatsWriter::FORMAT_CSV);
+            ImGui::SameLine();
+            ImGui::RadioButton("json", &s_statsFormat, SPHStatsWriter::FORMAT_JSON);
+        }
+
+        bool traceEnabled = TraceRecorder::isEnabled();
+        if (ImGui::Checkbox("Record trace", &traceEnabled))
+        {
+            TraceRecorder::get()->setEnabled(traceEnabled);
+        }
+        if (traceEnabled)
+        {
+            ImGui::SliderInt("frames", &g_traceFrameCounts, 1, 600);
+            if (ImGui::Button("Dump trace to sph_trace.json"))
+            {
+                TraceRecorder::get()->dumpChromeTrace("sph_trace.json", (unsigned int)g_traceFrameCounts);
+            }
+        }
+
         if (ImGui::Button("Reset"))
         {
-            resetSPHSystem();
+            g_simulationThread.post([](SPHSystem*) { resetSPHSystem(); });
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save checkpoint"))
+        {
+            //through the autosave writer, so it knows the file on disk afterwards
+            g_simulationThread.post([](SPHSystem* system)
+            {
+                CheckpointState state;
+                system->getCheckpointState(state);
+                if (!g_checkpointWriter.write(CHECKPOINT_PATH, state, false))
+                {
+                    std::cout << "Failed to save checkpoint " << CHECKPOINT_PATH << std::endl;
+                }
+            });
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load checkpoint"))
+        {
+            g_simulationThread.post([](SPHSystem* system)
+            {
+                if (!system->loadCheckpoint(CHECKPOINT_PATH))
+                {
+                    std::cout << "Failed to load checkpoint " << CHECKPOINT_PATH << std::endl;
+                }
+            });
+        }
+        bool autosaveCheckpoint = g_autosaveCheckpoint;
+        if (ImGui::Checkbox("Autosave checkpoint (incremental)", &autosaveCheckpoint))
+        {
+            g_autosaveCheckpoint = autosaveCheckpoint;
+        }
+        if (autosaveCheckpoint)
+        {
+            ImGui::Text("last autosave wrote %.1f KB", g_autosaveBytes / 1024.f);
+        }
+
+        if (ImGui::Checkbox("Record trajectory to sph_trajectory.bin", &g_recordTrajectory))
+        {
+            bool recordTrajectory = g_recordTrajectory;
+            g_simulationThread.post([recordTrajectory](SPHSystem* system)
+            {
+                if (!recordTrajectory)
+                {
+                    if (!g_trajectoryWriter.close()) std::cout << "Failed to write trajectory " << TRAJECTORY_PATH << std::endl;
+                }
+                else if (!g_trajectoryWriter.open(TRAJECTORY_PATH, *system, TRAJECTORY_INTERVAL))
+                {
+                    std::cout << "Failed to open trajectory " << TRAJECTORY_PATH << std::endl;
+                }
+            });
+        }
+        if (g_recordTrajectory)
+        {
+            ImGui::Text("frames %u, dropped %u, failed %u, %.2f bytes per particle per frame",
+                        g_trajectoryWriter.getFrameCounts(), g_trajectoryWriter.getDroppedFrameCounts(),
+                        g_trajectoryWriter.getFailedFrameCounts(), g_trajectoryWriter.getBytesPerParticleFrame());
+        }
+
+        if (g_readerMode)
+        {
+            ImGui::Text("reading %s: frame %llu, tick %llu, %.3f s, %u particles, publisher %s", g_sharedFrameName,
+                        (unsigned long long)g_readerFrame.frame, (unsigned long long)g_readerFrame.tick,
+                        g_readerFrame.simulatedTime, g_readerFrame.pointCounts,
+                        g_sharedFrameReader.isPublisherAlive() ? "running" : "gone");
+        }
+        else
+        {
+            static bool s_publish = g_sharedFramePublisher.isOpen();
+            if (ImGui::Checkbox("Publish frames to shared memory", &s_publish))
+            {
+                bool publish = s_publish;
+                g_simulationThread.post([publish](SPHSystem*)
+                {
+                    if (!publish) g_sharedFramePublisher.close();
+                    else if (!g_sharedFramePublisher.open(g_sharedFrameName))
+                    {
+                        std::cout << "Failed to create shared memory " << g_sharedFrameName << std::endl;
+                    }
+                });
+            }
+            if (s_publish)
+            {
+                double publishTime = g_sharedPublishTime;
+                ImGui::Text("%s, publish %.1f us per tick (%.2f%% of a tick)", g_sharedFrameName, publishTime,
+                            snapshot.stats.tickTime > 0.f ? 0.1 * publishTime / snapshot.stats.tickTime : 0.0);
+            }
+        }
+
+        bool extractSurface = g_extractSurface;
+        if (ImGui::Checkbox("Extract surface every 10 ticks", &extractSurface))
+        {
+            g_extractSurface = extractSurface;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Write surface to sph_surface.obj"))
+        {
+            g_simulationThread.post([](SPHSystem* system)
+            {
+                g_surfaceExtractor.extract(*system);
+                if (!g_surfaceExtractor.writeObj(SURFACE_PATH))
+                {
+                    std::cout << "Failed to write surface " << SURFACE_PATH << std::endl;
+                }
+                std::lock_guard<std::mutex> lock(g_surfaceStatsMutex);
+                g_surfaceStats = g_surfaceExtractor.getStats();
+            });
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_surfaceStatsMutex);
+            if (g_surfaceStats.blockCounts > 0)
+            {
+                ImGui::Text("surface %u triangles, %u / %u band blocks rebuilt, %u moved particles",
+                            g_surfaceStats.triangleCounts, g_surfaceStats.rebuiltBlockCounts,
+                            g_surfaceStats.bandBlockCounts, g_surfaceStats.movedPointCounts);
+                ImGui::Text("surface %.3f ms (classify %.3f, blocks %.3f, weld %.3f)", g_surfaceStats.totalTime,
+                            g_surfaceStats.classifyTime, g_surfaceStats.extractTime, g_surfaceStats.weldTime);
+            }
+        }
+
+        bool playback = g_trajectoryPlayer.isOpen();
+        if (ImGui::Checkbox("Play back sph_trajectory.bin", &playback))
+        {
+            if (playback)
+            {
+                // the index is written when the recording is closed, the simulation rests during playback
+                g_recordTrajectory = false;
+                g_simulationThread.setPaused(true);
+                g_simulationThread.execute([](SPHSystem*) { g_trajectoryWriter.close(); });
+                if (g_trajectoryPlayer.open(TRAJECTORY_PATH))
+                {
+                    g_playbackPositions.assign(g_trajectoryPlayer.getPointCounts(), glm::vec3(0.f));
+                    g_playbackFrame = 0;
+                    g_playbackDirection = 0;
+                }
+                else std::cout << "Failed to open trajectory " << TRAJECTORY_PATH << std::endl;
+            }
+            else g_trajectoryPlayer.close();
+        }
+        if (g_trajectoryPlayer.isOpen())
+        {
+            ImGui::SliderInt("frame", &g_playbackFrame, 0, (int)g_trajectoryPlayer.getFrameCounts() - 1);
+            if (ImGui::Button("<<")) g_playbackDirection = -1;
+            ImGui::SameLine();
+            if (ImGui::Button("||")) g_playbackDirection = 0;
+            ImGui::SameLine();
+            if (ImGui::Button(">>")) g_playbackDirection = 1;
+            ImGui::SameLine();
+            ImGui::Text("tick %llu, %.3f s, %u frames cached",
+                        (unsigned long long)g_trajectoryPlayer.getFrameTick((unsigned int)g_playbackFrame),
+                        g_playbackFrame * g_trajectoryPlayer.getFrameTime(), g_trajectoryPlayer.getCachedFrameCounts());
         }
         ImGui::End();
 
         // Rendering
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            TRACE_SCOPE("imgui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        {
+            TRACE_SCOPE("swap buffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
+    if (g_offscreen)
+    {
+        // simulation rate over the whole run, it doesn't wait for the renderer
+        double renderEndTime = SimulationThread::getWallTime();
+        uint64_t tickCounts = g_simulationThread.acquireSnapshot().tickCounts;
+
+        while (const unsigned char* pixels = frameCapture.map(true))
+        {
+            imageWriter.submit(pixels);
+            frameCapture.unmap();
+        }
+        imageWriter.close();
+        double totalTime = SimulationThread::getWallTime() - startTime;
+
+        double simulationTime = renderEndTime - startTime;
+        double encodeTime = imageWriter.getEncodeTime();
+        printf("simulation: %llu ticks, %.1f ticks/s, %.1f frames/s at %u ticks per frame\n",
+               (unsigned long long)tickCounts, tickCounts / simulationTime,
+               tickCounts / simulationTime / g_offscreenTickInterval, g_offscreenTickInterval);
+        printf("render:     %u frames, %.1f frames/s (%.3f ms/frame)\n", renderedFrameCounts,
+               renderBusyTime > 0.0 ? renderedFrameCounts / renderBusyTime : 0.0,
+               renderedFrameCounts > 0 ? 1000.0 * renderBusyTime / renderedFrameCounts : 0.0);
+        printf("encode:     %u frames, %.1f frames/s (%.3f ms/frame), %u failed, render waited %.3f s for the encoder\n",
+               imageWriter.getFrameCounts(), encodeTime > 0.0 ? imageWriter.getFrameCounts() / encodeTime : 0.0,
+               imageWriter.getFrameCounts() > 0 ? 1000.0 * encodeTime / imageWriter.getFrameCounts() : 0.0,
+               imageWriter.getFailedFrameCounts(), imageWriter.getWaitTime());
+        printf("overall:    %.1f frames/s over %.2f s\n", renderedFrameCounts / totalTime, totalTime);
+    }
+
     // Cleanup
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    g_simulationThread.stop();
+    g_trajectoryWriter.close();
+    g_trajectoryPlayer.close();
+    g_sharedFramePublisher.close();
+    g_sharedFrameReader.close();
+    if (!g_offscreen)
+    {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
-    glfwDestroyWindow(window);
+    instanceBuffer.release();
+    drawTimer.release();
+    lodSpheres[0].release();
+    lodSpheres[1].release();
+    frameCapture.release();
+    glDeleteVertexArrays(1, &impostorVAO);
+    if (window) glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
 }
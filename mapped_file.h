@@ -0,0 +1,39 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_MAPPED_FILE_H
+#define SIMPLE_FLUID_SIMULATOR_MAPPED_FILE_H
+
+#include <cstddef>
+
+/** read only memory mapping of a whole file */
+class MappedFile
+{
+public:
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_file;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_MAPPED_FILE_H
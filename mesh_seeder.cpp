@@ -0,0 +1,273 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "mesh_seeder.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    float elapsedMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop)
+    {
+        return std::chrono::duration<float, std::milli>(stop - start).count();
+    }
+
+    // splitmix64, a random number per lattice point that doesn't depend on which worker places it
+    uint64_t hashPoint(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    float toSignedUnit(uint64_t bits)
+    {
+        return (float)(bits & 0xffffff) / (float)0x800000 - 1.f;
+    }
+
+    // edge function of a -> b at q in the yz plane, positive on the left
+    double edgeFunction(const glm::vec3& a, const glm::vec3& b, double qy, double qz)
+    {
+        return ((double)b.y - a.y) * (qz - a.z) - ((double)b.z - a.z) * (qy - a.y);
+    }
+
+    // a point exactly on an edge belongs to the triangle on one side only, the one that walks the edge in the
+    // positive z direction or, for an edge along y, in the negative y direction
+    bool ownsEdge(double e, double dy, double dz)
+    {
+        return e > 0.0 || (e == 0.0 && (dz > 0.0 || (dz == 0.0 && dy < 0.0)));
+    }
+}
+
+MeshSeeder::MeshSeeder(unsigned int threadCounts)
+        : m_taskPool(threadCounts)
+        , m_fillRule(SEED_WINDING)
+        , m_layout(SEED_LATTICE)
+        , m_jitter(0.25f)
+        , m_randomSeed(1)
+        , m_workerScratch(m_taskPool.getThreadCounts())
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void MeshSeeder::clear()
+{
+    m_triangles.clear();
+}
+
+void MeshSeeder::addMesh(const glm::vec3 *positions, unsigned int vertexCounts, size_t stride,
+                         const unsigned int *indices, unsigned int indexCounts)
+{
+    const unsigned char* base = (const unsigned char*)positions;
+    for (unsigned int i = 0; i + 2 < indexCounts; i += 3)
+    {
+        if (indices[i] >= vertexCounts || indices[i + 1] >= vertexCounts || indices[i + 2] >= vertexCounts) continue;
+
+        Triangle triangle;
+        for (int k = 0; k < 3; k++)
+        {
+            triangle.v[k] = *(const glm::vec3*)(base + indices[i + k] * stride);
+        }
+        m_triangles.push_back(triangle);
+    }
+}
+
+ParticleBox3 MeshSeeder::getBounds() const
+{
+    ParticleBox3 bounds(glm::vec3(0.f), glm::vec3(0.f));
+    if (m_triangles.empty()) return bounds;
+
+    bounds.min = bounds.max = m_triangles[0].v[0];
+    for (const Triangle& triangle : m_triangles)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            bounds.min = glm::min(bounds.min, triangle.v[k]);
+            bounds.max = glm::max(bounds.max, triangle.v[k]);
+        }
+    }
+    return bounds;
+}
+
+void MeshSeeder::_binTriangles(const glm::vec3 &origin, float spacing, const glm::ivec3 &lattice)
+{
+    TRACE_SCOPE("bin triangles");
+
+    unsigned int rowCounts = (unsigned int)(lattice.y * lattice.z);
+
+    //rows a triangle can be hit by, from its yz bounds
+    auto getRowRange = [&](const Triangle& triangle, glm::ivec2& rowMin, glm::ivec2& rowMax)
+    {
+        glm::vec3 lo = glm::min(glm::min(triangle.v[0], triangle.v[1]), triangle.v[2]);
+        glm::vec3 hi = glm::max(glm::max(triangle.v[0], triangle.v[1]), triangle.v[2]);
+        rowMin = glm::max(glm::ivec2((int)std::ceil((lo.y - origin.y) / spacing), (int)std::ceil((lo.z - origin.z) / spacing)), glm::ivec2(0));
+        rowMax = glm::min(glm::ivec2((int)std::floor((hi.y - origin.y) / spacing), (int)std::floor((hi.z - origin.z) / spacing)),
+                          glm::ivec2(lattice.y - 1, lattice.z - 1));
+    };
+
+    //counting pass, then every row gets its slice of one array
+    m_rowStarts.assign(rowCounts + 1, 0);
+    for (const Triangle& triangle : m_placedTriangles)
+    {
+        glm::ivec2 rowMin, rowMax;
+        getRowRange(triangle, rowMin, rowMax);
+        for (int k = rowMin.y; k <= rowMax.y; k++)
+            for (int j = rowMin.x; j <= rowMax.x; j++) m_rowStarts[k * lattice.y + j + 1]++;
+    }
+    for (unsigned int r = 0; r < rowCounts; r++) m_rowStarts[r + 1] += m_rowStarts[r];
+
+    m_rowTriangles.resize(m_rowStarts[rowCounts]);
+    std::vector<unsigned int> cursor(m_rowStarts.begin(), m_rowStarts.end() - 1);
+    for (unsigned int t = 0; t < m_placedTriangles.size(); t++)
+    {
+        glm::ivec2 rowMin, rowMax;
+        getRowRange(m_placedTriangles[t], rowMin, rowMax);
+        for (int k = rowMin.y; k <= rowMax.y; k++)
+            for (int j = rowMin.x; j <= rowMax.x; j++) m_rowTriangles[cursor[k * lattice.y + j]++] = t;
+    }
+}
+
+void MeshSeeder::_fillRows(unsigned int begin, unsigned int end, const glm::vec3 &origin, float spacing,
+                           const glm::ivec3 &lattice, const ParticleBox3 &targetBox, WorkerScratch &scratch)
+{
+    TRACE_SCOPE("fill rows");
+
+    scratch.positions.clear();
+    scratch.crossingCounts = 0;
+    scratch.unclosedRowCounts = 0;
+
+    for (unsigned int r = begin; r < end; r++)
+    {
+        int j = (int)(r % (unsigned int)lattice.y);
+        int k = (int)(r / (unsigned int)lattice.y);
+        double qy = (double)origin.y + j * (double)spacing;
+        double qz = (double)origin.z + k * (double)spacing;
+
+        //crossings of the ray along x through the row
+        scratch.crossings.clear();
+        for (unsigned int n = m_rowStarts[r]; n < m_rowStarts[r + 1]; n++)
+        {
+            const Triangle& triangle = m_placedTriangles[m_rowTriangles[n]];
+            const glm::vec3& a = triangle.v[0];
+            const glm::vec3& b = triangle.v[1];
+            const glm::vec3& c = triangle.v[2];
+
+            double area = edgeFunction(a, b, c.y, c.z);
+            if (area == 0.0) continue;      //parallel to the ray
+            double s = area > 0.0 ? 1.0 : -1.0;
+
+            double ea = edgeFunction(b, c, qy, qz);
+            double eb = edgeFunction(c, a, qy, qz);
+            double ec = edgeFunction(a, b, qy, qz);
+            if (!ownsEdge(s * ea, s * ((double)c.y - b.y), s * ((double)c.z - b.z)) ||
+                !ownsEdge(s * eb, s * ((double)a.y - c.y), s * ((double)a.z - c.z)) ||
+                !ownsEdge(s * ec, s * ((double)b.y - a.y), s * ((double)b.z - a.z))) continue;
+
+            float x = (float)((ea * a.x + eb * b.x + ec * c.x) / area);
+            //the normal points against the ray where it enters an outward facing mesh
+            scratch.crossings.push_back(std::make_pair(x, area < 0.0 ? 1 : -1));
+        }
+        scratch.crossingCounts += (unsigned int)scratch.crossings.size();
+        std::sort(scratch.crossings.begin(), scratch.crossings.end());
+
+        //spans between crossings which are inside by the fill rule
+        int winding = 0;
+        float spanBegin = 0.f;
+        for (const auto& crossing : scratch.crossings)
+        {
+            int nextWinding = m_fillRule == SEED_PARITY ? winding ^ 1 : winding + crossing.second;
+            if (winding == 0 && nextWinding != 0)
+            {
+                spanBegin = crossing.first;
+            }
+            else if (winding != 0 && nextWinding == 0)
+            {
+                int i0 = std::max(0, (int)std::ceil((spanBegin - origin.x) / spacing));
+                int i1 = std::min(lattice.x, (int)std::ceil((crossing.first - origin.x) / spacing));
+                for (int i = i0; i < i1; i++)
+                {
+                    glm::vec3 p(origin.x + i * spacing, (float)qy, (float)qz);
+                    if (m_layout == SEED_JITTER)
+                    {
+                        uint64_t index = ((uint64_t)r * (uint64_t)lattice.x + (uint64_t)i) ^ ((uint64_t)m_randomSeed << 40);
+                        uint64_t bits0 = hashPoint(index);
+                        uint64_t bits1 = hashPoint(bits0);
+                        glm::vec3 offset(toSignedUnit(bits0), toSignedUnit(bits0 >> 32), toSignedUnit(bits1));
+                        p = glm::clamp(p + offset * (m_jitter * spacing), targetBox.min, targetBox.max);
+                    }
+                    scratch.positions.push_back(p);
+                }
+            }
+            winding = nextWinding;
+        }
+        if (winding != 0) scratch.unclosedRowCounts++;
+    }
+}
+
+void MeshSeeder::seed(const ParticleBox3 &targetBox, float spacing, std::vector<glm::vec3> &positions)
+{
+    TRACE_SCOPE("seed mesh");
+
+    auto start = std::chrono::steady_clock::now();
+    positions.clear();
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.triangleCounts = (unsigned int)m_triangles.size();
+
+    glm::vec3 targetSize = targetBox.max - targetBox.min;
+    if (m_triangles.empty() || spacing <= 0.f || targetSize.x < 0.f || targetSize.y < 0.f || targetSize.z < 0.f) return;
+
+    //uniform scale, the mesh keeps its proportions and is centered in the box
+    ParticleBox3 bounds = getBounds();
+    glm::vec3 meshSize = bounds.max - bounds.min;
+    float scale = 0.f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (meshSize[axis] <= 0.f) continue;
+        float axisScale = targetSize[axis] / meshSize[axis];
+        scale = scale > 0.f ? std::min(scale, axisScale) : axisScale;
+    }
+    glm::vec3 offset = (targetBox.min + targetBox.max) * 0.5f - (bounds.min + bounds.max) * 0.5f * scale;
+
+    m_placedTriangles.resize(m_triangles.size());
+    for (size_t t = 0; t < m_triangles.size(); t++)
+    {
+        for (int k = 0; k < 3; k++) m_placedTriangles[t].v[k] = m_triangles[t].v[k] * scale + offset;
+    }
+
+    //the lattice of addFluidBox, from the box minimum with both ends included
+    glm::ivec3 lattice = glm::ivec3(glm::floor(targetSize / spacing)) + 1;
+    glm::vec3 origin = targetBox.min;
+    unsigned int rowCounts = (unsigned int)(lattice.y * lattice.z);
+
+    _binTriangles(origin, spacing, lattice);
+    auto binned = std::chrono::steady_clock::now();
+
+    m_taskPool.parallelFor(rowCounts, [&](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        _fillRows(begin, end, origin, spacing, lattice, targetBox, m_workerScratch[worker]);
+    });
+
+    //workers hold contiguous runs of rows, joined in worker order they are in row order
+    size_t pointCounts = 0;
+    for (const WorkerScratch& scratch : m_workerScratch) pointCounts += scratch.positions.size();
+    positions.reserve(pointCounts);
+    for (const WorkerScratch& scratch : m_workerScratch)
+    {
+        positions.insert(positions.end(), scratch.positions.begin(), scratch.positions.end());
+        m_stats.crossingCounts += scratch.crossingCounts;
+        m_stats.unclosedRowCounts += scratch.unclosedRowCounts;
+    }
+    auto filled = std::chrono::steady_clock::now();
+
+    m_stats.rowCounts = rowCounts;
+    m_stats.pointCounts = (unsigned int)positions.size();
+    m_stats.binTime = elapsedMs(start, binned);
+    m_stats.fillTime = elapsedMs(binned, filled);
+    m_stats.totalTime = elapsedMs(start, filled);
+}
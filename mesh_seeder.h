@@ -0,0 +1,108 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_MESH_SEEDER_H
+#define SIMPLE_FLUID_SIMULATOR_MESH_SEEDER_H
+
+#include "particle_box.h"
+#include "task_pool.h"
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** which points are inside a closed mesh */
+enum SeedFillRule
+{
+    SEED_PARITY,                        // an odd number of surfaces along a ray, ignores the winding of triangles
+    SEED_WINDING,                       // a nonzero winding number, overlapping closed shells stay filled
+};
+
+/** where particles go inside the mesh */
+enum SeedLayout
+{
+    SEED_LATTICE,                       // a cubic lattice, as addFluidBox places them
+    SEED_JITTER,                        // the lattice with every point moved randomly by up to jitter * spacing
+};
+
+/** counters and timers of the last seed */
+struct SeedStats
+{
+    unsigned int triangleCounts;
+    unsigned int rowCounts;             // lattice rows along x
+    unsigned int crossingCounts;        // ray triangle hits of all rows
+    unsigned int unclosedRowCounts;     // rows which left the mesh inside, the mesh has holes there
+    unsigned int pointCounts;
+    float binTime;                      // ms, triangles sorted into rows
+    float fillTime;                     // ms, rows intersected and filled
+    float totalTime;                    // ms
+};
+
+/** fills the inside of a closed triangle mesh with particle positions.
+ *  the mesh is voxelized one lattice row at a time: a ray along x through the row collects its crossings with
+ *  the triangles binned to that row, and the lattice points between entering and leaving crossings are inside.
+ *  a ray through an edge or vertex shared by triangles hits exactly one of them, so closed meshes give closed
+ *  rows. rows are filled in parallel on a task pool, every worker appends to its own list and the lists are
+ *  joined in row order, the result doesn't depend on the thread counts */
+class MeshSeeder
+{
+public:
+    void clear();
+    /** add the triangles of a mesh, stride is the distance between two positions in bytes so the vertices of a
+     *  Mesh can be passed as they are */
+    void addMesh(const glm::vec3* positions, unsigned int vertexCounts, size_t stride,
+                 const unsigned int* indices, unsigned int indexCounts);
+    bool isEmpty() const { return m_triangles.empty(); }
+    /** bounds of the added meshes in their own units */
+    ParticleBox3 getBounds() const;
+
+    void setFillRule(SeedFillRule fillRule) { m_fillRule = fillRule; }
+    /** jitter is a fraction of the spacing, only used by SEED_JITTER */
+    void setLayout(SeedLayout layout, float jitter = 0.25f) { m_layout = layout; m_jitter = jitter; }
+    void setRandomSeed(uint32_t seed) { m_randomSeed = seed; }
+
+    /** scale the meshes uniformly to fit targetBox, centered, and fill them with points spacing apart.
+     *  positions is replaced, points are ordered by row like those of addFluidBox */
+    void seed(const ParticleBox3& targetBox, float spacing, std::vector<glm::vec3>& positions);
+
+    const SeedStats& getStats() const { return m_stats; }
+
+private:
+    struct Triangle
+    {
+        glm::vec3 v[3];
+    };
+
+    struct WorkerScratch
+    {
+        std::vector<std::pair<float, int> > crossings;     // x and winding of every hit of the current row
+        std::vector<glm::vec3> positions;
+        unsigned int crossingCounts;
+        unsigned int unclosedRowCounts;
+    };
+
+    void _binTriangles(const glm::vec3& origin, float spacing, const glm::ivec3& lattice);
+    void _fillRows(unsigned int begin, unsigned int end, const glm::vec3& origin, float spacing,
+                   const glm::ivec3& lattice, const ParticleBox3& targetBox, WorkerScratch& scratch);
+
+private:
+    TaskPool m_taskPool;
+    SeedFillRule m_fillRule;
+    SeedLayout m_layout;
+    float m_jitter;
+    uint32_t m_randomSeed;
+
+    std::vector<Triangle> m_triangles;              // in mesh units
+    std::vector<Triangle> m_placedTriangles;        // fitted into the target box
+    std::vector<unsigned int> m_rowStarts;          // triangles of row r are m_rowTriangles[m_rowStarts[r]..[r+1])
+    std::vector<unsigned int> m_rowTriangles;
+    std::vector<WorkerScratch> m_workerScratch;
+    SeedStats m_stats;
+
+public:
+    explicit MeshSeeder(unsigned int threadCounts);
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_MESH_SEEDER_H
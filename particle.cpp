@@ -66,3 +66,34 @@ Particle *ParticleBuffer::AddParticle()
     return particle;
 }
 
+void ParticleBuffer::assign(const Particle *particles, unsigned int counts)
+{
+    if (counts > m_bufCapacity)
+    {
+        reset(counts);
+    }
+
+    if (counts > 0)
+    {
+        memcpy(m_particleBuf, particles, counts * sizeof(Particle));
+    }
+    m_particleCounts = counts;
+}
+
+Particle *ParticleBuffer::append(unsigned int counts)
+{
+    if (m_particleCounts + counts > m_bufCapacity)
+    {
+        //reallocate particle buffer once for all of them
+        m_bufCapacity = m_particleCounts + counts;
+        Particle* new_data = (Particle*)malloc(m_bufCapacity * sizeof(Particle));
+        if (m_particleCounts > 0) memcpy(new_data, m_particleBuf, m_particleCounts * sizeof(Particle));
+        free(m_particleBuf);
+        m_particleBuf = new_data;
+    }
+
+    Particle* particles = m_particleBuf + m_particleCounts;
+    memset(particles, 0, counts * sizeof(Particle));
+    m_particleCounts += counts;
+    return particles;
+}
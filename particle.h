@@ -28,6 +28,11 @@ public:
     Particle* get(unsigned int index) { return m_particleBuf+index; }
     const Particle* get(unsigned int index) const { return m_particleBuf+index; }
     Particle* AddParticle();
+    /** replace all particles with a copy of particles, grows the buffer if needed */
+    void assign(const Particle* particles, unsigned int counts);
+    /** add counts zeroed particles at once, grows the buffer a single time. returns the first of them */
+    Particle* append(unsigned int counts);
+    unsigned int capacity() const { return m_bufCapacity; }
 
 private:
     Particle* m_particleBuf;
@@ -4,13 +4,39 @@
 
 #include "particle_box.h"
 
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    //7 bits per byte, the high bit is set while more bytes follow. deltas of 16 bit indices take up to 3 bytes
+    inline unsigned char* writeDelta(unsigned char* data, unsigned int value)
+    {
+        while(value>=0x80)
+        {
+            *data++ = (unsigned char)(value | 0x80);
+            value >>= 7;
+        }
+        *data++ = (unsigned char)value;
+        return data;
+    }
+
+    inline unsigned int readDelta(const unsigned char*& data)
+    {
+        unsigned int value = *data++;
+        if(value<0x80) return value;
+        value = (value & 0x7f) | ((unsigned int)*data++ << 7);
+        if(value<0x4000) return value;
+        return (value & 0x3fff) | ((unsigned int)*data++ << 14);
+    }
+}
 
 
 ParticleGridContainer::ParticleGridContainer() = default;
 
 ParticleGridContainer::~ParticleGridContainer() = default;
 
-int ParticleGridContainer::getGridData(int gridIndex)
+int ParticleGridContainer::getGridData(int gridIndex) const
 {
     if (gridIndex<0 || gridIndex>=(int)m_gridData.size())
     {
@@ -63,6 +89,7 @@ void ParticleGridContainer::init(const ParticleBox3 &box, float sim_scale, float
 void ParticleGridContainer::insertParticles(ParticleBuffer *particleBuffer)
 {
     std::fill(m_gridData.begin(), m_gridData.end(), -1);
+    m_occupiedCellCounts = 0;
 
     Particle* p = particleBuffer->get(0);
     for(unsigned int n=0; n < particleBuffer->size(); n++, p++)
@@ -72,6 +99,7 @@ void ParticleGridContainer::insertParticles(ParticleBuffer *particleBuffer)
         {
             p->next = m_gridData[gs];
             m_gridData[gs] =(int) n;
+            if (p->next == -1) m_occupiedCellCounts++;
         }
         else p->next = -1;
     }
@@ -114,16 +142,97 @@ void ParticleGridContainer::findCells(const glm::vec3 &p, float radius, int *gri
     }
 }
 
+//-----------------------------------------------------------------------------------------------------------------
+void ParticleGridHierarchy::init(const ParticleBox3 &box, float sim_scale, float baseRadius, float maxRadius, float border)
+{
+    m_gridMin = box.min;	m_gridMin -= border;
+    glm::vec3 gridSize = box.max - box.min + 2.f * border;
+
+    m_levels.clear();
+    unsigned int cellCounts = 0;
+    float radius = baseRadius;
+    do
+    {
+        Level level;
+        level.radius = radius;
+        level.maxRadius = 0.f;
+
+        // the cells may overhang the max side of the box, the min side is shared by all levels
+        float world_cellsize = radius / sim_scale;
+        level.res = glm::max(glm::ivec3(glm::ceil(gridSize / world_cellsize)), glm::ivec3(1));
+        level.delta = glm::vec3(1.f / world_cellsize);
+        level.offset = cellCounts;
+        cellCounts += (unsigned int)(level.res.x * level.res.y * level.res.z);
+        m_levels.push_back(level);
+
+        radius *= 2.f;
+    } while (m_levels.back().radius < maxRadius);
+
+    m_gridData.resize(cellCounts);
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+void ParticleGridHierarchy::insertParticles(const ParticleBuffer *particleBuffer, const float *radii)
+{
+    std::fill(m_gridData.begin(), m_gridData.end(), -1);
+    m_next.resize(particleBuffer->size());
+    m_occupiedCellCounts = 0;
+    for (Level& level : m_levels) level.maxRadius = 0.f;
+
+    //not set up by init yet
+    if (m_levels.empty())
+    {
+        std::fill(m_next.begin(), m_next.end(), -1);
+        return;
+    }
+
+    int topLevel = (int)m_levels.size() - 1;
+    for (unsigned int n = 0; n < particleBuffer->size(); n++)
+    {
+        int l = 0;
+        while (l < topLevel && radii[n] > m_levels[l].radius) l++;
+        Level& level = m_levels[l];
+
+        const glm::vec3& pos = particleBuffer->get(n)->pos;
+        glm::ivec3 cell = glm::ivec3(glm::floor((pos - m_gridMin) * level.delta));
+        if (glm::any(glm::lessThan(cell, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cell, level.res)))
+        {
+            m_next[n] = -1;
+            continue;
+        }
+
+        int& head = m_gridData[level.offset + (cell.z * level.res.y + cell.y) * level.res.x + cell.x];
+        m_next[n] = head;
+        if (head == -1) m_occupiedCellCounts++;
+        head = (int)n;
+        level.maxRadius = std::max(level.maxRadius, radii[n]);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+void ParticleGridHierarchy::findCellRange(int level, const glm::vec3 &p, float radius, glm::ivec3 &cellMin, glm::ivec3 &cellMax) const
+{
+    const Level& l = m_levels[level];
+    cellMin = glm::max(glm::ivec3(glm::floor((p - radius - m_gridMin) * l.delta)), glm::ivec3(0));
+    cellMax = glm::min(glm::ivec3(glm::floor((p + radius - m_gridMin) * l.delta)), l.res - 1);
+}
+
 //-----------------------------------------------------------------------------------------------------------------
 NeighborTable::NeighborTable()
         : m_pointExtraData(0)
-        , m_pointCounts(0)
+        , m_chunkEnd(0)
         , m_pointCapacity(0)
         , m_neighborDataBuf(0)
         , m_dataBufSize(0)
         , m_currNeighborCounts(0)
         , m_currPoint(0)
         , m_dataBufOffset(0)
+        , m_lastDataBufBytes(0)
+        , m_committedPointCounts(0)
+        , m_totalNeighborCounts(0)
+        , m_maxNeighborCounts(0)
+        , m_truncatedPointCounts(0)
+        , m_growCounts(0)
 {
 }
 
@@ -135,9 +244,8 @@ NeighborTable::~NeighborTable()
 }
 
 //-----------------------------------------------------------------------------------------------------------------
-void NeighborTable::reset(unsigned short pointCounts)
+void NeighborTable::reset(unsigned short pointCounts, unsigned short chunkEnd)
 {
-    int a = sizeof(PointExtraData);
     if(pointCounts>m_pointCapacity)
     {
         if(m_pointExtraData)
@@ -148,9 +256,27 @@ void NeighborTable::reset(unsigned short pointCounts)
         m_pointCapacity = pointCounts;
     }
 
-    m_pointCounts = pointCounts;
+    m_chunkEnd = chunkEnd;
     memset(m_pointExtraData, 0, sizeof(PointExtraData)*m_pointCapacity);
+
+    //the last fill counted the bytes, the next one takes about the same. the old data is dropped, so the buf is
+    //allocated again with a quarter to spare when less than a sixteenth is left or it is far too large
+    if(m_dataBufOffset>0) m_lastDataBufBytes = m_dataBufOffset;
+    unsigned int minSize = m_lastDataBufBytes + m_lastDataBufBytes/16 + MAX_ENCODED_BYTES;
+    unsigned int newSize = m_lastDataBufBytes + m_lastDataBufBytes/4 + MAX_ENCODED_BYTES;
+    if(m_lastDataBufBytes>0 && (m_dataBufSize<minSize || m_dataBufSize>newSize*2))
+    {
+        if(m_neighborDataBuf) free(m_neighborDataBuf);
+        m_neighborDataBuf = (unsigned char*)malloc(newSize);
+        m_dataBufSize = newSize;
+        m_growCounts++;
+    }
     m_dataBufOffset = 0;
+
+    m_committedPointCounts = 0;
+    m_totalNeighborCounts = 0;
+    m_maxNeighborCounts = 0;
+    m_truncatedPointCounts = 0;
 }
 
 //-----------------------------------------------------------------------------------------------------------------
@@ -161,12 +287,16 @@ void NeighborTable::point_prepare(unsigned short ptIndex)
 }
 
 //-----------------------------------------------------------------------------------------------------------------
-bool NeighborTable::point_add_neighbor(unsigned short ptIndex, float distance)
+bool NeighborTable::point_add_neighbor(unsigned short ptIndex)
 {
-    if (m_currNeighborCounts >= MAX_NEIGHBOR_COUNTS) return false;
+    if (m_currNeighborCounts >= MAX_NEIGHBOR_COUNTS)
+    {
+        //the caller stops searching for this point
+        m_truncatedPointCounts++;
+        return false;
+    }
 
     m_currNeighborIndex[m_currNeighborCounts]=ptIndex;
-    m_currNeighborDistance[m_currNeighborCounts]=distance;
 
     m_currNeighborCounts++;
     return true;
@@ -175,55 +305,68 @@ bool NeighborTable::point_add_neighbor(unsigned short ptIndex, float distance)
 //-----------------------------------------------------------------------------------------------------------------
 void NeighborTable::point_commit(void)
 {
+    m_committedPointCounts++;
     if(m_currNeighborCounts==0) return;
 
-    unsigned int index_size = m_currNeighborCounts*sizeof(unsigned short);
-    unsigned int distance_size = m_currNeighborCounts*sizeof(float);
+    m_totalNeighborCounts += m_currNeighborCounts;
+    if(m_currNeighborCounts>m_maxNeighborCounts) m_maxNeighborCounts = m_currNeighborCounts;
 
-    //grow buf
-    if(m_dataBufOffset+index_size+distance_size>m_dataBufSize)
+    //grow buf, for the largest deltas
+    unsigned int max_size = m_currNeighborCounts*3;
+    if(m_dataBufOffset+max_size>m_dataBufSize)
     {
-        _growDataBuf(m_dataBufOffset+index_size+distance_size);
+        _growDataBuf(m_dataBufOffset+max_size);
     }
 
     //set neightbor data
     m_pointExtraData[m_currPoint].neighborCounts = m_currNeighborCounts;
     m_pointExtraData[m_currPoint].neighborDataOffset = m_dataBufOffset;
 
-    //copy index data
-    memcpy(m_neighborDataBuf+m_dataBufOffset, m_currNeighborIndex, index_size);
-    m_dataBufOffset += index_size;
+    //the grid finds the neighbors cell by cell, sorted they are a few indices apart
+    std::sort(m_currNeighborIndex, m_currNeighborIndex+m_currNeighborCounts);
 
-    //copy distance data
-    memcpy(m_neighborDataBuf+m_dataBufOffset, m_currNeighborDistance, distance_size);
-    m_dataBufOffset += distance_size;
+    unsigned char* data = m_neighborDataBuf+m_dataBufOffset;
+    int first = (int)m_currNeighborIndex[0] - (int)m_currPoint;
+    data = writeDelta(data, ((unsigned int)first << 1) ^ (unsigned int)(first >> 31));
+    for(int i=1; i<m_currNeighborCounts; i++)
+    {
+        //neighbors are unique, the delta is at least 1
+        data = writeDelta(data, (unsigned int)(m_currNeighborIndex[i] - m_currNeighborIndex[i-1] - 1));
+    }
+    m_dataBufOffset = (unsigned int)(data - m_neighborDataBuf);
 }
 
 //-----------------------------------------------------------------------------------------------------------------
 void NeighborTable::_growDataBuf(unsigned int need_size)
 {
-    unsigned int newSize = m_dataBufSize>0 ? m_dataBufSize : 1;
-    while(newSize<need_size) newSize*=2;
+    //the points of the chunk after the current one take about as many bytes each as the ones so far, with a
+    //quarter to spare
+    unsigned int bytesPerPoint = need_size/m_committedPointCounts + 1;
+    unsigned int remainingPoints = m_chunkEnd > m_currPoint ? m_chunkEnd - m_currPoint - 1 : 0;
+    unsigned int newSize = need_size + bytesPerPoint*remainingPoints;
+    newSize += newSize/4;
     if(newSize<1024)newSize=1024;
 
-    unsigned char* newBuf = (unsigned char*)malloc(newSize);
-    if(m_neighborDataBuf)
-    {
-        memcpy(newBuf, m_neighborDataBuf, m_dataBufSize);
-        free(m_neighborDataBuf);
-    }
-    m_neighborDataBuf = newBuf;
+    m_neighborDataBuf = (unsigned char*)realloc(m_neighborDataBuf, newSize);
     m_dataBufSize = newSize;
+    m_growCounts++;
 }
 
 //-----------------------------------------------------------------------------------------------------------------
-void NeighborTable::getNeighborInfo(unsigned short ptIndex, int index, unsigned short& neighborIndex, float& neighborDistance)
+int NeighborTable::getNeighbors(unsigned short ptIndex, unsigned short* neighborIndices) const
 {
     PointExtraData neighData = m_pointExtraData[ptIndex];
-
-    unsigned short* indexBuf = (unsigned short*)(m_neighborDataBuf+neighData.neighborDataOffset);
-    float* distanceBuf = (float*)(m_neighborDataBuf + neighData.neighborDataOffset+sizeof(unsigned short)*neighData.neighborCounts);
-
-    neighborIndex = indexBuf[index];
-    neighborDistance = distanceBuf[index];
-}
\ No newline at end of file
+    int neighborCounts = neighData.neighborCounts;
+    if(neighborCounts==0) return 0;
+
+    const unsigned char* data = m_neighborDataBuf+neighData.neighborDataOffset;
+    unsigned int first = readDelta(data);
+    int index = (int)ptIndex + (int)((first >> 1) ^ (0u - (first & 1)));
+    neighborIndices[0] = (unsigned short)index;
+    for(int i=1; i<neighborCounts; i++)
+    {
+        index += (int)readDelta(data) + 1;
+        neighborIndices[i] = (unsigned short)index;
+    }
+    return neighborCounts;
+}
@@ -30,7 +30,7 @@ public:
     void init(const ParticleBox3& box, float sim_scale, float cell_size, float border);
     void insertParticles(ParticleBuffer* particleBuffer);
     void findCells(const glm::vec3 & p, float radius, int* gridCell) const;
-    int getGridData(int gridIndex);
+    int getGridData(int gridIndex) const;
 
     const glm::ivec3 * getGridRes() const { return &m_gridRes; }
     const glm::vec3 * getGridMin() const { return &m_gridMin; }
@@ -38,6 +38,11 @@ public:
     const glm::vec3 * getGridSize() const { return &m_gridSize; }
 
     int getGridCellIndex(float px, float py, float pz) const;
+
+    /** get cell counts of the grid */
+    unsigned int getCellCounts() const { return (unsigned int)m_gridData.size(); }
+    /** get counts of cells holding at least one particle after the last insertParticles */
+    unsigned int getOccupiedCellCounts() const { return m_occupiedCellCounts; }
 private:
     // Spatial Grid
     std::vector<int>	m_gridData;
@@ -47,27 +52,97 @@ private:
     glm::vec3 			m_gridSize{};				// physical size in each axis
     glm::vec3 			m_gridDelta{};
     float				m_gridCellSize{};
+    unsigned int		m_occupiedCellCounts{};
 };
 
+/** grids of several cell sizes for particles with different smoothing radii. level 0 holds the radii up to the
+ *  base radius and every further level twice the radius of the one below, the cells of a level are as large as
+ *  its radius. a particle is inserted at the level of its radius and a query visits, on every occupied level,
+ *  only the cells which overlap the query box, so small particles are found through small cells and large ones
+ *  through few large cells. the particles of a cell are linked through getNext, the next member of Particle
+ *  stays with ParticleGridContainer */
+class ParticleGridHierarchy
+{
+public:
+    /** radii in metres like the cell size of ParticleGridContainer, levels are made up to maxRadius */
+    void init(const ParticleBox3& box, float sim_scale, float baseRadius, float maxRadius, float border);
+    /** radius of every particle in metres, radii above the top level go to the top level */
+    void insertParticles(const ParticleBuffer* particleBuffer, const float* radii);
+
+    int getLevelCounts() const { return (int)m_levels.size(); }
+    /** largest radius inserted at level by the last insertParticles in metres, 0 for an empty level */
+    float getLevelMaxRadius(int level) const { return m_levels[level].maxRadius; }
+    /** first and last cell of level overlapping the box of half size radius around p, all in world units.
+     *  cellMin is above cellMax on some axis if the box misses the grid */
+    void findCellRange(int level, const glm::vec3& p, float radius, glm::ivec3& cellMin, glm::ivec3& cellMax) const;
+    /** first particle of a cell, -1 for none */
+    int getGridData(int level, int x, int y, int z) const
+    {
+        const Level& l = m_levels[level];
+        return m_gridData[l.offset + (z * l.res.y + y) * l.res.x + x];
+    }
+    int getNext(int particleIndex) const { return m_next[particleIndex]; }
+
+    unsigned int getCellCounts() const { return (unsigned int)m_gridData.size(); }
+    unsigned int getOccupiedCellCounts() const { return m_occupiedCellCounts; }
+
+private:
+    struct Level
+    {
+        float radius;                   // upper radius of the level, metres
+        float maxRadius;                // largest radius inserted, metres
+        glm::ivec3 res;
+        glm::vec3 delta;                // world space to cell #
+        unsigned int offset;            // first cell in m_gridData
+    };
 
+    std::vector<Level> m_levels;
+    std::vector<int> m_gridData;        // the cells of all levels, level 0 first
+    std::vector<int> m_next;
+    glm::vec3 m_gridMin{};
+    unsigned int m_occupiedCellCounts{};
+};
+
+
+/** neighbors of every point, sorted by index and stored as variable length deltas: the first from the index of the
+ *  point, zigzag coded, then from the previous neighbor. a byte holds 7 bits of a delta, so neighbors less than
+ *  128 indices apart take one byte, most of them while the buffer order roughly follows space as the fluid boxes
+ *  are filled row by row. distances are not kept, readers compute them from the positions. the data buf is sized
+ *  from the bytes the last fill took, or on the first fill from the points committed so far */
 class NeighborTable
 {
 public:
-    /** reset neighbor table */
-    void reset(unsigned short pointCounts);
+    enum {MAX_NEIGHBOR_COUNTS=80,};
+
+    /** reset neighbor table for points below pointCounts. a worker fills the points up to chunkEnd, the data buf
+     *  is sized for the rest of its chunk when it has to grow */
+    void reset(unsigned short pointCounts, unsigned short chunkEnd);
     /** prepare a point neighbor data */
     void point_prepare(unsigned short ptIndex);
     /** add neighbor data to current point */
-    bool point_add_neighbor(unsigned short ptIndex, float distance);
+    bool point_add_neighbor(unsigned short ptIndex);
     /** commit point neighbor data to data buf*/
     void point_commit(void);
     /** get point neighbor counts */
-    int getNeighborCounts(unsigned short ptIndex) { return m_pointExtraData[ptIndex].neighborCounts; }
-    /** get point neighbor information*/
-    void getNeighborInfo(unsigned short ptIndex, int index, unsigned short& neighborIndex, float& neighborDistance);
+    int getNeighborCounts(unsigned short ptIndex) const { return m_pointExtraData[ptIndex].neighborCounts; }
+    /** decode the neighbors of a point into neighborIndices, which holds MAX_NEIGHBOR_COUNTS, in ascending order.
+     *  returns the neighbor counts */
+    int getNeighbors(unsigned short ptIndex, unsigned short* neighborIndices) const;
+
+    /** statistics since the last reset */
+    unsigned int getCommittedPointCounts() const { return m_committedPointCounts; }
+    unsigned int getTotalNeighborCounts() const { return m_totalNeighborCounts; }
+    int getMaxNeighborCounts() const { return m_maxNeighborCounts; }
+    /** counts of points which hit MAX_NEIGHBOR_COUNTS and lost neighbors */
+    unsigned int getTruncatedPointCounts() const { return m_truncatedPointCounts; }
+    /** neighbor data in use and allocated, in bytes */
+    unsigned int getDataBufBytes() const { return m_dataBufOffset; }
+    unsigned int getDataBufCapacity() const { return m_dataBufSize; }
+    /** counts of data buf reallocations since the table was created */
+    unsigned int getGrowCounts() const { return m_growCounts; }
 
 private:
-    enum {MAX_NEIGHBOR_COUNTS=80,};
+    enum {MAX_ENCODED_BYTES=MAX_NEIGHBOR_COUNTS*3,};    // a 16 bit delta takes up to 3 bytes
 
     union PointExtraData
     {
@@ -81,18 +156,25 @@ private:
     };
 
     PointExtraData* m_pointExtraData;
-    unsigned int m_pointCounts;
+    unsigned int m_chunkEnd;
     unsigned int m_pointCapacity;
 
     unsigned char* m_neighborDataBuf;	//neighbor data buf
     unsigned int m_dataBufSize;			//in bytes
     unsigned int m_dataBufOffset;		//current neighbor data buf offset
+    unsigned int m_lastDataBufBytes;    //bytes in use before the last reset
+
+    ////// statistics
+    unsigned int m_committedPointCounts;
+    unsigned int m_totalNeighborCounts;
+    int m_maxNeighborCounts;
+    unsigned int m_truncatedPointCounts;
+    unsigned int m_growCounts;
 
     ////// temp data for current point
     unsigned short m_currPoint;
     int m_currNeighborCounts;
     unsigned short m_currNeighborIndex[MAX_NEIGHBOR_COUNTS];
-    float m_currNeighborDistance[MAX_NEIGHBOR_COUNTS];
 
 private:
     void _growDataBuf(unsigned int need_size);
@@ -100,6 +182,9 @@ private:
 public:
     NeighborTable();
     ~NeighborTable();
+
+    NeighborTable(const NeighborTable&) = delete;
+    NeighborTable& operator=(const NeighborTable&) = delete;
 };
 
 
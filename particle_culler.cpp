@@ -0,0 +1,140 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "particle_culler.h"
+#include "trace.h"
+
+#include <cmath>
+
+CullGrid CullGrid::fromBox(const glm::vec3 &min, const glm::vec3 &max, float cellSize)
+{
+    CullGrid grid;
+    grid.min = min;
+    grid.res = glm::max(glm::ivec3(glm::ceil((max - min) / cellSize)), glm::ivec3(1));
+    grid.cellSize = (max - min) / glm::vec3(grid.res);
+    return grid;
+}
+
+ParticleCuller::ParticleCuller(unsigned int threadCounts)
+        : m_taskPool(threadCounts)
+        , m_visibleCellCounts(0)
+{
+    m_lodDistances[0] = 60.f;
+    m_lodDistances[1] = 120.f;
+    for (unsigned int& begin : m_bucketBegin) begin = 0;
+}
+
+void ParticleCuller::setLodDistances(float lod1Distance, float lod2Distance)
+{
+    m_lodDistances[0] = lod1Distance;
+    m_lodDistances[1] = lod2Distance;
+}
+
+int ParticleCuller::_getCellIndex(const CullGrid &grid, const glm::vec3 &p) const
+{
+    //particles slightly outside of the grid belong to the border cells
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((p - grid.min) / grid.cellSize)), glm::ivec3(0), grid.res - 1);
+    return (cell.z * grid.res.y + cell.y) * grid.res.x + cell.x;
+}
+
+void ParticleCuller::_classifyCells(const CullGrid &grid, const glm::mat4 &viewProjection, const glm::vec3 &cameraPos,
+                                    float radius)
+{
+    TRACE_SCOPE("cull cells");
+
+    //frustum planes from the rows of the view projection matrix, normals point inside
+    glm::mat4 m = glm::transpose(viewProjection);
+    glm::vec4 planes[6] = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2] };
+
+    unsigned int cellCounts = (unsigned int)(grid.res.x * grid.res.y * grid.res.z);
+    m_cellLods.resize(cellCounts);
+    m_workerVisibleCells.assign(m_taskPool.getThreadCounts(), 0);
+
+    m_taskPool.parallelFor(cellCounts, [&](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        unsigned int visible = 0;
+        for (unsigned int i = begin; i < end; i++)
+        {
+            glm::ivec3 cell((int)(i % grid.res.x), (int)(i / grid.res.x % grid.res.y), (int)(i / grid.res.x / grid.res.y));
+            glm::vec3 boxMin = grid.min + glm::vec3(cell) * grid.cellSize - radius;
+            glm::vec3 boxMax = boxMin + grid.cellSize + 2.f * radius;
+
+            bool inside = true;
+            for (const glm::vec4& plane : planes)
+            {
+                //the box corner farthest along the plane normal
+                glm::vec3 corner(plane.x > 0 ? boxMax.x : boxMin.x, plane.y > 0 ? boxMax.y : boxMin.y, plane.z > 0 ? boxMax.z : boxMin.z);
+                if (glm::dot(glm::vec3(plane), corner) + plane.w < 0)
+                {
+                    inside = false;
+                    break;
+                }
+            }
+            if (!inside)
+            {
+                m_cellLods[i] = -1;
+                continue;
+            }
+
+            float distance = glm::length(0.5f * (boxMin + boxMax) - cameraPos);
+            int lod = 0;
+            while (lod < CULL_LOD_COUNTS - 1 && distance >= m_lodDistances[lod]) lod++;
+            m_cellLods[i] = (signed char)lod;
+            visible++;
+        }
+        m_workerVisibleCells[worker] = visible;
+    });
+
+    m_visibleCellCounts = 0;
+    for (unsigned int visible : m_workerVisibleCells) m_visibleCellCounts += visible;
+}
+
+void ParticleCuller::cull(const glm::vec3 *positions, unsigned int pointCounts, const CullGrid &grid,
+                          const glm::mat4 &viewProjection, const glm::vec3 &cameraPos, float radius,
+                          const unsigned char *selection)
+{
+    TRACE_SCOPE("cull particles");
+
+    _classifyCells(grid, viewProjection, cameraPos, radius);
+
+    //count the particles of every worker and bucket, the same chunks are used again for the scatter
+    unsigned int threadCounts = m_taskPool.getThreadCounts();
+    m_workerCounts.assign(threadCounts * CULL_LOD_COUNTS, 0);
+    m_taskPool.parallelFor(pointCounts, [&](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        unsigned int* counts = &m_workerCounts[worker * CULL_LOD_COUNTS];
+        for (unsigned int i = begin; i < end; i++)
+        {
+            if (selection && !selection[i]) continue;
+            int lod = m_cellLods[_getCellIndex(grid, positions[i])];
+            if (lod >= 0) counts[lod]++;
+        }
+    });
+
+    //bucket by bucket, then worker by worker inside a bucket
+    unsigned int offset = 0;
+    for (int lod = 0; lod < CULL_LOD_COUNTS; lod++)
+    {
+        m_bucketBegin[lod] = offset;
+        for (unsigned int worker = 0; worker < threadCounts; worker++)
+        {
+            unsigned int counts = m_workerCounts[worker * CULL_LOD_COUNTS + lod];
+            m_workerCounts[worker * CULL_LOD_COUNTS + lod] = offset;
+            offset += counts;
+        }
+    }
+    m_bucketBegin[CULL_LOD_COUNTS] = offset;
+    m_visibleIndices.resize(offset);
+
+    m_taskPool.parallelFor(pointCounts, [&](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        unsigned int* cursors = &m_workerCounts[worker * CULL_LOD_COUNTS];
+        for (unsigned int i = begin; i < end; i++)
+        {
+            if (selection && !selection[i]) continue;
+            int lod = m_cellLods[_getCellIndex(grid, positions[i])];
+            if (lod >= 0) m_visibleIndices[cursors[lod]++] = i;
+        }
+    });
+}
@@ -0,0 +1,73 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_PARTICLE_CULLER_H
+#define SIMPLE_FLUID_SIMULATOR_PARTICLE_CULLER_H
+
+#include "task_pool.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/** uniform grid the culler bins particles into, usually the grid of ParticleGridContainer */
+struct CullGrid
+{
+    glm::vec3 min;
+    glm::vec3 cellSize;
+    glm::ivec3 res;
+
+    /** grid covering a box with cells of about the given size */
+    static CullGrid fromBox(const glm::vec3& min, const glm::vec3& max, float cellSize);
+};
+
+enum
+{
+    CULL_LOD_COUNTS = 3,
+};
+
+/** culls particles per grid cell against the view frustum and sorts the visible ones into LOD buckets by the
+ *  distance of their cell to the camera. both passes run on a task pool: cells are classified in parallel,
+ *  then every worker counts and scatters the particle indices of its chunk */
+class ParticleCuller
+{
+public:
+    /** cells closer than lod1Distance go to bucket 0, closer than lod2Distance to bucket 1, others to bucket 2 */
+    void setLodDistances(float lod1Distance, float lod2Distance);
+
+    /** radius pads the cell boxes, particles are drawn as spheres and move a bit after the grid was built.
+     *  particles whose selection byte is 0 are skipped, see selectSurfacePoints */
+    void cull(const glm::vec3* positions, unsigned int pointCounts, const CullGrid& grid,
+              const glm::mat4& viewProjection, const glm::vec3& cameraPos, float radius,
+              const unsigned char* selection = nullptr);
+
+    /** indices of the visible particles, bucket by bucket */
+    const std::vector<unsigned int>& getVisibleIndices() const { return m_visibleIndices; }
+    unsigned int getBucketBegin(int lod) const { return m_bucketBegin[lod]; }
+    unsigned int getBucketCounts(int lod) const { return m_bucketBegin[lod + 1] - m_bucketBegin[lod]; }
+    unsigned int getVisibleCounts() const { return m_bucketBegin[CULL_LOD_COUNTS]; }
+    unsigned int getVisibleCellCounts() const { return m_visibleCellCounts; }
+    unsigned int getCellCounts() const { return (unsigned int)m_cellLods.size(); }
+
+    unsigned int getThreadCounts() const { return m_taskPool.getThreadCounts(); }
+
+private:
+    void _classifyCells(const CullGrid& grid, const glm::mat4& viewProjection, const glm::vec3& cameraPos, float radius);
+    int _getCellIndex(const CullGrid& grid, const glm::vec3& p) const;
+
+private:
+    TaskPool m_taskPool;
+    float m_lodDistances[CULL_LOD_COUNTS - 1];
+
+    std::vector<signed char> m_cellLods;            // -1 if outside of the frustum
+    std::vector<unsigned int> m_workerVisibleCells;
+    std::vector<unsigned int> m_workerCounts;       // [worker * CULL_LOD_COUNTS + lod]
+    std::vector<unsigned int> m_visibleIndices;
+    unsigned int m_bucketBegin[CULL_LOD_COUNTS + 1];
+    unsigned int m_visibleCellCounts;
+
+public:
+    explicit ParticleCuller(unsigned int threadCounts);
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_PARTICLE_CULLER_H
@@ -0,0 +1,50 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "point_export.h"
+
+#include <cstdio>
+
+unsigned int selectSurfacePoints(const unsigned char *surfaceFlags, unsigned int pointCounts, unsigned int interiorStride,
+                                 std::vector<unsigned char> &selection)
+{
+    selection.resize(pointCounts);
+    unsigned int selectedCounts = 0;
+    for (unsigned int i = 0; i < pointCounts; i++)
+    {
+        //indices are in no spatial order, a stride samples the interior evenly enough
+        bool selected = surfaceFlags[i] != 0 || (interiorStride > 0 && i % interiorStride == 0);
+        selection[i] = selected ? 1 : 0;
+        if (selected) selectedCounts++;
+    }
+    return selectedCounts;
+}
+
+bool writePointsPly(const char *path, const glm::vec3 *positions, const glm::vec3 *velocities, unsigned int pointCounts,
+                    const unsigned char *selection)
+{
+    unsigned int selectedCounts = 0;
+    for (unsigned int i = 0; i < pointCounts; i++)
+    {
+        if (!selection || selection[i]) selectedCounts++;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %u\n"
+                  "property float x\nproperty float y\nproperty float z\n", selectedCounts);
+    if (velocities) fprintf(file, "property float vx\nproperty float vy\nproperty float vz\n");
+    fprintf(file, "end_header\n");
+
+    for (unsigned int i = 0; i < pointCounts; i++)
+    {
+        if (selection && !selection[i]) continue;
+        fwrite(&positions[i], sizeof(glm::vec3), 1, file);
+        if (velocities) fwrite(&velocities[i], sizeof(glm::vec3), 1, file);
+    }
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,22 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_POINT_EXPORT_H
+#define SIMPLE_FLUID_SIMULATOR_POINT_EXPORT_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/** marks the particles worth drawing or exporting: every surface particle and every interiorStride-th interior
+ *  one, so the inside of the fluid is still sampled sparsely. interiorStride 0 drops the interior.
+ *  returns the number of selected particles */
+unsigned int selectSurfacePoints(const unsigned char* surfaceFlags, unsigned int pointCounts, unsigned int interiorStride,
+                                 std::vector<unsigned char>& selection);
+
+/** writes the selected particles as a binary little endian ply point cloud with positions and velocities,
+ *  every particle when selection is null. velocities may be null */
+bool writePointsPly(const char* path, const glm::vec3* positions, const glm::vec3* velocities, unsigned int pointCounts,
+                    const unsigned char* selection);
+
+#endif //SIMPLE_FLUID_SIMULATOR_POINT_EXPORT_H
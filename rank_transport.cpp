@@ -0,0 +1,489 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "rank_transport.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // the size of every message goes in front of it
+    const size_t SIZE_BYTES = sizeof(uint64_t);
+
+    const uint32_t SHARED_TRANSPORT_VERSION = 1;
+    const int MAX_SHARED_RANKS = 64;
+
+    size_t alignTo64(size_t bytes)
+    {
+        return (bytes + 63) & ~(size_t)63;
+    }
+
+    struct PeerProgress
+    {
+        uint64_t sendSize;
+        uint64_t sentBytes;             // of the size and the payload
+        uint64_t recvSize;
+        uint64_t receivedBytes;
+    };
+}
+
+RankTransport::RankTransport()
+        : m_rank(-1)
+        , m_rankCounts(0)
+        , m_sentBytes(0)
+{
+}
+
+bool RankTransport::exchange(const std::vector<std::vector<char> > &sendBufs, std::vector<std::vector<char> > &recvBufs)
+{
+    TRACE_SCOPE("rank exchange");
+
+    if (!isAttached() || (int)sendBufs.size() < m_rankCounts) return false;
+
+    recvBufs.resize(m_rankCounts);
+    recvBufs[m_rank] = sendBufs[m_rank];
+
+    std::vector<PeerProgress> progress(m_rankCounts);
+    for (int peer = 0; peer < m_rankCounts; peer++)
+    {
+        progress[peer].sendSize = sendBufs[peer].size();
+        progress[peer].sentBytes = 0;
+        progress[peer].recvSize = 0;
+        progress[peer].receivedBytes = 0;
+    }
+
+    //every peer is written and read a little at a time, so two ranks sending each other more than the transport
+    //buffers never wait for each other
+    std::vector<int> readPeers;
+    std::vector<int> writePeers;
+    for (;;)
+    {
+        bool moved = false;
+        readPeers.clear();
+        writePeers.clear();
+
+        for (int peer = 0; peer < m_rankCounts; peer++)
+        {
+            if (peer == m_rank) continue;
+            PeerProgress& p = progress[peer];
+
+            uint64_t sendTotal = SIZE_BYTES + p.sendSize;
+            if (p.sentBytes < sendTotal)
+            {
+                const char* data = p.sentBytes < SIZE_BYTES ? (const char*)&p.sendSize + p.sentBytes
+                                                            : sendBufs[peer].data() + (p.sentBytes - SIZE_BYTES);
+                size_t left = p.sentBytes < SIZE_BYTES ? SIZE_BYTES - p.sentBytes : sendTotal - p.sentBytes;
+                long written = _write(peer, data, left);
+                if (written < 0) return false;
+                p.sentBytes += written;
+                m_sentBytes += written;
+                moved = moved || written > 0;
+                if (p.sentBytes < sendTotal) writePeers.push_back(peer);
+            }
+
+            uint64_t recvTotal = SIZE_BYTES + p.recvSize;
+            if (p.receivedBytes < recvTotal)
+            {
+                char* data = p.receivedBytes < SIZE_BYTES ? (char*)&p.recvSize + p.receivedBytes
+                                                          : recvBufs[peer].data() + (p.receivedBytes - SIZE_BYTES);
+                size_t left = p.receivedBytes < SIZE_BYTES ? SIZE_BYTES - p.receivedBytes : recvTotal - p.receivedBytes;
+                long read = _read(peer, data, left);
+                if (read < 0) return false;
+                p.receivedBytes += read;
+                moved = moved || read > 0;
+                if (p.receivedBytes == SIZE_BYTES && read > 0)
+                {
+                    recvBufs[peer].resize(p.recvSize);
+                    recvTotal = SIZE_BYTES + p.recvSize;
+                }
+                if (p.receivedBytes < recvTotal) readPeers.push_back(peer);
+            }
+        }
+
+        if (readPeers.empty() && writePeers.empty()) return true;
+        if (!moved && !_wait(readPeers, writePeers)) return false;
+    }
+}
+
+SocketTransport::SocketTransport()
+{
+}
+
+SocketTransport::~SocketTransport()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool SocketTransport::create(int)
+{
+    // posix sockets only
+    return false;
+}
+
+bool SocketTransport::attach(int)
+{
+    return false;
+}
+
+void SocketTransport::close()
+{
+}
+
+long SocketTransport::_write(int, const void*, size_t)
+{
+    return -1;
+}
+
+long SocketTransport::_read(int, void*, size_t)
+{
+    return -1;
+}
+
+bool SocketTransport::_wait(const std::vector<int>&, const std::vector<int>&)
+{
+    return false;
+}
+
+#else
+
+bool SocketTransport::create(int rankCounts)
+{
+    close();
+    if (rankCounts < 1) return false;
+
+    m_rankCounts = rankCounts;
+    m_sockets.assign(rankCounts * rankCounts, -1);
+    for (int a = 0; a < rankCounts; a++)
+    {
+        for (int b = a + 1; b < rankCounts; b++)
+        {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            {
+                close();
+                return false;
+            }
+            for (int end = 0; end < 2; end++)
+            {
+                fcntl(pair[end], F_SETFL, fcntl(pair[end], F_GETFL) | O_NONBLOCK);
+            }
+            m_sockets[a * rankCounts + b] = pair[0];
+            m_sockets[b * rankCounts + a] = pair[1];
+        }
+    }
+    return true;
+}
+
+bool SocketTransport::attach(int rank)
+{
+    if (rank < 0 || rank >= m_rankCounts || m_sockets.empty()) return false;
+
+    //the ends of the other ranks belong to their processes
+    for (int a = 0; a < m_rankCounts; a++)
+    {
+        if (a == rank) continue;
+        for (int b = 0; b < m_rankCounts; b++)
+        {
+            int& socket = m_sockets[a * m_rankCounts + b];
+            if (socket >= 0) ::close(socket);
+            socket = -1;
+        }
+    }
+    m_rank = rank;
+    m_sentBytes = 0;
+    return true;
+}
+
+void SocketTransport::close()
+{
+    for (int socket : m_sockets)
+    {
+        if (socket >= 0) ::close(socket);
+    }
+    m_sockets.clear();
+    m_rank = -1;
+    m_rankCounts = 0;
+}
+
+long SocketTransport::_write(int peer, const void *data, size_t size)
+{
+    ssize_t written = send(m_sockets[m_rank * m_rankCounts + peer], data, size, MSG_NOSIGNAL);
+    if (written >= 0) return (long)written;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+}
+
+long SocketTransport::_read(int peer, void *data, size_t size)
+{
+    ssize_t read = recv(m_sockets[m_rank * m_rankCounts + peer], data, size, 0);
+    //the peer closed its end
+    if (read == 0) return -1;
+    if (read > 0) return (long)read;
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+}
+
+bool SocketTransport::_wait(const std::vector<int> &readPeers, const std::vector<int> &writePeers)
+{
+    std::vector<pollfd> fds;
+    for (int peer : readPeers) fds.push_back({ m_sockets[m_rank * m_rankCounts + peer], POLLIN, 0 });
+    for (int peer : writePeers) fds.push_back({ m_sockets[m_rank * m_rankCounts + peer], POLLOUT, 0 });
+
+    //a hung up peer wakes the poll, the next read or write reports it
+    int ready = poll(fds.data(), fds.size(), 1000);
+    return ready >= 0 || errno == EINTR;
+}
+
+#endif
+
+// one direction between two ranks, head and tail count all bytes ever written and read
+struct alignas(64) SharedRing
+{
+    std::atomic<uint64_t> head;
+    char headPadding[56];
+    std::atomic<uint64_t> tail;
+    char tailPadding[56];
+};
+
+struct SharedMemoryTransport::Header
+{
+    char magic[8];                          // "SPHRANK\0"
+    uint32_t version;
+    uint32_t rankCounts;
+    uint64_t ringBytes;                     // payload of one ring
+    uint64_t ringStride;                    // distance between two rings
+    std::atomic<int32_t> pids[MAX_SHARED_RANKS];    // 0 before a rank attaches, -1 after it detached
+};
+
+SharedMemoryTransport::SharedMemoryTransport()
+        : m_header(nullptr)
+        , m_size(0)
+        , m_creatorPid(0)
+{
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    close();
+}
+
+SharedRing *SharedMemoryTransport::_getRing(int from, int to) const
+{
+    size_t ring = (size_t)from * m_header->rankCounts + to;
+    return (SharedRing*)((unsigned char*)m_header + alignTo64(sizeof(Header)) + ring * m_header->ringStride);
+}
+
+long SharedMemoryTransport::_write(int peer, const void *data, size_t size)
+{
+    SharedRing* ring = _getRing(m_rank, peer);
+    uint64_t ringBytes = m_header->ringBytes;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+    size_t counts = (size_t)std::min<uint64_t>(size, ringBytes - (head - tail));
+    char* payload = (char*)(ring + 1);
+    size_t offset = (size_t)(head % ringBytes);
+    size_t first = std::min(counts, (size_t)ringBytes - offset);
+    memcpy(payload + offset, data, first);
+    memcpy(payload, (const char*)data + first, counts - first);
+
+    ring->head.store(head + counts, std::memory_order_release);
+    return (long)counts;
+}
+
+long SharedMemoryTransport::_read(int peer, void *data, size_t size)
+{
+    SharedRing* ring = _getRing(peer, m_rank);
+    uint64_t ringBytes = m_header->ringBytes;
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+
+    size_t counts = (size_t)std::min<uint64_t>(size, head - tail);
+    const char* payload = (const char*)(ring + 1);
+    size_t offset = (size_t)(tail % ringBytes);
+    size_t first = std::min(counts, (size_t)ringBytes - offset);
+    memcpy(data, payload + offset, first);
+    memcpy((char*)data + first, payload, counts - first);
+
+    ring->tail.store(tail + counts, std::memory_order_release);
+    return (long)counts;
+}
+
+bool SharedMemoryTransport::_wait(const std::vector<int> &readPeers, const std::vector<int> &writePeers)
+{
+    //peers usually answer within a few time slices, spin on the rings before sleeping
+    for (int spin = 0; spin < 1000; spin++)
+    {
+        for (int peer : readPeers)
+        {
+            SharedRing* ring = _getRing(peer, m_rank);
+            if (ring->head.load(std::memory_order_acquire) != ring->tail.load(std::memory_order_relaxed)) return true;
+        }
+        for (int peer : writePeers)
+        {
+            SharedRing* ring = _getRing(m_rank, peer);
+            if (ring->head.load(std::memory_order_relaxed) - ring->tail.load(std::memory_order_acquire) < m_header->ringBytes) return true;
+        }
+        std::this_thread::yield();
+    }
+
+    for (int peer : readPeers)
+    {
+        if (!_isAlive(peer)) return false;
+    }
+    for (int peer : writePeers)
+    {
+        if (!_isAlive(peer)) return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    return true;
+}
+
+#ifdef _WIN32
+
+bool SharedMemoryTransport::create(const char *, int, size_t)
+{
+    // posix shared memory only
+    return false;
+}
+
+bool SharedMemoryTransport::attach(const char *, int)
+{
+    return false;
+}
+
+void SharedMemoryTransport::close()
+{
+}
+
+bool SharedMemoryTransport::_isAlive(int) const
+{
+    return false;
+}
+
+#else
+
+bool SharedMemoryTransport::create(const char *name, int rankCounts, size_t ringBytes)
+{
+    close();
+    if (rankCounts < 1 || rankCounts > MAX_SHARED_RANKS || ringBytes == 0) return false;
+
+    shm_unlink(name);
+    int file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (file < 0) return false;
+
+    size_t ringStride = alignTo64(sizeof(SharedRing) + ringBytes);
+    size_t size = alignTo64(sizeof(Header)) + (size_t)rankCounts * rankCounts * ringStride;
+    void* data = MAP_FAILED;
+    if (ftruncate(file, (off_t)size) == 0)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return false;
+    }
+
+    m_header = new (data) Header();
+    m_header->version = SHARED_TRANSPORT_VERSION;
+    m_header->rankCounts = (uint32_t)rankCounts;
+    m_header->ringBytes = ringBytes;
+    m_header->ringStride = ringStride;
+    for (int i = 0; i < MAX_SHARED_RANKS; i++) m_header->pids[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < rankCounts * rankCounts; i++)
+    {
+        SharedRing* ring = new (_getRing(i / rankCounts, i % rankCounts)) SharedRing();
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+    }
+    //processes attaching by name check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_header->magic, "SPHRANK\0", 8);
+
+    m_name = name;
+    m_size = size;
+    m_creatorPid = (int)getpid();
+    m_rankCounts = rankCounts;
+    return true;
+}
+
+bool SharedMemoryTransport::attach(const char *name, int rank)
+{
+    //ranks forked after create already share the mapping
+    if (!m_header)
+    {
+        int file = shm_open(name, O_RDWR, 0600);
+        if (file < 0) return false;
+
+        struct stat info;
+        void* data = MAP_FAILED;
+        if (fstat(file, &info) == 0 && (size_t)info.st_size >= sizeof(Header))
+        {
+            data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        }
+        ::close(file);
+        if (data == MAP_FAILED) return false;
+
+        m_header = (Header*)data;
+        m_size = (size_t)info.st_size;
+        m_name = name;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (memcmp(m_header->magic, "SPHRANK\0", 8) != 0 || m_header->version != SHARED_TRANSPORT_VERSION)
+        {
+            close();
+            return false;
+        }
+        m_rankCounts = (int)m_header->rankCounts;
+    }
+
+    if (rank < 0 || rank >= m_rankCounts) return false;
+    m_header->pids[rank].store((int32_t)getpid(), std::memory_order_release);
+    m_rank = rank;
+    m_sentBytes = 0;
+    return true;
+}
+
+void SharedMemoryTransport::close()
+{
+    if (!m_header) return;
+
+    if (m_rank >= 0) m_header->pids[m_rank].store(-1, std::memory_order_release);
+    munmap(m_header, m_size);
+    if (m_creatorPid == (int)getpid()) shm_unlink(m_name.c_str());
+
+    m_header = nullptr;
+    m_size = 0;
+    m_creatorPid = 0;
+    m_rank = -1;
+    m_rankCounts = 0;
+}
+
+bool SharedMemoryTransport::_isAlive(int peer) const
+{
+    int32_t pid = m_header->pids[peer].load(std::memory_order_acquire);
+    //a rank which hasn't attached yet is still starting
+    if (pid == 0) return true;
+    if (pid < 0) return false;
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+#endif
@@ -0,0 +1,110 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_RANK_TRANSPORT_H
+#define SIMPLE_FLUID_SIMULATOR_RANK_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** moves messages between the processes of a DistributedSystem, every process is a rank and every rank can
+ *  reach every other one. exchange is the only operation, an all to all step which every rank calls the same
+ *  number of times. implementations only move bytes to and from one peer without blocking and wait for peers,
+ *  see SocketTransport and SharedMemoryTransport for the local ones */
+class RankTransport
+{
+public:
+    int getRank() const { return m_rank; }
+    int getRankCounts() const { return m_rankCounts; }
+    bool isAttached() const { return m_rank >= 0; }
+
+    /** send sendBufs[r] to every rank r and receive what every rank sent to this one into recvBufs[r], the own
+     *  buffer is copied. blocks until all messages are through, false if a peer is gone */
+    bool exchange(const std::vector<std::vector<char> >& sendBufs, std::vector<std::vector<char> >& recvBufs);
+
+    /** bytes sent to other ranks since attach, message sizes included */
+    uint64_t getSentBytes() const { return m_sentBytes; }
+
+protected:
+    /** move up to size bytes to or from peer without blocking, returns the bytes moved or -1 if the peer is gone */
+    virtual long _write(int peer, const void* data, size_t size) = 0;
+    virtual long _read(int peer, void* data, size_t size) = 0;
+    /** block for a short while until one of the peers can likely be read or written, false if one is gone */
+    virtual bool _wait(const std::vector<int>& readPeers, const std::vector<int>& writePeers) = 0;
+
+protected:
+    int m_rank;
+    int m_rankCounts;
+    uint64_t m_sentBytes;
+
+public:
+    RankTransport();
+    virtual ~RankTransport() {}
+
+    RankTransport(const RankTransport&) = delete;
+    RankTransport& operator=(const RankTransport&) = delete;
+};
+
+/** a pair of connected Unix sockets between every two ranks. create makes all of them before the ranks are
+ *  forked, every forked process then attaches with its rank and closes the sockets of the others */
+class SocketTransport : public RankTransport
+{
+public:
+    bool create(int rankCounts);
+    bool attach(int rank);
+    void close();
+
+protected:
+    long _write(int peer, const void* data, size_t size) override;
+    long _read(int peer, void* data, size_t size) override;
+    bool _wait(const std::vector<int>& readPeers, const std::vector<int>& writePeers) override;
+
+private:
+    // m_sockets[a * rankCounts + b] is the end rank a uses to talk to rank b
+    std::vector<int> m_sockets;
+
+public:
+    SocketTransport();
+    ~SocketTransport() override;
+};
+
+struct SharedRing;
+
+/** a ring buffer in POSIX shared memory for every ordered pair of ranks, written by one rank and read by the
+ *  other without locks. ranks forked after create share its mapping, other processes attach by name.
+ *  a peer which exits without detaching is noticed by its pid */
+class SharedMemoryTransport : public RankTransport
+{
+public:
+    /** create the segment /name with rings of ringBytes, a segment left over by a crashed run is replaced */
+    bool create(const char* name, int rankCounts, size_t ringBytes = 1 << 20);
+    bool attach(const char* name, int rank);
+    void close();
+
+protected:
+    long _write(int peer, const void* data, size_t size) override;
+    long _read(int peer, void* data, size_t size) override;
+    bool _wait(const std::vector<int>& readPeers, const std::vector<int>& writePeers) override;
+
+private:
+    struct Header;
+
+    SharedRing* _getRing(int from, int to) const;
+    bool _isAlive(int peer) const;
+
+private:
+    std::string m_name;
+    Header* m_header;
+    size_t m_size;
+    int m_creatorPid;                   // the process which removes the segment again
+
+public:
+    SharedMemoryTransport();
+    ~SharedMemoryTransport() override;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_RANK_TRANSPORT_H
@@ -0,0 +1,153 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+// Renders into its own framebuffer and reads the frames back through a ring of pixel buffer objects.
+// glReadPixels into a pixel pack buffer only queues the copy, a fence tells when it is done. A frame is
+// mapped once its fence is signaled, so reading back never stalls as long as the caller keeps up with the ring.
+class FrameCapture
+{
+public:
+    static const unsigned int PBOS = 3;
+
+    FrameCapture() : FBO(0), m_width(0), m_height(0), m_colorRBO(0), m_depthRBO(0), m_writeIndex(0), m_readIndex(0), m_pendingCounts(0), m_mapped(false)
+    {
+        for (unsigned int i = 0; i < PBOS; i++)
+        {
+            m_PBOs[i] = 0;
+            m_fences[i] = 0;
+        }
+    }
+    ~FrameCapture() { release(); }
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // RGBA8 color and 24 bit depth, returns false if the framebuffer is incomplete
+    bool init(int width, int height)
+    {
+        release();
+        m_width = width;
+        m_height = height;
+
+        glGenRenderbuffers(1, &m_colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &m_depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRBO);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(PBOS, m_PBOs);
+        for (unsigned int i = 0; i < PBOS; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PBOs[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, getFrameBytes(), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return complete;
+    }
+
+    void release()
+    {
+        if (m_mapped) unmap();
+        for (unsigned int i = 0; i < PBOS; i++)
+        {
+            if (m_fences[i]) glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+        if (m_PBOs[0]) glDeleteBuffers(PBOS, m_PBOs);
+        for (unsigned int i = 0; i < PBOS; i++) m_PBOs[i] = 0;
+        if (FBO) glDeleteFramebuffers(1, &FBO);
+        if (m_colorRBO) glDeleteRenderbuffers(1, &m_colorRBO);
+        if (m_depthRBO) glDeleteRenderbuffers(1, &m_depthRBO);
+        FBO = m_colorRBO = m_depthRBO = 0;
+        m_writeIndex = m_readIndex = m_pendingCounts = 0;
+    }
+
+    // draw into the capture framebuffer
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, m_width, m_height);
+    }
+
+    // queue the copy of the current frame, the ring must not be full
+    void readPixels()
+    {
+        if (isFull()) return;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PBOs[m_writeIndex]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+        m_fences[m_writeIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_writeIndex = (m_writeIndex + 1) % PBOS;
+        m_pendingCounts++;
+    }
+
+    // pixels of the oldest queued frame, bottom row first. without wait it returns null until the copy is done.
+    // call unmap before the next readPixels
+    const unsigned char* map(bool wait)
+    {
+        if (m_pendingCounts == 0 || m_mapped) return nullptr;
+
+        GLsync fence = m_fences[m_readIndex];
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return nullptr;
+        glDeleteSync(fence);
+        m_fences[m_readIndex] = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PBOs[m_readIndex]);
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, getFrameBytes(), GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_mapped = true;
+        return pixels;
+    }
+
+    void unmap()
+    {
+        if (!m_mapped) return;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PBOs[m_readIndex]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_mapped = false;
+        m_readIndex = (m_readIndex + 1) % PBOS;
+        m_pendingCounts--;
+    }
+
+    bool isFull() const { return m_pendingCounts == PBOS; }
+    unsigned int getPendingCounts() const { return m_pendingCounts; }
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    GLsizeiptr getFrameBytes() const { return (GLsizeiptr)m_width * m_height * 4; }
+
+public:
+    unsigned int FBO;
+
+private:
+    int m_width;
+    int m_height;
+    unsigned int m_colorRBO;
+    unsigned int m_depthRBO;
+    unsigned int m_PBOs[PBOS];
+    GLsync m_fences[PBOS];
+    unsigned int m_writeIndex;      // next PBO glReadPixels writes to
+    unsigned int m_readIndex;       // oldest queued frame
+    unsigned int m_pendingCounts;
+    bool m_mapped;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// measures GPU time of a block of commands with GL_TIME_ELAPSED queries. results are read QUERIES - 1
+// frames later so the CPU never waits for the GPU
+class GpuTimer
+{
+public:
+    static const unsigned int QUERIES = 4;
+
+    GpuTimer() : m_frame(0), m_lastTime(0.f), m_created(false) {}
+    ~GpuTimer() { release(); }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    void begin()
+    {
+        if (!m_created)
+        {
+            glGenQueries(QUERIES, m_queries);
+            m_created = true;
+        }
+
+        // the query written QUERIES - 1 frames ago is done by now
+        if (m_frame >= QUERIES)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(m_queries[m_frame % QUERIES], GL_QUERY_RESULT, &elapsed);
+            m_lastTime = elapsed / 1000000.f;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_frame % QUERIES]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_frame++;
+    }
+
+    void release()
+    {
+        if (m_created) glDeleteQueries(QUERIES, m_queries);
+        m_created = false;
+        m_frame = 0;
+    }
+
+    // milliseconds
+    float getLastTime() const { return m_lastTime; }
+
+private:
+    GLuint m_queries[QUERIES];
+    unsigned int m_frame;
+    float m_lastTime;
+    bool m_created;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// OpenGL context without a window or a display, for offscreen rendering when glfw can't open one.
+// It uses the surfaceless platform of Mesa when available, so it works with llvmpipe in a container.
+// There is no default framebuffer, everything has to be drawn into a framebuffer object
+class HeadlessContext
+{
+public:
+    HeadlessContext() : m_display(EGL_NO_DISPLAY), m_context(EGL_NO_CONTEXT) {}
+    ~HeadlessContext() { release(); }
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // core profile context, made current on the calling thread
+    bool create(int major, int minor)
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (m_display == EGL_NO_DISPLAY) m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+        {
+            m_display = EGL_NO_DISPLAY;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            release();
+            return false;
+        }
+
+        EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint configCounts = 0;
+        eglChooseConfig(m_display, configAttributes, &config, 1, &configCounts);
+
+        EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, major,
+                EGL_CONTEXT_MINOR_VERSION, minor,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE };
+        m_context = eglCreateContext(m_display, configCounts > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+        if (m_context == EGL_NO_CONTEXT || !eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+        {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    void release()
+    {
+        if (m_display == EGL_NO_DISPLAY) return;
+
+        eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_context != EGL_NO_CONTEXT) eglDestroyContext(m_display, m_context);
+        eglTerminate(m_display);
+        m_display = EGL_NO_DISPLAY;
+        m_context = EGL_NO_CONTEXT;
+    }
+
+    // loader for glad
+    static void* getProcAddress(const char* name) { return (void*)eglGetProcAddress(name); }
+
+private:
+    EGLDisplay m_display;
+    EGLContext m_context;
+};
+
+#endif
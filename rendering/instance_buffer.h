@@ -0,0 +1,197 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+// glBufferStorage is GL 4.4 / ARB_buffer_storage, the glad loader only covers GL 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Streams one or more vec3 per instance to the GPU, 12 bytes each instead of a 64 byte model matrix.
+// The buffer is split into SEGMENTS parts which are written round robin. A fence after each draw tells
+// when the GPU is done with a part, so writing the next frame never waits for the frame being drawn.
+// With buffer storage the whole buffer stays mapped, otherwise each part is mapped unsynchronized.
+class InstanceBuffer
+{
+public:
+    static const unsigned int SEGMENTS = 3;
+
+    InstanceBuffer()
+        : ID(0), m_capacity(0), m_components(1), m_segment(0), m_counts(0), m_persistent(false), m_mapped(nullptr), m_bufferStorage(nullptr)
+    {
+        for (unsigned int i = 0; i < SEGMENTS; i++) m_fences[i] = 0;
+    }
+    ~InstanceBuffer() { release(); }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // loadProc is the loader passed to glad, buffer storage is used when the context supports it.
+    // components is the number of vec3 per instance, they go to consecutive attribute locations
+    void init(unsigned int capacity, GLADloadproc loadProc, unsigned int components = 1)
+    {
+        m_components = components > 0 ? components : 1;
+        if (_hasBufferStorage())
+        {
+            m_bufferStorage = (PFN_glBufferStorage)loadProc("glBufferStorage");
+        }
+        _allocate(capacity);
+    }
+
+    void release()
+    {
+        for (unsigned int i = 0; i < SEGMENTS; i++)
+        {
+            if (m_fences[i]) glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+        if (ID)
+        {
+            if (m_persistent)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, ID);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &ID);
+        }
+        ID = 0;
+        m_capacity = 0;
+        m_mapped = nullptr;
+    }
+
+    // space for counts instances of this frame, grows the buffer if needed
+    glm::vec3* map(unsigned int counts)
+    {
+        if (counts > m_capacity) _allocate(counts + counts / 2);
+
+        m_segment = (m_segment + 1) % SEGMENTS;
+        m_counts = counts;
+
+        // only waits if the GPU is SEGMENTS - 1 frames behind
+        if (m_fences[m_segment])
+        {
+            glClientWaitSync(m_fences[m_segment], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(m_fences[m_segment]);
+            m_fences[m_segment] = 0;
+        }
+
+        if (m_persistent) return (glm::vec3*)(m_mapped + _segmentOffset());
+
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        void* data = glMapBufferRange(GL_ARRAY_BUFFER, _segmentOffset(), (counts > 0 ? counts : 1) * _instanceBytes(),
+                                      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return (glm::vec3*)data;
+    }
+
+    void unmap()
+    {
+        if (m_persistent) return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // point the instanced vec3 attributes of a vertex array at the current segment, starting at firstInstance
+    void bindAttribute(unsigned int VAO, unsigned int location, unsigned int firstInstance = 0) const
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        for (unsigned int i = 0; i < m_components; i++)
+        {
+            GLintptr offset = _segmentOffset() + (GLintptr)firstInstance * _instanceBytes() + i * sizeof(glm::vec3);
+            glEnableVertexAttribArray(location + i);
+            glVertexAttribPointer(location + i, 3, GL_FLOAT, GL_FALSE, _instanceBytes(), (void*)offset);
+            glVertexAttribDivisor(location + i, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // call after the last draw reading the current segment
+    void fence()
+    {
+        m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool isPersistent() const { return m_persistent; }
+    unsigned int getCapacity() const { return m_capacity; }
+    unsigned int getCounts() const { return m_counts; }
+
+public:
+    unsigned int ID;
+
+private:
+    static bool _hasBufferStorage()
+    {
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4)) return true;
+
+        GLint extensionCounts = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCounts);
+        for (GLint i = 0; i < extensionCounts; i++)
+        {
+            const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (name && strcmp(name, "GL_ARB_buffer_storage") == 0) return true;
+        }
+        return false;
+    }
+
+    GLsizei _instanceBytes() const { return (GLsizei)(m_components * sizeof(glm::vec3)); }
+    GLintptr _segmentOffset() const { return (GLintptr)m_segment * m_capacity * _instanceBytes(); }
+
+    void _allocate(unsigned int capacity)
+    {
+        // the GPU may still read the old buffer
+        if (ID) glFinish();
+        release();
+
+        m_capacity = capacity > 0 ? capacity : 1;
+        GLsizeiptr size = (GLsizeiptr)SEGMENTS * m_capacity * _instanceBytes();
+
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        m_persistent = false;
+        if (m_bufferStorage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            m_bufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            m_mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+            m_persistent = m_mapped != nullptr;
+            if (!m_persistent)
+            {
+                // storage is immutable, start over with a plain buffer
+                glDeleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                glBindBuffer(GL_ARRAY_BUFFER, ID);
+                m_bufferStorage = nullptr;
+            }
+        }
+        if (!m_persistent)
+        {
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    unsigned int m_capacity;            // instances per segment
+    unsigned int m_components;          // vec3 per instance
+    unsigned int m_segment;
+    unsigned int m_counts;
+    GLsync m_fences[SEGMENTS];
+    bool m_persistent;
+    unsigned char* m_mapped;
+    PFN_glBufferStorage m_bufferStorage;
+};
+
+#endif
@@ -13,16 +13,56 @@
 #include <mesh.h>
 #include <shader.h>
 
+#include "asset_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <utility>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// the part of a mesh that doesn't need GL, it can be loaded on any thread
+struct MeshData
+{
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<pair<string, string> > textures;     // type and path of every material texture
+};
+
+struct ModelData
+{
+    vector<MeshData> meshes;
+    string directory;
+    bool fromCache = false;
+};
+
+// flat cache entry of a model: the header, one record per mesh, then the arrays. every array starts on 16 bytes
+// so the mapped file can be read in place
+struct ModelCacheHeader
+{
+    char magic[8];                              // "SPHMESH\0"
+    uint32_t version;
+    uint32_t vertexBytes;                       // sizeof(Vertex) of the writer
+    uint32_t meshCounts;
+    uint32_t reserved;
+};
+
+struct ModelCacheMesh
+{
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;                     // type and path of every texture, each one zero terminated
+    uint32_t vertexCounts;
+    uint32_t indexCounts;
+    uint32_t textureBytes;
+    uint32_t reserved;
+};
+
 class Model
 {
 public:
@@ -32,10 +72,46 @@ public:
     string directory;
     bool gammaCorrection;
 
+    static const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    static const uint32_t CACHE_VERSION = 1;
+
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelData data;
+        loadData(path, data);
+        upload(data);
+    }
+
+    // creates the GL buffers of data loaded before, the arrays are moved into the meshes
+    Model(ModelData &data, bool gamma = false) : gammaCorrection(gamma)
+    {
+        upload(data);
+    }
+
+    // reads a model without touching GL, from the cache when it holds this version of the file. safe on any thread
+    static bool loadData(string const &path, ModelData &data, AssetCache *cache = nullptr)
+    {
+        data = ModelData();
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // the entry depends on the file, the import and the vertex layout
+        const uint32_t recipe[3] = { CACHE_VERSION, IMPORT_FLAGS, (uint32_t)sizeof(Vertex) };
+        uint64_t key = 0;
+        bool hashed = cache && cache->isEnabled() && AssetCache::hashFile(path.c_str(), AssetCache::hashBytes(recipe, sizeof(recipe)), key);
+        if (hashed)
+        {
+            MappedFile file;
+            if (cache->load(key, "mesh", file) && readCache(file, data))
+            {
+                data.fromCache = true;
+                return true;
+            }
+        }
+
+        if (!loadModel(path, data)) return false;
+        if (hashed) writeCache(*cache, key, data);
+        return true;
     }
 
     // draws the model, and thus all its meshes
@@ -46,27 +122,37 @@ public:
     }
 
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // creates the meshes and loads their textures, needs a current GL context
+    void upload(ModelData &data)
+    {
+        directory = data.directory;
+        for(unsigned int i = 0; i < data.meshes.size(); i++)
+        {
+            MeshData& mesh = data.meshes[i];
+            meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), loadMaterialTextures(mesh.textures)));
+        }
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in data.
+    static bool loadModel(string const &path, ModelData &data)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -74,27 +160,27 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex>& vertices = data.vertices;
+        vector<unsigned int>& indices = data.indices;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {}; // zeroed, the cache stores the attributes a mesh doesn't have as well
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -152,36 +238,43 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data);
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the mesh data, the GL buffers are created by upload
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // records type and path of all material textures of a given type, they are loaded by loadMaterialTextures.
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, const char *typeName, MeshData &data)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
+            data.textures.push_back(make_pair(string(typeName), string(str.C_Str())));
+        }
+    }
+
+    // loads the textures of a mesh if they're not loaded yet.
+    // the required info is returned as a Texture struct.
+    vector<Texture> loadMaterialTextures(const vector<pair<string, string> > &materialTextures)
+    {
+        vector<Texture> textures;
+        for(unsigned int i = 0; i < materialTextures.size(); i++)
+        {
+            const string& typeName = materialTextures[i].first;
+            const string& path = materialTextures[i].second;
             // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
             bool skip = false;
             for(unsigned int j = 0; j < textures_loaded.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                if(textures_loaded[j].path == path)
                 {
                     textures.push_back(textures_loaded[j]);
                     skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
@@ -191,15 +284,108 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = TextureFromFile(path.c_str(), this->directory);
                 texture.type = typeName;
-                texture.path = str.C_Str();
+                texture.path = path;
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
         }
         return textures;
     }
+
+    static uint64_t alignCacheOffset(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    // copies the arrays out of a mapped cache entry, false if it is damaged or from another vertex layout
+    static bool readCache(const MappedFile &file, ModelData &data)
+    {
+        const unsigned char* bytes = file.data();
+        uint64_t size = file.size();
+        if (size < sizeof(ModelCacheHeader)) return false;
+
+        const ModelCacheHeader* header = (const ModelCacheHeader*)bytes;
+        if (memcmp(header->magic, "SPHMESH", 8) != 0 || header->version != CACHE_VERSION ||
+            header->vertexBytes != sizeof(Vertex) ||
+            header->meshCounts > (size - sizeof(ModelCacheHeader)) / sizeof(ModelCacheMesh)) return false;
+
+        const ModelCacheMesh* records = (const ModelCacheMesh*)(bytes + sizeof(ModelCacheHeader));
+        data.meshes.resize(header->meshCounts);
+        for (uint32_t m = 0; m < header->meshCounts; m++)
+        {
+            const ModelCacheMesh& record = records[m];
+            if (record.vertexOffset > size || (uint64_t)record.vertexCounts * sizeof(Vertex) > size - record.vertexOffset ||
+                record.indexOffset > size || (uint64_t)record.indexCounts * sizeof(unsigned int) > size - record.indexOffset ||
+                record.textureOffset > size || record.textureBytes > size - record.textureOffset) return false;
+
+            MeshData& mesh = data.meshes[m];
+            const Vertex* vertices = (const Vertex*)(bytes + record.vertexOffset);
+            const unsigned int* indices = (const unsigned int*)(bytes + record.indexOffset);
+            mesh.vertices.assign(vertices, vertices + record.vertexCounts);
+            mesh.indices.assign(indices, indices + record.indexCounts);
+
+            const char* text = (const char*)(bytes + record.textureOffset);
+            const char* end = text + record.textureBytes;
+            while (text < end)
+            {
+                const char* type = text;
+                const char* path = type + strnlen(type, end - type) + 1;
+                if (path >= end) return false;
+                text = path + strnlen(path, end - path) + 1;
+                if (text > end) return false;
+                mesh.textures.push_back(make_pair(string(type), string(path)));
+            }
+        }
+        return true;
+    }
+
+    static bool writeCache(AssetCache &cache, uint64_t key, const ModelData &data)
+    {
+        ModelCacheHeader header = {};
+        memcpy(header.magic, "SPHMESH", 8);
+        header.version = CACHE_VERSION;
+        header.vertexBytes = sizeof(Vertex);
+        header.meshCounts = (uint32_t)data.meshes.size();
+
+        vector<ModelCacheMesh> records(data.meshes.size());
+        vector<string> textureBlocks(data.meshes.size());
+        uint64_t offset = sizeof(ModelCacheHeader) + records.size() * sizeof(ModelCacheMesh);
+        for (size_t m = 0; m < data.meshes.size(); m++)
+        {
+            const MeshData& mesh = data.meshes[m];
+            for (size_t t = 0; t < mesh.textures.size(); t++)
+            {
+                textureBlocks[m].append(mesh.textures[t].first).push_back('\0');
+                textureBlocks[m].append(mesh.textures[t].second).push_back('\0');
+            }
+
+            ModelCacheMesh& record = records[m];
+            memset(&record, 0, sizeof(record));
+            record.vertexCounts = (uint32_t)mesh.vertices.size();
+            record.indexCounts = (uint32_t)mesh.indices.size();
+            record.textureBytes = (uint32_t)textureBlocks[m].size();
+            record.vertexOffset = offset = alignCacheOffset(offset);
+            offset += mesh.vertices.size() * sizeof(Vertex);
+            record.indexOffset = offset = alignCacheOffset(offset);
+            offset += mesh.indices.size() * sizeof(unsigned int);
+            record.textureOffset = offset;
+            offset += textureBlocks[m].size();
+        }
+
+        vector<unsigned char> blob(offset, 0);
+        memcpy(blob.data(), &header, sizeof(header));
+        if (!records.empty()) memcpy(blob.data() + sizeof(header), records.data(), records.size() * sizeof(ModelCacheMesh));
+        for (size_t m = 0; m < data.meshes.size(); m++)
+        {
+            const MeshData& mesh = data.meshes[m];
+            if (!mesh.vertices.empty()) memcpy(blob.data() + records[m].vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            if (!mesh.indices.empty()) memcpy(blob.data() + records[m].indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            if (!textureBlocks[m].empty()) memcpy(blob.data() + records[m].textureOffset, textureBlocks[m].data(), textureBlocks[m].size());
+        }
+        return cache.store(key, "mesh", blob.data(), blob.size());
+    }
 };
 
 
@@ -4,23 +4,40 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "asset_cache.h"
+
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
-class Shader
+// program binaries are GL 4.1 / ARB_get_program_binary, the glad loader only covers GL 3.3
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP PFN_glGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_glProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_glProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+// the sources of a program, read without touching GL so it can happen on any thread
+struct ShaderSource
 {
-public:
-    unsigned int ID;
-    // constructor generates the shader on the fly
-    // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+    bool hasGeometry = false;
+    uint64_t key = 0;           // hash of the sources, a program binary is only reused for the same ones
+
+    bool read(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -28,6 +45,7 @@ public:
         vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        hasGeometry = geometryPath != nullptr;
         try
         {
             // open files
@@ -56,46 +74,118 @@ public:
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return false;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
+
+        key = AssetCache::hashBytes(vertexCode.data(), vertexCode.size(), 1);
+        key = AssetCache::hashBytes(fragmentCode.data(), fragmentCode.size(), key);
+        if (hasGeometry) key = AssetCache::hashBytes(geometryCode.data(), geometryCode.size(), key);
+        return true;
+    }
+};
+
+// cache entry of a program binary, the binary follows the header
+struct ProgramCacheHeader
+{
+    char magic[8];              // "SPHPROG\0"
+    uint32_t version;
+    uint32_t format;            // binary format of the driver
+    uint64_t driver;            // hash of vendor, renderer and version strings
+    uint32_t length;
+    uint32_t reserved;
+};
+
+class Shader
+{
+public:
+    unsigned int ID;
+    // constructor generates the shader on the fly
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) : m_fromCache(false)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath
+        ShaderSource source;
+        source.read(vertexPath, fragmentPath, geometryPath);
         // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        build(source, false);
+    }
+    // links the program from the binary the driver gave for the same sources last time, otherwise compiles them and
+    // stores the binary for the next start. loadProc is the loader passed to glad, without program binary support
+    // in the context this is the same as compiling
+    // ------------------------------------------------------------------------
+    Shader(const ShaderSource& source, AssetCache* cache, GLADloadproc loadProc) : m_fromCache(false)
+    {
+        PFN_glGetProgramBinary getProgramBinary = nullptr;
+        PFN_glProgramBinary programBinary = nullptr;
+        PFN_glProgramParameteri programParameteri = nullptr;
+        if (cache && cache->isEnabled() && hasProgramBinary())
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            getProgramBinary = (PFN_glGetProgramBinary)loadProc("glGetProgramBinary");
+            programBinary = (PFN_glProgramBinary)loadProc("glProgramBinary");
+            programParameteri = (PFN_glProgramParameteri)loadProc("glProgramParameteri");
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        if (!getProgramBinary || !programBinary || !programParameteri)
+        {
+            build(source, false);
+            return;
+        }
+
+        // a binary only fits the driver that made it
+        std::string driver;
+        const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : names)
+        {
+            const char* text = (const char*)glGetString(name);
+            if (text) driver.append(text).push_back('\n');
+        }
+        uint64_t driverHash = AssetCache::hashBytes(driver.data(), driver.size());
+        uint64_t key = AssetCache::hashBytes(&driverHash, sizeof(driverHash), source.key);
+
+        MappedFile file;
+        if (cache->load(key, "program", file) && file.size() >= sizeof(ProgramCacheHeader))
+        {
+            const ProgramCacheHeader* header = (const ProgramCacheHeader*)file.data();
+            if (memcmp(header->magic, "SPHPROG", 8) == 0 && header->version == 1 && header->driver == driverHash &&
+                header->length <= file.size() - sizeof(ProgramCacheHeader))
+            {
+                ID = glCreateProgram();
+                programBinary(ID, header->format, header + 1, (GLsizei)header->length);
+                GLint success = 0;
+                glGetProgramiv(ID, GL_LINK_STATUS, &success);
+                if (success)
+                {
+                    m_fromCache = true;
+                    return;
+                }
+                // the driver may refuse binaries of an older build of itself
+                glDeleteProgram(ID);
+            }
+        }
+
+        build(source, true, programParameteri);
 
+        GLint success = 0, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0) return;
+
+        std::vector<unsigned char> blob(sizeof(ProgramCacheHeader) + length);
+        ProgramCacheHeader header = {};
+        memcpy(header.magic, "SPHPROG", 8);
+        header.version = 1;
+        header.driver = driverHash;
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(ID, length, &written, &format, blob.data() + sizeof(ProgramCacheHeader));
+        if (written <= 0) return;
+        header.format = format;
+        header.length = (uint32_t)written;
+        memcpy(blob.data(), &header, sizeof(header));
+        cache->store(key, "program", blob.data(), sizeof(ProgramCacheHeader) + written);
     }
+    // true if the program came from a cached binary instead of the sources
+    bool isFromCache() const { return m_fromCache; }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
@@ -162,6 +252,72 @@ public:
     }
 
 private:
+    bool m_fromCache;
+
+    // the GL calls of the file based constructor, compile the sources and link them
+    // ------------------------------------------------------------------------
+    void build(const ShaderSource& source, bool retrievable, PFN_glProgramParameteri programParameteri = nullptr)
+    {
+        const char* vShaderCode = source.vertexCode.c_str();
+        const char * fShaderCode = source.fragmentCode.c_str();
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // if geometry shader is given, compile geometry shader
+        unsigned int geometry;
+        if(source.hasGeometry)
+        {
+            const char * gShaderCode = source.geometryCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            checkCompileErrors(geometry, "GEOMETRY");
+        }
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if(source.hasGeometry)
+            glAttachShader(ID, geometry);
+        // the binary can only be read back if the driver was told before linking
+        if(retrievable && programParameteri)
+            programParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if(source.hasGeometry)
+            glDeleteShader(geometry);
+    }
+
+    static bool hasProgramBinary()
+    {
+        bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+        if (!supported)
+        {
+            GLint extensionCounts = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCounts);
+            for (GLint i = 0; i < extensionCounts && !supported; i++)
+            {
+                const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+                supported = name && strcmp(name, "GL_ARB_get_program_binary") == 0;
+            }
+        }
+        // a driver may support the calls but no format at all
+        GLint formatCounts = 0;
+        if (supported) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCounts);
+        return formatCounts > 0;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
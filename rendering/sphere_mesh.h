@@ -0,0 +1,81 @@
+#ifndef SPHERE_MESH_H
+#define SPHERE_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+// unit uv sphere with positions at attribute 0, the cheap stand in for water.obj at a distance
+class SphereMesh
+{
+public:
+    unsigned int VAO;
+    unsigned int indexCounts;
+
+    SphereMesh() : VAO(0), indexCounts(0), m_VBO(0), m_EBO(0) {}
+    ~SphereMesh() { release(); }
+
+    SphereMesh(const SphereMesh&) = delete;
+    SphereMesh& operator=(const SphereMesh&) = delete;
+
+    void init(unsigned int slices, unsigned int stacks)
+    {
+        release();
+
+        std::vector<glm::vec3> vertices;
+        for (unsigned int stack = 0; stack <= stacks; stack++)
+        {
+            float phi = 3.14159265f * stack / stacks;
+            for (unsigned int slice = 0; slice <= slices; slice++)
+            {
+                float theta = 2.f * 3.14159265f * slice / slices;
+                vertices.push_back(glm::vec3(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta)));
+            }
+        }
+
+        std::vector<unsigned int> indices;
+        for (unsigned int stack = 0; stack < stacks; stack++)
+        {
+            for (unsigned int slice = 0; slice < slices; slice++)
+            {
+                unsigned int a = stack * (slices + 1) + slice;
+                unsigned int b = a + slices + 1;
+                // skip the degenerated triangles at the poles
+                if (stack != 0) { indices.push_back(a); indices.push_back(b); indices.push_back(a + 1); }
+                if (stack != stacks - 1) { indices.push_back(a + 1); indices.push_back(b); indices.push_back(b + 1); }
+            }
+        }
+        indexCounts = (unsigned int)indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &m_VBO);
+        glGenBuffers(1, &m_EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    void release()
+    {
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+        if (m_VBO) glDeleteBuffers(1, &m_VBO);
+        if (m_EBO) glDeleteBuffers(1, &m_EBO);
+        VAO = m_VBO = m_EBO = 0;
+        indexCounts = 0;
+    }
+
+private:
+    unsigned int m_VBO;
+    unsigned int m_EBO;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 ViewPos;
+flat in vec3 ViewCenter;
+
+uniform mat4 projection;
+uniform float sphereRadius;
+
+void main()
+{
+    // ray from the camera through this fragment against the sphere
+    vec3 dir = normalize(ViewPos);
+    float b = dot(dir, ViewCenter);
+    float h = b * b - dot(ViewCenter, ViewCenter) + sphereRadius * sphereRadius;
+    if (h < 0.0) discard;
+
+    vec3 hit = dir * (b - sqrt(h));
+    vec4 clip = projection * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far);
+
+    FragColor = vec4(0.62, 0.85, 0.96, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 3) in vec3 aInstanceOffset;
+layout (location = 4) in vec3 aInstanceDelta;
+
+out vec3 ViewPos;
+flat out vec3 ViewCenter;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float sphereRadius;
+uniform float instanceBlend;    // position at display time is offset + delta * blend
+
+// a camera facing quad around each particle, the fragment shader cuts the sphere out of it.
+// the quad is larger than the sphere so the perspective silhouette still fits inside
+const float QUAD_SCALE = 1.5;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID & 1) == 0 ? -1.0 : 1.0, (gl_VertexID & 2) == 0 ? -1.0 : 1.0);
+    ViewCenter = (view * vec4(aInstanceOffset + aInstanceDelta * instanceBlend, 1.0)).xyz;
+    ViewPos = ViewCenter + vec3(corner * sphereRadius * QUAD_SCALE, 0.0);
+    gl_Position = projection * vec4(ViewPos, 1.0);
+}
\ No newline at end of file
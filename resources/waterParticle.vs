@@ -1,15 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 aInstanceMatrix;
+layout (location = 3) in vec3 aInstanceOffset;
+layout (location = 4) in vec3 aInstanceDelta;
 
 out vec2 TexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform float sphereScale;
+uniform float instanceBlend;    // position at display time is offset + delta * blend
 
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0f);
+    vec3 center = aInstanceOffset + aInstanceDelta * instanceBlend;
+    gl_Position = projection * view * vec4(aPos * sphereScale + center, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "scenario.h"
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace
+{
+    // tank height in world units, same as the wall box of the viewer
+    const float TANK_HEIGHT = 30.f;
+    // keep fluid away from the boundary force layer (2 world units)
+    const float WALL_MARGIN = 2.f;
+    // a settled scene ticks until the rms speed drops below SETTLE_SPEED, at most SETTLE_TIME simulated seconds
+    const float SETTLE_SPEED = 0.005f;
+    const float SETTLE_TIME = 3.f;
+    const unsigned int SETTLE_CHECK_INTERVAL = 50;
+
+    // fluid boxes in fractions of the tank interior
+    struct FluidBoxFraction
+    {
+        glm::vec3 min, max;
+    };
+
+    struct ScenarioDesc
+    {
+        const char* name;
+        int boxCounts;
+        FluidBoxFraction boxes[2];
+        bool settled;       // run to rest before use
+    };
+
+    const ScenarioDesc s_scenarios[SCENARIO_COUNTS] =
+    {
+        { "dam_break",        1, { { { 0.f, 0.f, 0.f }, { 0.4f, 0.8f, 1.f } } }, false },
+        { "double_dam_break", 2, { { { 0.f, 0.f, 0.f }, { 0.3f, 0.7f, 1.f } },
+                                   { { 0.7f, 0.f, 0.f }, { 1.f, 0.7f, 1.f } } }, false },
+        { "drop_into_pool",   2, { { { 0.f, 0.f, 0.f }, { 1.f, 0.25f, 1.f } },
+                                   { { 0.35f, 0.55f, 0.35f }, { 0.65f, 0.85f, 0.65f } } }, false },
+        { "settled_tank",     1, { { { 0.f, 0.f, 0.f }, { 1.f, 0.4f, 1.f } } }, true },
+    };
+
+    // particles of a scene after settling, shared by every later setup of the same scene and parameters
+    struct SettledScene
+    {
+        ScenarioType type;
+        unsigned int targetPointCounts;
+        CheckpointParameters parameters;
+        std::vector<Particle> particles;
+        std::vector<uint32_t> ids;
+    };
+
+    std::mutex s_settledMutex;
+    std::vector<SettledScene> s_settledScenes;
+
+    float rmsSpeed(const SPHSystem& sphSystem)
+    {
+        const Particle* particles = sphSystem.getParticles();
+        double sum = 0.0;
+        for (unsigned int i = 0; i < sphSystem.getPointCounts(); i++)
+        {
+            sum += glm::dot(particles[i].velocity, particles[i].velocity);
+        }
+        return sphSystem.getPointCounts() > 0 ? (float)std::sqrt(sum / sphSystem.getPointCounts()) : 0.f;
+    }
+
+    void settleScene(SPHSystem* sphSystem, ScenarioType type, unsigned int targetPointCounts)
+    {
+        CheckpointState state;
+        sphSystem->getCheckpointState(state);
+
+        SettledScene scene;
+        bool cached = false;
+        {
+            std::lock_guard<std::mutex> lock(s_settledMutex);
+            for (const SettledScene& settled : s_settledScenes)
+            {
+                if (settled.type == type && settled.targetPointCounts == targetPointCounts
+                    && memcmp(&settled.parameters, &state.parameters, sizeof(state.parameters)) == 0)
+                {
+                    scene = settled;
+                    cached = true;
+                    break;
+                }
+            }
+        }
+
+        if (!cached)
+        {
+            //tick a copy, so the stats and tick counts of the system start from the settled state
+            SPHSystem settler;
+            settler.setStatsEnabled(false);
+            settler.setThreadCounts(sphSystem->getThreadCounts());
+            settler.setCheckpointState(state);
+
+            unsigned int maxTicks = (unsigned int)(SETTLE_TIME / settler.getDeltaTime());
+            for (unsigned int i = 1; i <= maxTicks; i++)
+            {
+                settler.tick();
+                if (i % SETTLE_CHECK_INTERVAL == 0 && rmsSpeed(settler) < SETTLE_SPEED) break;
+            }
+
+            CheckpointState settledState;
+            settler.getCheckpointState(settledState);
+            scene.type = type;
+            scene.targetPointCounts = targetPointCounts;
+            scene.parameters = state.parameters;
+            scene.particles.assign(settledState.particles, settledState.particles + settledState.pointCounts);
+            scene.ids.assign(settledState.ids, settledState.ids + settledState.pointCounts);
+            for (Particle& particle : scene.particles)
+            {
+                particle.velocity = glm::vec3(0.f);
+                particle.acceleration = glm::vec3(0.f);
+            }
+
+            std::lock_guard<std::mutex> lock(s_settledMutex);
+            s_settledScenes.push_back(scene);
+        }
+
+        sphSystem->setParticles(scene.particles.data(), scene.ids.data(), (unsigned int)scene.particles.size());
+    }
+}
+
+const char* getScenarioName(ScenarioType type)
+{
+    return s_scenarios[type].name;
+}
+
+bool setupScenario(SPHSystem* sphSystem, ScenarioType type, unsigned int targetPointCounts)
+{
+    const ScenarioDesc& desc = s_scenarios[type];
+    float spacing = sphSystem->getPointDistance();
+
+    // fluid volume fraction of the tank interior
+    float fraction = 0.f;
+    for (int i = 0; i < desc.boxCounts; i++)
+    {
+        glm::vec3 size = desc.boxes[i].max - desc.boxes[i].min;
+        fraction += size.x * size.y * size.z;
+    }
+
+    // points = fraction * width^2 * height / spacing^3
+    float innerHeight = TANK_HEIGHT - 2.f * WALL_MARGIN;
+    float innerWidth = std::sqrt(targetPointCounts * spacing * spacing * spacing / (fraction * innerHeight));
+    float halfWidth = innerWidth * 0.5f + WALL_MARGIN;
+
+    ParticleBox3 wallBox(glm::vec3(-halfWidth, 0.f, -halfWidth), glm::vec3(halfWidth, TANK_HEIGHT, halfWidth));
+    glm::vec3 innerMin = wallBox.min + WALL_MARGIN;
+    glm::vec3 innerSize = (wallBox.max - WALL_MARGIN) - innerMin;
+
+    ParticleBox3 fluidBoxes[2];
+    uint64_t pointCounts = 0;
+    for (int i = 0; i < desc.boxCounts; i++)
+    {
+        fluidBoxes[i].min = innerMin + desc.boxes[i].min * innerSize;
+        fluidBoxes[i].max = innerMin + desc.boxes[i].max * innerSize;
+        pointCounts += sphSystem->getFluidBoxPointCounts(fluidBoxes[i].min, fluidBoxes[i].max);
+    }
+    // particle indices are 16 bits wide, a full buffer would overwrite particles instead of adding them
+    if (pointCounts > 0xffff) return false;
+    unsigned int capacity = (unsigned int)std::min<uint64_t>(pointCounts + pointCounts / 16 + 64, 0xffff);
+
+    sphSystem->init((unsigned short)capacity, wallBox.min, wallBox.max,
+                    fluidBoxes[0].min, fluidBoxes[0].max, glm::vec3(0.f, -9.8f, 0.f));
+    for (int i = 1; i < desc.boxCounts; i++)
+    {
+        sphSystem->addFluidBox(fluidBoxes[i].min, fluidBoxes[i].max);
+    }
+
+    if (desc.settled) settleScene(sphSystem, type, targetPointCounts);
+    return true;
+}
@@ -0,0 +1,30 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SCENARIO_H
+#define SIMPLE_FLUID_SIMULATOR_SCENARIO_H
+
+#include "sph_system.h"
+
+enum ScenarioType
+{
+    SCENARIO_DAM_BREAK,
+    SCENARIO_DOUBLE_DAM_BREAK,
+    SCENARIO_DROP_INTO_POOL,
+    SCENARIO_SETTLED_TANK,
+
+    SCENARIO_COUNTS
+};
+
+/** get the name of a scenario, used as key in benchmark results */
+const char* getScenarioName(ScenarioType type);
+
+/** build a reproducible scene in sphSystem.
+ *  the tank keeps its height and is scaled horizontally so that roughly targetPointCounts particles are created,
+ *  which keeps the fluid depth (and so the dynamics) comparable between sizes.
+ *  settled_tank is ticked to rest and starts with zero velocities, the settled particles are cached per size and
+ *  system parameters. returns false and leaves sphSystem untouched if the scene needs more than 65535 particles */
+bool setupScenario(SPHSystem* sphSystem, ScenarioType type, unsigned int targetPointCounts);
+
+#endif //SIMPLE_FLUID_SIMULATOR_SCENARIO_H
@@ -0,0 +1,171 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "shared_frame.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+size_t getSharedFrameSlotBytes(unsigned int capacity)
+{
+    size_t bytes = sizeof(SharedFrameSlot) + 2 * (size_t)capacity * sizeof(glm::vec3);
+    return (bytes + 63) & ~(size_t)63;
+}
+
+size_t getSharedFrameSegmentBytes(unsigned int capacity, unsigned int slotCounts)
+{
+    size_t headerBytes = (sizeof(SharedFrameHeader) + 63) & ~(size_t)63;
+    return headerBytes + slotCounts * getSharedFrameSlotBytes(capacity);
+}
+
+SharedFrameReader::SharedFrameReader()
+        : m_header(nullptr)
+        , m_size(0)
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool SharedFrameReader::open(const char *)
+{
+    // posix shared memory only
+    return false;
+}
+
+void SharedFrameReader::close()
+{
+}
+
+bool SharedFrameReader::isPublisherAlive() const
+{
+    return false;
+}
+
+#else
+
+bool SharedFrameReader::open(const char *name)
+{
+    close();
+
+    int file = shm_open(name, O_RDONLY, 0);
+    if (file < 0) return false;
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(file, &st) == 0 && (size_t)st.st_size >= sizeof(SharedFrameHeader))
+    {
+        data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (data == MAP_FAILED) return false;
+
+    const SharedFrameHeader* header = (const SharedFrameHeader*)data;
+    if (memcmp(header->magic, "SPHSHM", 6) != 0 || header->version != SHARED_FRAME_VERSION || header->slotCounts == 0 ||
+        (size_t)st.st_size < getSharedFrameSegmentBytes(header->capacity, header->slotCounts))
+    {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+
+    m_header = header;
+    m_size = (size_t)st.st_size;
+    return true;
+}
+
+void SharedFrameReader::close()
+{
+    if (m_header) munmap((void*)m_header, m_size);
+    m_header = nullptr;
+    m_size = 0;
+}
+
+bool SharedFrameReader::isPublisherAlive() const
+{
+    if (!m_header) return false;
+    // EPERM still means the process exists
+    return kill(m_header->publisherPid, 0) == 0 || errno == EPERM;
+}
+
+#endif
+
+const SharedFrameSlot *SharedFrameReader::_getSlot(unsigned int slot) const
+{
+    size_t headerBytes = (sizeof(SharedFrameHeader) + 63) & ~(size_t)63;
+    return (const SharedFrameSlot*)((const unsigned char*)m_header + headerBytes + slot * m_header->slotBytes);
+}
+
+uint64_t SharedFrameReader::getLatestFrame() const
+{
+    return m_header ? m_header->latestFrame.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameReader::acquire(SharedFrame &frame) const
+{
+    uint64_t latest = getLatestFrame();
+    if (latest == 0) return false;
+
+    //a frame older than latest may already be written again, then take the newer latest
+    for (;;)
+    {
+        unsigned int slot = (unsigned int)(latest % m_header->slotCounts);
+        const SharedFrameSlot* s = _getSlot(slot);
+        uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) == 0)
+        {
+            frame.frame = s->frame;
+            frame.tick = s->tick;
+            frame.simulatedTime = s->simulatedTime;
+            frame.pointCounts = std::min(s->pointCounts, m_header->capacity);
+            frame.domainMin = glm::vec3(s->domainMin[0], s->domainMin[1], s->domainMin[2]);
+            frame.domainMax = glm::vec3(s->domainMax[0], s->domainMax[1], s->domainMax[2]);
+            frame.positions = (const glm::vec3*)(s + 1);
+            frame.velocities = frame.positions + m_header->capacity;
+            frame.slot = slot;
+            frame.sequence = sequence;
+            return true;
+        }
+        latest = getLatestFrame();
+    }
+}
+
+bool SharedFrameReader::release(const SharedFrame &frame) const
+{
+    //order the reads of the frame before the second read of the sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _getSlot(frame.slot)->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+bool SharedFrameReader::copyLatest(SharedFrame &frame, std::vector<glm::vec3> &positions,
+                                   std::vector<glm::vec3> *velocities) const
+{
+    if (!m_header) return false;
+
+    while (acquire(frame))
+    {
+        positions.assign(frame.positions, frame.positions + frame.pointCounts);
+        if (velocities) velocities->assign(frame.velocities, frame.velocities + frame.pointCounts);
+        if (release(frame))
+        {
+            //the copies are what outlives the frame
+            frame.positions = positions.data();
+            frame.velocities = velocities ? velocities->data() : nullptr;
+            return true;
+        }
+    }
+    return false;
+}
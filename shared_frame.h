@@ -0,0 +1,108 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_H
+#define SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_H
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shared memory layout of the published particle frames, see SharedFramePublisher:
+//
+//   SharedFrameHeader
+//   slot 0: SharedFrameSlot, positions[capacity], velocities[capacity]
+//   slot 1: ...
+//
+// Frame n is written into slot n % slotCounts. Every slot is a seqlock, its sequence is odd while the
+// publisher writes it and advances by 2 with every frame, so a reader which sees the same even sequence
+// before and after reading got a consistent frame. The publisher never waits for readers, a reader which
+// is too slow just sees its frame overwritten and tries again with the latest one.
+
+enum
+{
+    SHARED_FRAME_VERSION = 1,
+};
+
+struct SharedFrameHeader
+{
+    char magic[8];                          // "SPHSHM\0\0"
+    uint32_t version;
+    uint32_t slotCounts;
+    uint32_t capacity;                      // particles per slot
+    int32_t publisherPid;
+    uint64_t slotBytes;                     // distance between two slots
+    std::atomic<uint64_t> latestFrame;      // newest complete frame, 0 before the first one
+};
+
+struct alignas(64) SharedFrameSlot
+{
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    uint64_t tick;
+    double simulatedTime;                   // seconds
+    uint32_t pointCounts;
+    uint32_t reserved;
+    float domainMin[3];                     // wall box, world units
+    float domainMax[3];
+};
+
+/** a frame in the shared segment, valid until SharedFrameReader::release tells otherwise */
+struct SharedFrame
+{
+    uint64_t frame;
+    uint64_t tick;
+    double simulatedTime;
+    unsigned int pointCounts;
+    glm::vec3 domainMin;
+    glm::vec3 domainMax;
+    const glm::vec3* positions;             // world units
+    const glm::vec3* velocities;            // world units per second
+
+    unsigned int slot;
+    uint64_t sequence;
+};
+
+/** maps a segment written by SharedFramePublisher in another process. it never writes to the segment and
+ *  never blocks the publisher, any number of readers can map the same segment */
+class SharedFrameReader
+{
+public:
+    bool open(const char* name);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    /** the newest frame, read in place. false if nothing was published yet */
+    bool acquire(SharedFrame& frame) const;
+    /** true if the frame wasn't overwritten while it was read, otherwise whatever was read is torn */
+    bool release(const SharedFrame& frame) const;
+    /** copy the newest consistent frame, velocities may be null. retries while frames are overwritten */
+    bool copyLatest(SharedFrame& frame, std::vector<glm::vec3>& positions, std::vector<glm::vec3>* velocities) const;
+
+    uint64_t getLatestFrame() const;
+    /** false once the publishing process has exited, a new run creates a new segment */
+    bool isPublisherAlive() const;
+
+private:
+    const SharedFrameSlot* _getSlot(unsigned int slot) const;
+
+private:
+    const SharedFrameHeader* m_header;
+    size_t m_size;
+
+public:
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+};
+
+/** bytes of a segment with the given capacity and slot counts, and of one slot */
+size_t getSharedFrameSlotBytes(unsigned int capacity);
+size_t getSharedFrameSegmentBytes(unsigned int capacity, unsigned int slotCounts);
+
+#endif //SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_H
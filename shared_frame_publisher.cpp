@@ -0,0 +1,162 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "shared_frame_publisher.h"
+#include "sph_system.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SharedFramePublisher::SharedFramePublisher()
+        : m_header(nullptr)
+        , m_size(0)
+        , m_frameCounts(0)
+        , m_publishNanoseconds(0)
+{
+}
+
+SharedFramePublisher::~SharedFramePublisher()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool SharedFramePublisher::open(const char *, unsigned int, unsigned int)
+{
+    // posix shared memory only
+    return false;
+}
+
+void SharedFramePublisher::close()
+{
+}
+
+#else
+
+bool SharedFramePublisher::open(const char *name, unsigned int capacity, unsigned int slotCounts)
+{
+    close();
+    if (capacity == 0 || slotCounts < 2) return false;
+
+    //readers of a previous segment keep it mapped, this run gets a fresh one
+    shm_unlink(name);
+    int file = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (file < 0) return false;
+
+    size_t size = getSharedFrameSegmentBytes(capacity, slotCounts);
+    void* data = MAP_FAILED;
+    if (ftruncate(file, (off_t)size) == 0)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    }
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return false;
+    }
+
+    //the segment starts zeroed, every slot has an even sequence and no frame
+    m_header = new (data) SharedFrameHeader();
+    m_header->version = SHARED_FRAME_VERSION;
+    m_header->slotCounts = slotCounts;
+    m_header->capacity = capacity;
+    m_header->publisherPid = (int32_t)getpid();
+    m_header->slotBytes = getSharedFrameSlotBytes(capacity);
+    m_header->latestFrame.store(0, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < slotCounts; i++)
+    {
+        new (_getSlot(i)) SharedFrameSlot();
+        _getSlot(i)->sequence.store(0, std::memory_order_relaxed);
+    }
+    //readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_header->magic, "SPHSHM\0\0", 8);
+
+    m_name = name;
+    m_size = size;
+    m_frameCounts = 0;
+    m_publishNanoseconds = 0;
+    return true;
+}
+
+void SharedFramePublisher::close()
+{
+    if (!m_header) return;
+
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+SharedFrameSlot *SharedFramePublisher::_getSlot(unsigned int slot)
+{
+    size_t headerBytes = (sizeof(SharedFrameHeader) + 63) & ~(size_t)63;
+    return (SharedFrameSlot*)((unsigned char*)m_header + headerBytes + slot * m_header->slotBytes);
+}
+
+void SharedFramePublisher::publish(const SPHSystem &system)
+{
+    if (!m_header) return;
+
+    TRACE_SCOPE("publish shared frame");
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t frame = m_header->latestFrame.load(std::memory_order_relaxed) + 1;
+    SharedFrameSlot* slot = _getSlot((unsigned int)(frame % m_header->slotCounts));
+
+    //odd while written, the release fence keeps the payload stores behind it
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    unsigned int pointCounts = std::min(system.getPointCounts(), m_header->capacity);
+    const ParticleBox3& wallBox = system.getWallBox();
+    slot->frame = frame;
+    slot->tick = system.getStats().tickCounts;
+    slot->simulatedTime = (double)slot->tick * system.getDeltaTime();
+    slot->pointCounts = pointCounts;
+    for (int i = 0; i < 3; i++)
+    {
+        slot->domainMin[i] = wallBox.min[i];
+        slot->domainMax[i] = wallBox.max[i];
+    }
+
+    glm::vec3* positions = (glm::vec3*)(slot + 1);
+    glm::vec3* velocities = positions + m_header->capacity;
+    const Particle* particles = system.getParticles();
+    float worldScale = 1.f / system.getUnitScale();
+    for (unsigned int i = 0; i < pointCounts; i++)
+    {
+        positions[i] = particles[i].pos;
+        velocities[i] = particles[i].velocity * worldScale;
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    m_header->latestFrame.store(frame, std::memory_order_release);
+
+    m_frameCounts++;
+    m_publishNanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+double SharedFramePublisher::getAveragePublishTime() const
+{
+    uint64_t frameCounts = m_frameCounts.load();
+    return frameCounts > 0 ? m_publishNanoseconds.load() * 1e-3 / frameCounts : 0.0;
+}
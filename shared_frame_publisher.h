@@ -0,0 +1,53 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_PUBLISHER_H
+#define SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_PUBLISHER_H
+
+#include "shared_frame.h"
+
+#include <string>
+
+class SPHSystem;
+
+/** publishes the particles of a system into a POSIX shared memory segment after every tick, so viewers and
+ *  analysis tools in other processes can read live frames, see SharedFrameReader. a reader that crashes
+ *  or stalls never affects the simulation, publish only copies positions and velocities into the next slot */
+class SharedFramePublisher
+{
+public:
+    /** create the segment /name, a segment left over by a crashed run is replaced */
+    bool open(const char* name, unsigned int capacity = 65535, unsigned int slotCounts = 4);
+    /** unmap and remove the segment, readers keep their mapping until they close it */
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+
+    /** call after every tick, particles beyond the capacity are dropped */
+    void publish(const SPHSystem& system);
+
+    uint64_t getFrameCounts() const { return m_frameCounts.load(); }
+    /** microseconds spent in publish, averaged over all frames */
+    double getAveragePublishTime() const;
+    size_t getSegmentBytes() const { return m_size; }
+
+private:
+    SharedFrameSlot* _getSlot(unsigned int slot);
+
+private:
+    std::string m_name;
+    SharedFrameHeader* m_header;
+    size_t m_size;
+
+    std::atomic<uint64_t> m_frameCounts;
+    std::atomic<uint64_t> m_publishNanoseconds;
+
+public:
+    SharedFramePublisher();
+    ~SharedFramePublisher();
+
+    SharedFramePublisher(const SharedFramePublisher&) = delete;
+    SharedFramePublisher& operator=(const SharedFramePublisher&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_SHARED_FRAME_PUBLISHER_H
@@ -0,0 +1,193 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "simulation_thread.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+
+SimulationThread::SimulationThread()
+        : m_system(nullptr)
+        , m_quit(false)
+        , m_paused(false)
+        , m_stepCounts(0)
+        , m_nextTickTime(0.0)
+        , m_tickRate(0.f)
+        , m_requestedPaused(false)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start(SPHSystem *system)
+{
+    stop();
+
+    m_system = system;
+    m_quit = false;
+    m_paused = m_requestedPaused;
+    m_stepCounts = 0;
+
+    //the render thread has something to draw before the first tick
+    _publish();
+    m_snapshots.update();
+
+    m_thread = std::thread(&SimulationThread::_threadLoop, this);
+}
+
+void SimulationThread::stop()
+{
+    if (!m_thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    //commands which didn't run still go to the system, nothing else touches it now
+    for (const Command& command : m_commands) command(m_system);
+    m_commands.clear();
+}
+
+void SimulationThread::post(const Command &command)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.push_back(command);
+    }
+    m_cond.notify_one();
+}
+
+void SimulationThread::execute(const Command &command)
+{
+    if (!isRunning())
+    {
+        command(m_system);
+        return;
+    }
+
+    std::promise<void> done;
+    post([&](SPHSystem* system)
+    {
+        command(system);
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+void SimulationThread::setPaused(bool paused)
+{
+    m_requestedPaused = paused;
+    post([this, paused](SPHSystem*) { m_paused = paused; });
+}
+
+void SimulationThread::step()
+{
+    post([this](SPHSystem*) { m_stepCounts++; });
+}
+
+double SimulationThread::getWallTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const SimulationSnapshot &SimulationThread::acquireSnapshot()
+{
+    m_snapshots.update();
+    return m_snapshots.getReadBuffer();
+}
+
+void SimulationThread::_threadLoop()
+{
+    TraceRecorder::get()->setThreadName("simulation");
+
+    std::deque<Command> commands;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return m_quit || !m_commands.empty() || !m_paused || m_stepCounts > 0; });
+
+            //with a fixed tick rate sleep until the next tick is due, a command wakes the thread up early
+            if (!m_quit && m_commands.empty() && !m_paused && m_tickRate > 0.f)
+            {
+                double wait = m_nextTickTime - getWallTime();
+                if (wait > 0.0)
+                {
+                    m_cond.wait_for(lock, std::chrono::duration<double>(wait),
+                                    [&] { return m_quit || !m_commands.empty(); });
+                }
+            }
+            if (m_quit) return;
+            commands.swap(m_commands);
+        }
+
+        bool changed = !commands.empty();
+        for (const Command& command : commands)
+        {
+            TRACE_SCOPE("simulation command");
+            command(m_system);
+        }
+        commands.clear();
+
+        float tickRate = m_tickRate;
+        double now = getWallTime();
+        bool tickDue = !m_paused && (tickRate <= 0.f || now >= m_nextTickTime);
+        if (tickDue || m_stepCounts > 0)
+        {
+            if (tickDue && tickRate > 0.f)
+            {
+                //a late tick doesn't make the following ones run back to back
+                m_nextTickTime = std::max(m_nextTickTime, now - 1.0 / tickRate) + 1.0 / tickRate;
+            }
+            else if (m_stepCounts > 0) m_stepCounts--;
+
+            m_system->tick();
+            if (m_tickCallback) m_tickCallback(m_system);
+            changed = true;
+        }
+
+        if (changed) _publish();
+    }
+}
+
+void SimulationThread::_publish()
+{
+    TRACE_SCOPE("publish snapshot");
+
+    SimulationSnapshot& snapshot = m_snapshots.getWriteBuffer();
+    snapshot.tickCounts = m_system->getStats().tickCounts;
+    snapshot.simulatedTime = (double)snapshot.tickCounts * m_system->getDeltaTime();
+    snapshot.publishTime = getWallTime();
+    snapshot.statsEnabled = m_system->isStatsEnabled();
+    snapshot.stats = m_system->getStats();
+    snapshot.diagnostics = m_system->getDiagnostics();
+
+    const ParticleGridContainer& grid = m_system->getGridContainer();
+    snapshot.grid.min = *grid.getGridMin();
+    snapshot.grid.res = glm::max(*grid.getGridRes(), glm::ivec3(1));
+    snapshot.grid.cellSize = *grid.getGridSize() / glm::vec3(snapshot.grid.res);
+
+    unsigned int pointCounts = m_system->getPointCounts();
+    const Particle* particles = m_system->getParticles();
+    float worldScale = 1.f / m_system->getUnitScale();
+    snapshot.positions.resize(pointCounts);
+    snapshot.velocities.resize(pointCounts);
+    for (unsigned int i = 0; i < pointCounts; i++)
+    {
+        snapshot.positions[i] = particles[i].pos;
+        snapshot.velocities[i] = particles[i].velocity * worldScale;
+    }
+    const unsigned char* surfaceFlags = m_system->getSurfaceFlags();
+    snapshot.surfaceFlags.assign(surfaceFlags, surfaceFlags + pointCounts);
+
+    m_snapshots.publish();
+}
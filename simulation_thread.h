@@ -0,0 +1,100 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SIMULATION_THREAD_H
+#define SIMPLE_FLUID_SIMULATOR_SIMULATION_THREAD_H
+
+#include "sph_system.h"
+#include "particle_culler.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** state of the system after a tick, as seen by the render thread */
+struct SimulationSnapshot
+{
+    uint64_t tickCounts;
+    double simulatedTime;               // seconds since the last reset or load
+    double publishTime;                 // SimulationThread::getWallTime() when the tick finished
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;  // world units per second
+    std::vector<unsigned char> surfaceFlags;    // see SPHSystem::getSurfaceFlags
+    CullGrid grid;                      // cells of the neighbor search grid
+    bool statsEnabled;
+    SPHStats stats;
+    SPHDiagnostics diagnostics;
+};
+
+/** runs a system on its own thread. after every tick the positions are published through a triple buffer,
+ *  so the render thread never waits for a tick and a slow frame never holds the simulation back.
+ *  everything else which touches the system is posted as a command and runs between two ticks */
+class SimulationThread
+{
+public:
+    typedef std::function<void(SPHSystem* system)> Command;
+
+    /** callback runs on the simulation thread after every tick, set it before start */
+    void setTickCallback(const Command& callback) { m_tickCallback = callback; }
+
+    void start(SPHSystem* system);
+    void stop();
+    bool isRunning() const { return m_thread.joinable(); }
+
+    /** run a command on the simulation thread before the next tick */
+    void post(const Command& command);
+    /** run a command on the simulation thread and wait for it */
+    void execute(const Command& command);
+    void setPaused(bool paused);
+    bool isPaused() const { return m_requestedPaused; }
+    /** run a single tick while paused */
+    void step();
+
+    /** the latest published snapshot, never waits */
+    const SimulationSnapshot& acquireSnapshot();
+
+    /** limit the ticks per second, 0 runs as fast as possible */
+    void setTickRate(float ticksPerSecond) { m_tickRate = ticksPerSecond; }
+    float getTickRate() const { return m_tickRate; }
+
+    /** seconds on the clock used for SimulationSnapshot::publishTime */
+    static double getWallTime();
+
+private:
+    void _threadLoop();
+    void _publish();
+
+private:
+    SPHSystem* m_system;
+    Command m_tickCallback;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Command> m_commands;
+    std::thread m_thread;
+    bool m_quit;
+
+    ////// simulation thread only
+    bool m_paused;
+    unsigned int m_stepCounts;
+    double m_nextTickTime;
+
+    std::atomic<float> m_tickRate;
+    bool m_requestedPaused;             // render thread only
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+
+public:
+    SimulationThread();
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_SIMULATION_THREAD_H
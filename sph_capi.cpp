@@ -0,0 +1,295 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "sph_capi.h"
+#include "sph_system.h"
+#include "field_probe.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+
+struct sph_system_t
+{
+    SPHSystem system;
+    std::atomic<int> references;        // the handle and every exported tensor
+    uint64_t generation;
+
+    const void* particles;              // buffers the views of this generation point into
+    const void* ids;
+    unsigned int pointCounts;
+
+    FieldProbe* probe;                  // created by the first sph_sample
+};
+
+namespace
+{
+    struct FieldLayout
+    {
+        size_t offset;                  // in Particle
+        int components;
+    };
+
+    static_assert((int)SPH_PROBE_DENSITY == (int)PROBE_DENSITY && (int)SPH_PROBE_PRESSURE == (int)PROBE_PRESSURE &&
+                  (int)SPH_PROBE_VELOCITY == (int)PROBE_VELOCITY, "probe fields are passed through");
+
+    const FieldLayout s_fieldLayouts[SPH_FIELD_ID] =
+    {
+        { offsetof(Particle, pos), 3 },
+        { offsetof(Particle, velocity), 3 },
+        { offsetof(Particle, density), 1 },
+        { offsetof(Particle, pressure), 1 },
+        { offsetof(Particle, acceleration), 3 },
+    };
+
+    struct ExportedTensor
+    {
+        DLManagedTensor tensor;
+        int64_t shape[2];
+        int64_t strides[2];
+        sph_system owner;
+    };
+
+    void release(sph_system system)
+    {
+        if (--system->references == 0)
+        {
+            delete system->probe;
+            delete system;
+        }
+    }
+
+    // a new generation whenever the particle count or a buffer changed
+    void updateGeneration(sph_system system)
+    {
+        const void* particles = system->system.getParticles();
+        const void* ids = system->system.getPointIds();
+        unsigned int pointCounts = system->system.getPointCounts();
+        if (particles != system->particles || ids != system->ids || pointCounts != system->pointCounts)
+        {
+            system->particles = particles;
+            system->ids = ids;
+            system->pointCounts = pointCounts;
+            system->generation++;
+        }
+    }
+
+    void deleteTensor(DLManagedTensor* tensor)
+    {
+        ExportedTensor* exported = (ExportedTensor*)tensor->manager_ctx;
+        release(exported->owner);
+        delete exported;
+    }
+}
+
+uint32_t sph_get_api_version(void)
+{
+    return SPH_API_VERSION;
+}
+
+sph_system sph_create(uint32_t thread_counts)
+{
+    sph_system system = new (std::nothrow) sph_system_t();
+    if (!system) return nullptr;
+
+    if (thread_counts == 0) thread_counts = std::thread::hardware_concurrency();
+    system->system.setThreadCounts(thread_counts > 0 ? thread_counts : 1);
+    system->references = 1;
+    system->generation = 0;
+    system->particles = nullptr;
+    system->ids = nullptr;
+    system->pointCounts = 0;
+    system->probe = nullptr;
+    return system;
+}
+
+void sph_destroy(sph_system system)
+{
+    if (system) release(system);
+}
+
+sph_result sph_init_box(sph_system system, uint32_t max_point_counts, const float *wall_min, const float *wall_max,
+                        const float *fluid_min, const float *fluid_max, const float *gravity)
+{
+    if (!system || !wall_min || !wall_max || !fluid_min || !fluid_max || !gravity) return SPH_ERROR_INVALID_ARGUMENT;
+    // particle indices are 16 bits wide
+    if (max_point_counts == 0 || max_point_counts > 65535) return SPH_ERROR_INVALID_ARGUMENT;
+
+    system->system.init((unsigned short)max_point_counts,
+                        glm::vec3(wall_min[0], wall_min[1], wall_min[2]), glm::vec3(wall_max[0], wall_max[1], wall_max[2]),
+                        glm::vec3(fluid_min[0], fluid_min[1], fluid_min[2]), glm::vec3(fluid_max[0], fluid_max[1], fluid_max[2]),
+                        glm::vec3(gravity[0], gravity[1], gravity[2]));
+    // a new buffer may land where the old one was
+    system->generation++;
+    updateGeneration(system);
+    return SPH_OK;
+}
+
+sph_result sph_add_fluid_box(sph_system system, const float *fluid_min, const float *fluid_max)
+{
+    if (!system || !fluid_min || !fluid_max) return SPH_ERROR_INVALID_ARGUMENT;
+
+    system->system.addFluidBox(glm::vec3(fluid_min[0], fluid_min[1], fluid_min[2]),
+                               glm::vec3(fluid_max[0], fluid_max[1], fluid_max[2]));
+    updateGeneration(system);
+    return SPH_OK;
+}
+
+sph_result sph_load_checkpoint(sph_system system, const char *path)
+{
+    if (!system || !path) return SPH_ERROR_INVALID_ARGUMENT;
+    if (!system->system.loadCheckpoint(path)) return SPH_ERROR_IO;
+
+    system->generation++;
+    updateGeneration(system);
+    return SPH_OK;
+}
+
+sph_result sph_save_checkpoint(sph_system system, const char *path)
+{
+    if (!system || !path) return SPH_ERROR_INVALID_ARGUMENT;
+    return system->system.saveCheckpoint(path) ? SPH_OK : SPH_ERROR_IO;
+}
+
+void sph_set_viscosity(sph_system system, float viscosity)
+{
+    if (system) system->system.setViscosity(viscosity);
+}
+
+void sph_set_gas_constant(sph_system system, float gas_constant)
+{
+    if (system) system->system.setGasConstant(gas_constant);
+}
+
+void sph_tick(sph_system system, uint32_t ticks)
+{
+    if (!system) return;
+
+    for (uint32_t i = 0; i < ticks; i++)
+    {
+        system->system.tick();
+    }
+    updateGeneration(system);
+}
+
+uint32_t sph_get_point_counts(sph_system system)
+{
+    return system ? system->system.getPointCounts() : 0;
+}
+
+uint64_t sph_get_tick_counts(sph_system system)
+{
+    return system ? system->system.getStats().tickCounts : 0;
+}
+
+float sph_get_delta_time(sph_system system)
+{
+    return system ? system->system.getDeltaTime() : 0.f;
+}
+
+float sph_get_unit_scale(sph_system system)
+{
+    return system ? system->system.getUnitScale() : 0.f;
+}
+
+uint64_t sph_get_generation(sph_system system)
+{
+    return system ? system->generation : 0;
+}
+
+sph_result sph_get_view(sph_system system, sph_field field, sph_view *view)
+{
+    if (!system || !view || field < 0 || field >= SPH_FIELD_COUNTS) return SPH_ERROR_INVALID_ARGUMENT;
+
+    int64_t pointCounts = system->system.getPointCounts();
+    if (field == SPH_FIELD_ID)
+    {
+        view->data = (void*)system->system.getPointIds();
+        view->itemsize = sizeof(uint32_t);
+        view->format = "I";
+        view->dtype = SPH_DTYPE_UINT32;
+        view->ndim = 1;
+        view->readonly = 1;
+        view->shape[0] = pointCounts;
+        view->shape[1] = 1;
+        view->strides[0] = sizeof(uint32_t);
+        view->strides[1] = 0;
+        view->size_bytes = pointCounts * (int64_t)sizeof(uint32_t);
+        return SPH_OK;
+    }
+
+    // an array of structs, every field is a strided column of the particle buffer
+    const FieldLayout& layout = s_fieldLayouts[field];
+    view->data = (char*)system->system.getParticles() + layout.offset;
+    view->itemsize = sizeof(float);
+    view->format = "f";
+    view->dtype = SPH_DTYPE_FLOAT32;
+    view->ndim = layout.components > 1 ? 2 : 1;
+    view->readonly = 0;
+    view->shape[0] = pointCounts;
+    view->shape[1] = layout.components;
+    view->strides[0] = sizeof(Particle);
+    view->strides[1] = layout.components > 1 ? sizeof(float) : 0;
+    view->size_bytes = pointCounts > 0 ? (pointCounts - 1) * (int64_t)sizeof(Particle) + layout.components * (int64_t)sizeof(float) : 0;
+    return SPH_OK;
+}
+
+sph_result sph_export_dlpack(sph_system system, sph_field field, DLManagedTensor **tensor)
+{
+    if (!tensor) return SPH_ERROR_INVALID_ARGUMENT;
+
+    sph_view view;
+    sph_result result = sph_get_view(system, field, &view);
+    if (result != SPH_OK) return result;
+
+    ExportedTensor* exported = new (std::nothrow) ExportedTensor();
+    if (!exported) return SPH_ERROR_OUT_OF_MEMORY;
+
+    // dlpack strides count elements, every field is 4 byte aligned inside Particle
+    for (int i = 0; i < 2; i++)
+    {
+        exported->shape[i] = view.shape[i];
+        exported->strides[i] = view.strides[i] / view.itemsize;
+    }
+    exported->owner = system;
+    system->references++;
+
+    DLTensor& dlTensor = exported->tensor.dl_tensor;
+    dlTensor.data = view.data;
+    dlTensor.device.device_type = kDLCPU;
+    dlTensor.device.device_id = 0;
+    dlTensor.ndim = view.ndim;
+    dlTensor.dtype.code = view.dtype == SPH_DTYPE_FLOAT32 ? kDLFloat : kDLUInt;
+    dlTensor.dtype.bits = 32;
+    dlTensor.dtype.lanes = 1;
+    dlTensor.shape = exported->shape;
+    dlTensor.strides = exported->strides;
+    dlTensor.byte_offset = 0;
+    exported->tensor.manager_ctx = exported;
+    exported->tensor.deleter = deleteTensor;
+
+    *tensor = &exported->tensor;
+    return SPH_OK;
+}
+
+sph_result sph_sample(sph_system system, const float *points, uint32_t counts, uint32_t fields, float *out)
+{
+    if (!system || (counts > 0 && (!points || !out))) return SPH_ERROR_INVALID_ARGUMENT;
+    if (fields == 0 || (fields & ~(uint32_t)(SPH_PROBE_DENSITY | SPH_PROBE_PRESSURE | SPH_PROBE_VELOCITY))) return SPH_ERROR_INVALID_ARGUMENT;
+
+    if (!system->probe)
+    {
+        system->probe = new (std::nothrow) FieldProbe(system->system.getThreadCounts());
+        if (!system->probe) return SPH_ERROR_OUT_OF_MEMORY;
+    }
+    // float[3] packs like glm::vec3
+    system->probe->sample(system->system, (const glm::vec3*)points, counts, fields, out);
+    return SPH_OK;
+}
+
+float sph_get_sample_time_per_probe(sph_system system)
+{
+    return system && system->probe ? system->probe->getStats().timePerProbe : 0.f;
+}
@@ -0,0 +1,159 @@
+/*
+ * Created by Leo on 2026/10/19.
+ *
+ * Stable C interface of the solver, built as the sph_solver shared library.
+ *
+ * Particle data is exposed in place: a view describes where a field lives inside the particle buffer, with
+ * strides in bytes as in the Python buffer protocol, and sph_export_dlpack wraps the same memory in a DLPack
+ * tensor. Nothing is copied, a view shows the values of the last tick and may be written between two ticks.
+ * Views and tensors stay valid until the number of particles changes or the system is initialized or loaded
+ * again, sph_get_generation tells when they have to be fetched again.
+ *
+ * From Python, a view maps onto numpy with ctypes:
+ *
+ *   v = sph_view(); lib.sph_get_view(handle, SPH_FIELD_VELOCITY, byref(v))
+ *   a = numpy.ndarray(v.shape[:v.ndim], numpy.float32,
+ *                     (ctypes.c_char * v.size_bytes).from_address(v.data), 0, v.strides[:v.ndim])
+ *
+ * and a DLPack tensor onto torch by putting the DLManagedTensor pointer in a "dltensor" capsule.
+ */
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SPH_CAPI_H
+#define SIMPLE_FLUID_SIMULATOR_SPH_CAPI_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(SPH_BUILDING_LIBRARY)
+#    define SPH_API __declspec(dllexport)
+#  else
+#    define SPH_API __declspec(dllimport)
+#  endif
+#else
+#  define SPH_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped when a function or a struct changes incompatibly */
+#define SPH_API_VERSION 1
+
+/* DLPack ABI, unless dlpack.h was included first */
+#ifndef DLPACK_VERSION
+typedef enum { kDLCPU = 1 } DLDeviceType;
+typedef enum { kDLInt = 0, kDLUInt = 1, kDLFloat = 2 } DLDataTypeCode;
+typedef struct { int32_t device_type; int32_t device_id; } DLDevice;
+typedef struct { uint8_t code; uint8_t bits; uint16_t lanes; } DLDataType;
+typedef struct
+{
+    void* data;
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t* shape;
+    int64_t* strides;           /* in elements */
+    uint64_t byte_offset;
+} DLTensor;
+typedef struct DLManagedTensor
+{
+    DLTensor dl_tensor;
+    void* manager_ctx;
+    void (*deleter)(struct DLManagedTensor* self);
+} DLManagedTensor;
+#endif
+
+typedef struct sph_system_t* sph_system;
+
+typedef enum
+{
+    SPH_OK = 0,
+    SPH_ERROR_INVALID_ARGUMENT = -1,
+    SPH_ERROR_IO = -2,
+    SPH_ERROR_OUT_OF_MEMORY = -3,
+} sph_result;
+
+typedef enum
+{
+    SPH_FIELD_POSITION,         /* float32 [n, 3], world units */
+    SPH_FIELD_VELOCITY,         /* float32 [n, 3], metres per second */
+    SPH_FIELD_DENSITY,          /* float32 [n], kg per m^3 */
+    SPH_FIELD_PRESSURE,         /* float32 [n] */
+    SPH_FIELD_ACCELERATION,     /* float32 [n, 3], metres per second^2, of the last tick */
+    SPH_FIELD_ID,               /* uint32 [n], read only, stable while particles are added */
+
+    SPH_FIELD_COUNTS
+} sph_field;
+
+typedef enum
+{
+    SPH_DTYPE_FLOAT32,
+    SPH_DTYPE_UINT32,
+} sph_dtype;
+
+/* fields of sph_sample, or them together */
+typedef enum
+{
+    SPH_PROBE_DENSITY = 1,      /* 1 float */
+    SPH_PROBE_PRESSURE = 2,     /* 1 float */
+    SPH_PROBE_VELOCITY = 4,     /* 3 floats, metres per second */
+} sph_probe_field;
+
+/* the fields of a Py_buffer, strides are in bytes */
+typedef struct
+{
+    void* data;
+    int64_t size_bytes;         /* from data to the end of the last element */
+    int64_t itemsize;
+    const char* format;         /* struct module format, "f" or "I" */
+    int32_t ndim;
+    int32_t readonly;
+    int64_t shape[2];
+    int64_t strides[2];
+    sph_dtype dtype;
+} sph_view;
+
+SPH_API uint32_t sph_get_api_version(void);
+
+/* threads used by every tick, 0 for one per core */
+SPH_API sph_system sph_create(uint32_t thread_counts);
+/* exported tensors keep the memory alive, it is released with the last one */
+SPH_API void sph_destroy(sph_system system);
+
+/* fill fluid_min..fluid_max inside the walls, boxes are float[3] in world units, gravity in m/s^2 */
+SPH_API sph_result sph_init_box(sph_system system, uint32_t max_point_counts,
+                                const float* wall_min, const float* wall_max,
+                                const float* fluid_min, const float* fluid_max, const float* gravity);
+SPH_API sph_result sph_add_fluid_box(sph_system system, const float* fluid_min, const float* fluid_max);
+SPH_API sph_result sph_load_checkpoint(sph_system system, const char* path);
+SPH_API sph_result sph_save_checkpoint(sph_system system, const char* path);
+
+SPH_API void sph_set_viscosity(sph_system system, float viscosity);
+SPH_API void sph_set_gas_constant(sph_system system, float gas_constant);
+
+SPH_API void sph_tick(sph_system system, uint32_t ticks);
+
+SPH_API uint32_t sph_get_point_counts(sph_system system);
+SPH_API uint64_t sph_get_tick_counts(sph_system system);
+SPH_API float sph_get_delta_time(sph_system system);
+/* metres per world unit */
+SPH_API float sph_get_unit_scale(sph_system system);
+/* changes whenever views and tensors taken before are no longer valid */
+SPH_API uint64_t sph_get_generation(sph_system system);
+
+SPH_API sph_result sph_get_view(sph_system system, sph_field field, sph_view* view);
+/* a tensor over the same memory as sph_get_view, the consumer calls its deleter */
+SPH_API sph_result sph_export_dlpack(sph_system system, sph_field field, DLManagedTensor** tensor);
+
+/* interpolate fields at counts points, float[3] each in world units, from the particles of the last tick.
+ * out gets the components of the selected fields in the order density, pressure, velocity for every point */
+SPH_API sph_result sph_sample(sph_system system, const float* points, uint32_t counts, uint32_t fields, float* out);
+/* microseconds per point of the last sph_sample, sorting included */
+SPH_API float sph_get_sample_time_per_probe(sph_system system);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMPLE_FLUID_SIMULATOR_SPH_CAPI_H */
@@ -0,0 +1,220 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "sph_ensemble.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace
+{
+    bool findScenario(const std::string& name, ScenarioType& type)
+    {
+        for (int i = 0; i < SCENARIO_COUNTS; i++)
+        {
+            if (name == getScenarioName((ScenarioType)i))
+            {
+                type = (ScenarioType)i;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+EnsembleMember::EnsembleMember()
+        : scenario(SCENARIO_DAM_BREAK)
+        , targetPointCounts(1000)
+        , hasFluidBox(false)
+        , wallBox(glm::vec3(0.f), glm::vec3(0.f))
+        , fluidBox(glm::vec3(0.f), glm::vec3(0.f))
+        , viscosity(1.f)
+        , gasConstantK(1.f)
+        , simTime(0.3f)
+{
+}
+
+EnsembleRunner::EnsembleRunner(unsigned int threadCounts)
+        : m_taskPool(threadCounts)
+        , m_nextMember(0)
+        , m_wallTime(0.0)
+{
+}
+
+void EnsembleRunner::addSweep(const std::vector<ScenarioType> &scenarios, const std::vector<unsigned int> &sizes,
+                              const std::vector<float> &viscosities, const std::vector<float> &gasConstants, float simTime)
+{
+    EnsembleMember member;
+    member.simTime = simTime;
+    for (ScenarioType scenario : scenarios)
+    {
+        for (unsigned int size : sizes)
+        {
+            for (float viscosity : viscosities)
+            {
+                for (float gasConstantK : gasConstants)
+                {
+                    member.scenario = scenario;
+                    member.targetPointCounts = size;
+                    member.viscosity = viscosity;
+                    member.gasConstantK = gasConstantK;
+                    add(member);
+                }
+            }
+        }
+    }
+}
+
+bool EnsembleRunner::loadSweep(const char *path, float simTime)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) fields.push_back(field);
+
+        EnsembleMember member;
+        member.simTime = simTime;
+        if (fields.size() == 15 && fields[0] == "box")
+        {
+            member.hasFluidBox = true;
+            member.targetPointCounts = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                member.wallBox.min[i] = (float)std::atof(fields[1 + i].c_str());
+                member.wallBox.max[i] = (float)std::atof(fields[4 + i].c_str());
+                member.fluidBox.min[i] = (float)std::atof(fields[7 + i].c_str());
+                member.fluidBox.max[i] = (float)std::atof(fields[10 + i].c_str());
+            }
+            member.viscosity = (float)std::atof(fields[13].c_str());
+            member.gasConstantK = (float)std::atof(fields[14].c_str());
+        }
+        else if (fields.size() == 4 && findScenario(fields[0], member.scenario))
+        {
+            member.targetPointCounts = (unsigned int)std::atoi(fields[1].c_str());
+            member.viscosity = (float)std::atof(fields[2].c_str());
+            member.gasConstantK = (float)std::atof(fields[3].c_str());
+        }
+        else return false;
+
+        add(member);
+    }
+    return true;
+}
+
+void EnsembleRunner::clear()
+{
+    m_members.clear();
+    m_results.clear();
+}
+
+void EnsembleRunner::run()
+{
+    TRACE_SCOPE("ensemble");
+
+    m_results.assign(m_members.size(), EnsembleResult());
+    m_nextMember = 0;
+
+    //one chunk per worker, each worker keeps taking members until none is left so that small and large
+    //members balance out
+    auto start = std::chrono::steady_clock::now();
+    m_taskPool.parallelFor(m_taskPool.getThreadCounts(), [this](unsigned int, unsigned int, unsigned int worker)
+    {
+        for (;;)
+        {
+            unsigned int index = m_nextMember++;
+            if (index >= m_members.size()) break;
+            _runMember(index, worker);
+        }
+    });
+    m_wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void EnsembleRunner::_runMember(unsigned int index, unsigned int worker)
+{
+    TRACE_SCOPE("ensemble member");
+
+    const EnsembleMember& member = m_members[index];
+    auto start = std::chrono::steady_clock::now();
+
+    //allocated on this worker and freed before it takes the next member
+    std::unique_ptr<SPHSystem> system(new SPHSystem());
+    system->setStatsEnabled(false);
+    system->setViscosity(member.viscosity);
+    system->setGasConstant(member.gasConstantK);
+    EnsembleResult& result = m_results[index];
+    result.worker = worker;
+    if (member.hasFluidBox)
+    {
+        //particle indices are 16 bits wide, a full buffer would overwrite particles instead of adding them
+        uint64_t pointCounts = system->getFluidBoxPointCounts(member.fluidBox.min, member.fluidBox.max);
+        if (pointCounts > 0xffff) return;
+        system->init((unsigned short)std::min<uint64_t>(pointCounts + 64, 0xffff),
+                     member.wallBox.min, member.wallBox.max, member.fluidBox.min, member.fluidBox.max,
+                     glm::vec3(0.f, -9.8f, 0.f));
+    }
+    else if (!setupScenario(system.get(), member.scenario, member.targetPointCounts)) return;
+    result.built = true;
+
+    unsigned int ticks = std::max((unsigned int)(member.simTime / system->getDeltaTime() + 0.5f), 1u);
+    auto tickStart = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ticks; i++)
+    {
+        system->tick();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    result.pointCounts = system->getPointCounts();
+    result.ticks = ticks;
+    result.wallTime = std::chrono::duration<double>(stop - start).count();
+    result.msPerTick = std::chrono::duration<double, std::milli>(stop - tickStart).count() / ticks;
+    result.diagnostics = system->getDiagnostics();
+    result.finite = std::isfinite(result.diagnostics.kineticEnergy) && std::isfinite(result.diagnostics.maxSpeed);
+}
+
+double EnsembleRunner::getThroughput() const
+{
+    double updates = 0.0;
+    for (const EnsembleResult& result : m_results) updates += (double)result.pointCounts * result.ticks;
+    return m_wallTime > 0.0 ? updates / m_wallTime : 0.0;
+}
+
+bool EnsembleRunner::writeSummary(const char *path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    file << "member,scenario,target_points,viscosity,gas_constant,points,ticks,worker,wall_s,ms_per_tick,"
+            "kinetic_energy,max_speed,max_accel,avg_density_error,max_density_error,surface_fraction,finite\n";
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const EnsembleMember& member = m_members[i];
+        const EnsembleResult& result = m_results[i];
+        const SPHDiagnostics& diagnostics = result.diagnostics;
+        file << i << "," << (member.hasFluidBox ? "box" : getScenarioName(member.scenario)) << ","
+             << member.targetPointCounts << "," << member.viscosity << "," << member.gasConstantK << ","
+             << result.pointCounts << "," << result.ticks << "," << result.worker << ","
+             << result.wallTime << "," << result.msPerTick << ","
+             << diagnostics.kineticEnergy << "," << diagnostics.maxSpeed << "," << diagnostics.maxAcceleration << ","
+             << diagnostics.averageDensityError << "," << diagnostics.maxDensityError << ","
+             << (result.pointCounts > 0 ? (float)diagnostics.surfacePointCounts / result.pointCounts : 0.f) << ","
+             << (result.finite ? 1 : 0) << "\n";
+    }
+
+    file.flush();
+    return file.good();
+}
@@ -0,0 +1,88 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SPH_ENSEMBLE_H
+#define SIMPLE_FLUID_SIMULATOR_SPH_ENSEMBLE_H
+
+#include "scenario.h"
+#include "task_pool.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/** one variant of a parameter sweep */
+struct EnsembleMember
+{
+    ScenarioType scenario;
+    unsigned int targetPointCounts;
+    bool hasFluidBox;                   // use wallBox and fluidBox instead of the scenario
+    ParticleBox3 wallBox;
+    ParticleBox3 fluidBox;
+    float viscosity;
+    float gasConstantK;
+    float simTime;                      // simulated seconds
+
+    EnsembleMember();
+};
+
+struct EnsembleResult
+{
+    unsigned int pointCounts;
+    unsigned int ticks;
+    unsigned int worker;                // pool worker which ran the member
+    double wallTime;                    // seconds, setup and ticks
+    double msPerTick;
+    SPHDiagnostics diagnostics;         // of the last tick
+    bool built;                         // false if the scene needs more particles than a system can address, the member did not run
+    bool finite;                        // false if the member blew up or did not run
+};
+
+/** runs many independent systems in one process. every member is a task on a shared pool: a worker takes the
+ *  next member, creates its system, ticks it to the end and destroys it before taking another one. members
+ *  never move between threads, so all of their buffers come from the malloc arena of the worker thread and
+ *  running members don't contend in the allocator. every system ticks single threaded, the parallelism is
+ *  across members */
+class EnsembleRunner
+{
+public:
+    void add(const EnsembleMember& member) { m_members.push_back(member); }
+    /** every combination of the given values */
+    void addSweep(const std::vector<ScenarioType>& scenarios, const std::vector<unsigned int>& sizes,
+                  const std::vector<float>& viscosities, const std::vector<float>& gasConstants, float simTime);
+    /** one member per line, "scenario,target_points,viscosity,gas_constant" or
+     *  "box,wall min xyz,wall max xyz,fluid min xyz,fluid max xyz,viscosity,gas_constant", # starts a comment */
+    bool loadSweep(const char* path, float simTime);
+    void clear();
+
+    /** run all members, blocks until the last one is done */
+    void run();
+
+    /** one csv line per member with its parameters and results */
+    bool writeSummary(const char* path) const;
+
+    unsigned int getMemberCounts() const { return (unsigned int)m_members.size(); }
+    const EnsembleMember& getMember(unsigned int i) const { return m_members[i]; }
+    const EnsembleResult& getResult(unsigned int i) const { return m_results[i]; }
+    unsigned int getThreadCounts() const { return m_taskPool.getThreadCounts(); }
+    /** seconds the last run took */
+    double getWallTime() const { return m_wallTime; }
+    /** particle updates per second over all members of the last run */
+    double getThroughput() const;
+
+private:
+    void _runMember(unsigned int index, unsigned int worker);
+
+private:
+    TaskPool m_taskPool;
+    std::vector<EnsembleMember> m_members;
+    std::vector<EnsembleResult> m_results;
+    std::atomic<unsigned int> m_nextMember;
+    double m_wallTime;
+
+public:
+    explicit EnsembleRunner(unsigned int threadCounts);
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_SPH_ENSEMBLE_H
@@ -0,0 +1,94 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "sph_stats.h"
+
+SPHStatsWriter::SPHStatsWriter()
+        : m_format(FORMAT_CSV)
+        , m_intervalTicks(1)
+        , m_lastTick(0)
+        , m_hasWritten(false)
+{
+}
+
+bool SPHStatsWriter::open(const char *path, Format format, unsigned int intervalTicks)
+{
+    close();
+
+    m_file.open(path, std::ios::out | std::ios::trunc);
+    if (!m_file.is_open()) return false;
+
+    m_format = format;
+    m_intervalTicks = intervalTicks > 0 ? intervalTicks : 1;
+    m_hasWritten = false;
+
+    if (m_format == FORMAT_CSV)
+    {
+        m_file << "tick,grid_ms,density_ms,force_ms,advance_ms,tick_ms,points,avg_neighbors,max_neighbors,"
+                  "truncated_points,total_truncated_points,neighbor_bytes,neighbor_capacity,neighbor_grows,"
+                  "grid_cells,occupied_cells,splits,merges,adapt_ms,neighbor_bytes_per_point,"
+                  "neighbor_encode_ms,neighbor_decode_ms,neighbor_decodes\n";
+    }
+    return true;
+}
+
+void SPHStatsWriter::close()
+{
+    if (m_file.is_open()) m_file.close();
+}
+
+void SPHStatsWriter::update(const SPHStats &stats)
+{
+    if (!m_file.is_open()) return;
+    if (m_hasWritten && stats.tickCounts < m_lastTick + m_intervalTicks) return;
+
+    if (m_format == FORMAT_CSV) _writeCSV(stats);
+    else _writeJSON(stats);
+
+    m_file.flush();
+    m_lastTick = stats.tickCounts;
+    m_hasWritten = true;
+}
+
+void SPHStatsWriter::_writeCSV(const SPHStats &stats)
+{
+    m_file << stats.tickCounts << ","
+           << stats.gridTime << "," << stats.densityTime << "," << stats.forceTime << ","
+           << stats.advanceTime << "," << stats.tickTime << ","
+           << stats.pointCounts << "," << stats.averageNeighborCounts << "," << stats.maxNeighborCounts << ","
+           << stats.truncatedPointCounts << "," << stats.totalTruncatedPointCounts << ","
+           << stats.neighborTableBytes << "," << stats.neighborTableCapacity << "," << stats.neighborTableGrowCounts << ","
+           << stats.gridCellCounts << "," << stats.occupiedCellCounts << ","
+           << stats.splitCounts << "," << stats.mergeCounts << "," << stats.adaptTime << ","
+           << stats.neighborBytesPerPoint << ","
+           << stats.neighborEncodeTime << "," << stats.neighborDecodeTime << "," << stats.neighborDecodeCounts << "\n";
+}
+
+void SPHStatsWriter::_writeJSON(const SPHStats &stats)
+{
+    m_file << "{\"tick\":" << stats.tickCounts
+           << ",\"grid_ms\":" << stats.gridTime
+           << ",\"density_ms\":" << stats.densityTime
+           << ",\"force_ms\":" << stats.forceTime
+           << ",\"advance_ms\":" << stats.advanceTime
+           << ",\"tick_ms\":" << stats.tickTime
+           << ",\"points\":" << stats.pointCounts
+           << ",\"avg_neighbors\":" << stats.averageNeighborCounts
+           << ",\"max_neighbors\":" << stats.maxNeighborCounts
+           << ",\"truncated_points\":" << stats.truncatedPointCounts
+           << ",\"total_truncated_points\":" << stats.totalTruncatedPointCounts
+           << ",\"neighbor_bytes\":" << stats.neighborTableBytes
+           << ",\"neighbor_capacity\":" << stats.neighborTableCapacity
+           << ",\"neighbor_grows\":" << stats.neighborTableGrowCounts
+           << ",\"grid_cells\":" << stats.gridCellCounts
+           << ",\"occupied_cells\":" << stats.occupiedCellCounts
+           << ",\"splits\":" << stats.splitCounts
+           << ",\"merges\":" << stats.mergeCounts
+           << ",\"adapt_ms\":" << stats.adaptTime
+           << ",\"neighbor_bytes_per_point\":" << stats.neighborBytesPerPoint
+           << ",\"neighbor_encode_ms\":" << stats.neighborEncodeTime
+           << ",\"neighbor_decode_ms\":" << stats.neighborDecodeTime
+           << ",\"neighbor_decodes\":" << stats.neighborDecodeCounts
+           << "}\n";
+}
@@ -0,0 +1,86 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SPH_STATS_H
+#define SIMPLE_FLUID_SIMULATOR_SPH_STATS_H
+
+#include <fstream>
+
+struct SPHStats
+{
+    unsigned long long tickCounts;          // ticks since init
+
+    // time of each phase of the last tick, in milliseconds
+    float gridTime;
+    float densityTime;
+    float forceTime;
+    float advanceTime;
+    float tickTime;
+
+    // neighbor search of the last tick
+    unsigned int pointCounts;
+    float averageNeighborCounts;
+    int maxNeighborCounts;
+    unsigned int truncatedPointCounts;      // points which hit the neighbor limit and lost neighbors
+    unsigned long long totalTruncatedPointCounts;   // since init
+
+    // neighbor tables, summed over all workers
+    unsigned int neighborTableBytes;        // in use
+    unsigned int neighborTableCapacity;     // allocated
+    unsigned int neighborTableGrowCounts;   // data buf reallocations since the tables were created
+    float neighborBytesPerPoint;            // in use, indices are delta coded, see NeighborTable
+    float neighborEncodeTime;               // ms of sorting and delta coding, summed over workers, sampled
+    float neighborDecodeTime;               // ms of decoding in the force pass, summed over workers, sampled
+    unsigned int neighborDecodeCounts;      // neighbor lists decoded by the force pass
+
+    // grid occupancy of the last tick
+    unsigned int gridCellCounts;
+    unsigned int occupiedCellCounts;
+
+    // adaptive resolution, particles split and merged by the last tick
+    unsigned int splitCounts;
+    unsigned int mergeCounts;
+    float adaptTime;                        // ms
+};
+
+/** physical diagnostics of the last tick, reduced inside the density and advance passes */
+struct SPHDiagnostics
+{
+    float kineticEnergy;            // sum of 1/2 m v^2, in joules
+    float maxSpeed;                 // in m/s
+    float maxAcceleration;          // including boundary forces and gravity, in m/s^2
+    float averageDensityError;      // mean of |density - rest density| / rest density
+    float maxDensityError;          // max of |density - rest density| / rest density
+    unsigned int surfacePointCounts;    // particles at the surface, see SPHSystem::getSurfaceFlags
+};
+
+/** writes SPHStats periodically, as csv or one json object per line */
+class SPHStatsWriter
+{
+public:
+    enum Format { FORMAT_CSV, FORMAT_JSON };
+
+    bool open(const char* path, Format format, unsigned int intervalTicks);
+    void close();
+    bool isOpen() const { return m_file.is_open(); }
+
+    /** write stats if at least intervalTicks ticks passed since the last write */
+    void update(const SPHStats& stats);
+
+private:
+    void _writeCSV(const SPHStats& stats);
+    void _writeJSON(const SPHStats& stats);
+
+private:
+    std::ofstream m_file;
+    Format m_format;
+    unsigned int m_intervalTicks;
+    unsigned long long m_lastTick;
+    bool m_hasWritten;
+
+public:
+    SPHStatsWriter();
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_SPH_STATS_H
@@ -3,8 +3,44 @@
 //
 
 #include "sph_system.h"
+#include "checkpoint.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+
+namespace
+{
+    // border around the wall box covered by the grid, in world units
+    const float GRID_BORDER = 1.0f;
+    // the stats time one neighbor commit and decode in this many and scale them up, the clock stays off the hot loop
+    const unsigned int NEIGHBOR_TIMING_INTERVAL = 64;
+
+    float elapsedMilliseconds(std::chrono::steady_clock::time_point& last)
+    {
+        auto now = std::chrono::steady_clock::now();
+        float ms = std::chrono::duration<float, std::milli>(now - last).count();
+        last = now;
+        return ms;
+    }
+
+    // direction in which a particle is split, hashed from its id and the tick so it doesn't depend on the order
+    glm::vec3 getSplitDirection(uint32_t id, unsigned long long tick)
+    {
+        uint64_t x = (((uint64_t)id << 32) | (tick & 0xffffffffull)) + 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        x ^= x >> 31;
+
+        //uniform on the sphere
+        float z = (float)(x & 0xffffff) / (float)0x800000 - 1.f;
+        float phi = (float)((x >> 24) & 0xffffff) / (float)0x1000000 * 6.2831853f;
+        float s = std::sqrt(std::max(0.f, 1.f - z * z));
+        return glm::vec3(s * std::cos(phi), s * std::sin(phi), z);
+    }
+}
 
 SPHSystem::SPHSystem() {
     m_unitScale			= 0.004f;			// 尺寸单位
@@ -17,9 +53,43 @@ SPHSystem::SPHSystem() {
     m_boundaryStiffness = 10000.f;
     m_boundaryDampening = 256.f;
     m_speedLimiting		= 200.f;
+    m_surfaceNeighborCounts = 12;
+    m_surfaceGradient   = 0.3f;
     m_deltaTime         = 0.003f;
     m_timeIntegrator    = new SemiImplicitEuler(m_deltaTime);
 
+    m_adaptiveEnabled   = false;
+    m_uniformMass       = true;
+    m_minMassRatio      = 1.f;
+    m_maxMassRatio      = 4.f;
+    m_splitVorticity    = 60.f;
+    m_mergeVorticity    = 20.f;
+    m_adaptInterval     = 10;
+
+    _computeKernels();
+
+    m_nextPointId = 0;
+
+    m_taskPool = nullptr;
+    m_neighborTables = nullptr;
+    m_workerPartials = nullptr;
+    setThreadCounts(1);
+
+    m_statsEnabled = true;
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(&m_diagnostics, 0, sizeof(m_diagnostics));
+}
+
+SPHSystem::~SPHSystem()
+{
+    free(m_timeIntegrator);
+    delete m_taskPool;
+    delete[] m_neighborTables;
+    delete[] m_workerPartials;
+}
+
+void SPHSystem::_computeKernels()
+{
     //Poly6 Kernel
     m_kernelPoly6 = 315.0f/(64.0f * 3.141592f * pow(m_smoothRadius, 9));
     //Spiky Kernel
@@ -28,20 +98,162 @@ SPHSystem::SPHSystem() {
     m_kernelViscosity = 45.0f/(3.141592f * pow(m_smoothRadius, 6));
 }
 
-SPHSystem::~SPHSystem()
+void SPHSystem::setThreadCounts(unsigned int threadCounts)
 {
-    free(m_timeIntegrator);
+    if (m_taskPool && m_taskPool->getThreadCounts() == threadCounts) return;
+
+    delete m_taskPool;
+    delete[] m_neighborTables;
+    delete[] m_workerPartials;
+
+    m_taskPool = new TaskPool(threadCounts);
+    m_neighborTables = new NeighborTable[m_taskPool->getThreadCounts()];
+    m_workerPartials = new WorkerPartial[m_taskPool->getThreadCounts()];
+}
+
+void SPHSystem::setAdaptiveResolution(bool enabled, float minMassRatio, float maxMassRatio)
+{
+    m_adaptiveEnabled = enabled;
+    m_minMassRatio = std::min(std::max(minMassRatio, 0.01f), 1.f);
+    m_maxMassRatio = std::max(maxMassRatio, 1.f);
+
+    //the levels follow the radius range, they are set up by init otherwise
+    if (m_gridContainer.getCellCounts() > 0) _initGridHierarchy();
+}
+
+void SPHSystem::setAdaptiveThresholds(float splitVorticity, float mergeVorticity, unsigned int intervalTicks)
+{
+    m_splitVorticity = splitVorticity;
+    m_mergeVorticity = mergeVorticity;
+    m_adaptInterval = std::max(intervalTicks, 1u);
+}
+
+void SPHSystem::_initGridHierarchy()
+{
+    //the radius grows with the cube root of the mass
+    m_gridHierarchy.init(m_sphWallBox, m_unitScale, m_smoothRadius * std::cbrt(m_minMassRatio),
+                         m_smoothRadius * std::cbrt(m_maxMassRatio), GRID_BORDER);
+}
+
+void SPHSystem::_resetPointMasses()
+{
+    m_pointMasses.assign(m_particleBuffer.size(), m_particleMass);
+    m_pointRadii.assign(m_particleBuffer.size(), m_smoothRadius);
+    m_uniformMass = true;
+}
+
+void SPHSystem::_setPointMasses(const float *masses, const float *radii, unsigned int counts)
+{
+    if (!masses || !radii)
+    {
+        _resetPointMasses();
+        return;
+    }
+
+    m_pointMasses.assign(masses, masses + counts);
+    m_pointRadii.assign(radii, radii + counts);
+    m_uniformMass = true;
+    for (unsigned int i = 0; i < counts && m_uniformMass; i++)
+    {
+        m_uniformMass = masses[i] == m_particleMass && radii[i] == m_smoothRadius;
+    }
 }
 
 void SPHSystem::tick()
 {
+    TRACE_SCOPE("tick");
+
+    auto start = std::chrono::steady_clock::now();
+    tickDensity(m_particleBuffer.size());
+    tickForce(m_particleBuffer.size());
+    if (m_statsEnabled) m_stats.tickTime = elapsedMilliseconds(start);
+}
+
+void SPHSystem::tickDensity(unsigned int ownedCounts)
+{
+    ownedCounts = std::min(ownedCounts, m_particleBuffer.size());
+    if (!m_statsEnabled)
+    {
+        _insertParticles();
+        _computeDensity(ownedCounts);
+        return;
+    }
+
+    auto last = std::chrono::steady_clock::now();
+    _insertParticles();
+    m_stats.gridTime = elapsedMilliseconds(last);
+    _computeDensity(ownedCounts);
+    m_stats.densityTime = elapsedMilliseconds(last);
+}
+
+void SPHSystem::tickForce(unsigned int ownedCounts)
+{
+    ownedCounts = std::min(ownedCounts, m_particleBuffer.size());
+    m_stats.tickCounts++;
+    if (!m_statsEnabled)
+    {
+        _computeForce(ownedCounts);
+        _advance(ownedCounts);
+        _adapt(ownedCounts);
+        return;
+    }
+
+    auto last = std::chrono::steady_clock::now();
+    _computeForce(ownedCounts);
+    m_stats.forceTime = elapsedMilliseconds(last);
+    _advance(ownedCounts);
+    m_stats.advanceTime = elapsedMilliseconds(last);
+
+    //the neighbor tables are for the particles before the adapt pass
+    _collectStats();
+    _adapt(ownedCounts);
+    m_stats.adaptTime = elapsedMilliseconds(last);
+}
+
+void SPHSystem::_insertParticles()
+{
+    TRACE_SCOPE("insert particles");
+
     //distribute all particles to grids in gridContainer for Neighborhood Particles Search
     m_gridContainer.insertParticles(&m_particleBuffer);
+    if (m_adaptiveEnabled || !m_uniformMass) m_gridHierarchy.insertParticles(&m_particleBuffer, m_pointRadii.data());
+}
 
+void SPHSystem::_collectStats()
+{
+    unsigned int committedCounts = 0;
+    unsigned int neighborCounts = 0;
+
+    m_stats.pointCounts = m_particleBuffer.size();
+    m_stats.maxNeighborCounts = 0;
+    m_stats.truncatedPointCounts = 0;
+    m_stats.neighborTableBytes = 0;
+    m_stats.neighborTableCapacity = 0;
+    m_stats.neighborTableGrowCounts = 0;
+    m_stats.neighborEncodeTime = 0.f;
+    m_stats.neighborDecodeTime = 0.f;
+    m_stats.neighborDecodeCounts = 0;
+
+    for (unsigned int i = 0; i < m_taskPool->getThreadCounts(); i++)
+    {
+        const NeighborTable& table = m_neighborTables[i];
+        committedCounts += table.getCommittedPointCounts();
+        neighborCounts += table.getTotalNeighborCounts();
+        if (table.getMaxNeighborCounts() > m_stats.maxNeighborCounts) m_stats.maxNeighborCounts = table.getMaxNeighborCounts();
+        m_stats.truncatedPointCounts += table.getTruncatedPointCounts();
+        m_stats.neighborTableBytes += table.getDataBufBytes();
+        m_stats.neighborTableCapacity += table.getDataBufCapacity();
+        m_stats.neighborTableGrowCounts += table.getGrowCounts();
+        m_stats.neighborEncodeTime += m_workerPartials[i].neighborEncodeTime;
+        m_stats.neighborDecodeTime += m_workerPartials[i].neighborDecodeTime;
+        m_stats.neighborDecodeCounts += m_workerPartials[i].neighborDecodeCounts;
+    }
 
-    _computeDensity();
-    _computeForce();
-    _advance();
+    m_stats.averageNeighborCounts = committedCounts > 0 ? (float)neighborCounts / committedCounts : 0.f;
+    m_stats.neighborBytesPerPoint = committedCounts > 0 ? (float)m_stats.neighborTableBytes / committedCounts : 0.f;
+    m_stats.totalTruncatedPointCounts += m_stats.truncatedPointCounts;
+    m_stats.gridCellCounts = m_gridContainer.getCellCounts();
+    m_stats.occupiedCellCounts = m_gridContainer.getOccupiedCellCounts();
 }
 
 void SPHSystem::_init(unsigned short maxPointCounts,
@@ -51,33 +263,163 @@ void SPHSystem::_init(unsigned short maxPointCounts,
     
     //allocate memory for particle buffer
     m_particleBuffer.reset(maxPointCounts);
+    m_surfaceFlags.clear();
+    m_pointIds.clear();
+    m_pointMasses.clear();
+    m_pointRadii.clear();
+    m_uniformMass = true;
+    m_nextPointId = 0;
 
     m_sphWallBox = wallBox;
     m_gravityDir = gravity;
 
+    m_stats.tickCounts = 0;
+    m_stats.totalTruncatedPointCounts = 0;
+
     // Create particles
-    float pointDistance	= std::pow(m_particleMass/m_restDensity, 1.0f/3.0f); //粒子间距
-    addParticles(initFluidBox, pointDistance/m_unitScale);
+    addParticles(initFluidBox, getPointDistance()); //粒子间距
 
     // Setup grid Grid cell size (2r)
-    m_gridContainer.init(wallBox, m_unitScale, m_smoothRadius * 2.f, 1.0);
+    m_gridContainer.init(wallBox, m_unitScale, m_smoothRadius * 2.f, GRID_BORDER);
+    _initGridHierarchy();
+    _insertParticles();
 }
 
 
-void SPHSystem::_computeDensity()
+bool SPHSystem::saveCheckpoint(const char *path) const
 {
+    CheckpointState state;
+    getCheckpointState(state);
+
+    CheckpointWriter writer;
+    return writer.write(path, state, false);
+}
+
+bool SPHSystem::loadCheckpoint(const char *path)
+{
+    MappedFile file;
+    CheckpointState state;
+    if (!readCheckpoint(path, file, state)) return false;
+
+    //particles are copied straight out of the mapping
+    return setCheckpointState(state);
+}
+
+void SPHSystem::getCheckpointState(CheckpointState &state) const
+{
+    CheckpointParameters& params = state.parameters;
+    params.unitScale = m_unitScale;
+    params.viscosity = m_viscosity;
+    params.restDensity = m_restDensity;
+    params.particleMass = m_particleMass;
+    params.smoothRadius = m_smoothRadius;
+    params.gasConstantK = m_gasConstantK;
+    params.boundaryStiffness = m_boundaryStiffness;
+    params.boundaryDampening = m_boundaryDampening;
+    params.speedLimiting = m_speedLimiting;
+    params.deltaTime = m_deltaTime;
+    for (int i = 0; i < 3; i++) params.gravity[i] = m_gravityDir[i];
+
+    CheckpointGrid& grid = state.grid;
+    for (int i = 0; i < 3; i++)
+    {
+        grid.wallMin[i] = m_sphWallBox.min[i];
+        grid.wallMax[i] = m_sphWallBox.max[i];
+    }
+    grid.cellSize = m_smoothRadius * 2.f;
+    grid.border = GRID_BORDER;
+
+    state.tickCounts = m_stats.tickCounts;
+    state.particles = m_particleBuffer.get(0);
+    state.masses = m_pointMasses.data();
+    state.radii = m_pointRadii.data();
+    state.ids = m_pointIds.data();
+    state.pointCounts = m_particleBuffer.size();
+    state.pointCapacity = m_particleBuffer.capacity();
+    state.nextPointId = m_nextPointId;
+}
+
+bool SPHSystem::setCheckpointState(const CheckpointState &state)
+{
+    //neighbor indices are 16 bits wide, check before the capacity is allocated
+    if (state.pointCounts > 0xffff || state.pointCapacity > 0xffff || state.pointCapacity < state.pointCounts)
+    {
+        return false;
+    }
+
+    const CheckpointParameters& params = state.parameters;
+    m_unitScale = params.unitScale;
+    m_viscosity = params.viscosity;
+    m_restDensity = params.restDensity;
+    m_particleMass = params.particleMass;
+    m_smoothRadius = params.smoothRadius;
+    m_gasConstantK = params.gasConstantK;
+    m_boundaryStiffness = params.boundaryStiffness;
+    m_boundaryDampening = params.boundaryDampening;
+    m_speedLimiting = params.speedLimiting;
+    m_deltaTime = params.deltaTime;
+    m_gravityDir = glm::vec3(params.gravity[0], params.gravity[1], params.gravity[2]);
+    m_timeIntegrator->setDeltaTime(m_deltaTime);
+    _computeKernels();
+
+    m_particleBuffer.reset(state.pointCapacity);
+    m_particleBuffer.assign(state.particles, state.pointCounts);
+    m_surfaceFlags.assign(state.pointCounts, 1);
+    _setPointMasses(state.masses, state.radii, state.pointCounts);
+    m_pointIds.assign(state.ids, state.ids + state.pointCounts);
+    m_nextPointId = state.nextPointId;
+    for (unsigned int i = 0; i < state.pointCounts; i++) m_nextPointId = std::max(m_nextPointId, m_pointIds[i] + 1);
+
+    const CheckpointGrid& grid = state.grid;
+    m_sphWallBox = ParticleBox3(glm::vec3(grid.wallMin[0], grid.wallMin[1], grid.wallMin[2]),
+                                glm::vec3(grid.wallMax[0], grid.wallMax[1], grid.wallMax[2]));
+    m_gridContainer.init(m_sphWallBox, m_unitScale, grid.cellSize, grid.border);
+    _initGridHierarchy();
+    _insertParticles();
+
+    m_stats.tickCounts = state.tickCounts;
+    m_stats.totalTruncatedPointCounts = 0;
+    return true;
+}
+
+void SPHSystem::_computeDensity(unsigned int counts)
+{
+    m_taskPool->parallelFor(counts, [this](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        if (m_adaptiveEnabled || !m_uniformMass) _computeDensityAdaptive(begin, end, m_neighborTables[worker], m_workerPartials[worker]);
+        else _computeDensity(begin, end, m_neighborTables[worker], m_workerPartials[worker]);
+    });
+
+    float errorSum = 0.f;
+    m_diagnostics.maxDensityError = 0.f;
+    for (unsigned int i = 0; i < m_taskPool->getThreadCounts(); i++)
+    {
+        errorSum += m_workerPartials[i].densityErrorSum;
+        m_diagnostics.maxDensityError = std::max(m_diagnostics.maxDensityError, m_workerPartials[i].maxDensityError);
+    }
+    m_diagnostics.averageDensityError = counts > 0 ? errorSum / counts : 0.f;
+}
+
+void SPHSystem::_computeDensity(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial)
+{
+    TRACE_SCOPE("density");
+
     //h^2
     float h2 = m_smoothRadius*m_smoothRadius;
+    float invRestDensity = 1.f / m_restDensity;
+    float errorSum = 0.f;
+    float maxError = 0.f;
 
     //reset neighbor table
-    m_neighborTable.reset(m_particleBuffer.size());
+    neighborTable.reset(m_particleBuffer.size(), end);
+    float encodeTime = 0.f;
 
-    for(unsigned int i=0; i<m_particleBuffer.size(); i++)
+    for(unsigned int i=begin; i<end; i++)
     {
         Particle* pi = m_particleBuffer.get(i);
 
         float sum = 0.f;
-        m_neighborTable.point_prepare(i);
+        neighborTable.point_prepare(i);
 
         int gridCell[8];
         m_gridContainer.findCells(pi->pos, m_smoothRadius/m_unitScale, gridCell);
@@ -107,7 +449,7 @@ void SPHSystem::_computeDensity()
                         float h2_r2 =  h2 - r2;
                         sum += std::pow(h2_r2, 3.f);  //(h^2-r^2)^3
 
-                        if(!m_neighborTable.point_add_neighbor(pndx, std::sqrt(r2)))
+                        if(!neighborTable.point_add_neighbor(pndx))
                         {
                             isNeighborTableFull = true;
                             break;
@@ -124,38 +466,83 @@ void SPHSystem::_computeDensity()
 
         }
 
-        m_neighborTable.point_commit();
+        if (m_statsEnabled && i % NEIGHBOR_TIMING_INTERVAL == 0)
+        {
+            auto last = std::chrono::steady_clock::now();
+            neighborTable.point_commit();
+            encodeTime += elapsedMilliseconds(last);
+        }
+        else neighborTable.point_commit();
 
         //m_kernelPoly6 = 315.0f/(64.0f * 3.141592f * h^9);
         pi->density = m_kernelPoly6 * m_particleMass * sum;
 
         //Calculate the pressure of single particle with the Ideal Gas State Equation
         pi->pressure = (pi->density - m_restDensity) * m_gasConstantK;
+
+        //relative density error
+        float error = std::fabs(pi->density - m_restDensity) * invRestDensity;
+        errorSum += error;
+        maxError = std::max(maxError, error);
+    }
+
+    partial.densityErrorSum = errorSum;
+    partial.maxDensityError = maxError;
+    partial.neighborEncodeTime = encodeTime * NEIGHBOR_TIMING_INTERVAL;
+}
+
+void SPHSystem::_computeForce(unsigned int counts)
+{
+    bool variable = m_adaptiveEnabled || !m_uniformMass;
+    if (variable) m_pointVorticity.resize(m_particleBuffer.size());
+
+    //same chunks as _computeDensity, so every worker reads the neighbor table it has filled
+    m_taskPool->parallelFor(counts, [this, variable](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        if (variable) _computeForceAdaptive(begin, end, m_neighborTables[worker], m_workerPartials[worker]);
+        else _computeForce(begin, end, m_neighborTables[worker], m_workerPartials[worker]);
+    });
+
+    m_diagnostics.surfacePointCounts = 0;
+    for (unsigned int i = 0; i < m_taskPool->getThreadCounts(); i++)
+    {
+        m_diagnostics.surfacePointCounts += m_workerPartials[i].surfacePointCounts;
     }
 }
 
-void SPHSystem::_computeForce()
+void SPHSystem::_computeForce(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial)
 {
+    TRACE_SCOPE("force");
+
     float h2 = m_smoothRadius * m_smoothRadius;
+    float surfaceGradient2 = m_surfaceGradient * m_surfaceGradient / h2;
+    unsigned int surfacePointCounts = 0;
+    float decodeTime = 0.f;
 
-    for(unsigned int i=0; i<m_particleBuffer.size(); i++)
+    for(unsigned int i=begin; i<end; i++)
     {
         Particle* pi = m_particleBuffer.get(i);
 
         glm::vec3 accel_sum(0,0,0);
+        glm::vec3 colorGradient(0,0,0);
 
-        int neighborCounts = m_neighborTable.getNeighborCounts(i);
+        unsigned short neighbors[NeighborTable::MAX_NEIGHBOR_COUNTS];
+        int neighborCounts;
+        if (m_statsEnabled && i % NEIGHBOR_TIMING_INTERVAL == 0)
+        {
+            auto last = std::chrono::steady_clock::now();
+            neighborCounts = neighborTable.getNeighbors(i, neighbors);
+            decodeTime += elapsedMilliseconds(last);
+        }
+        else neighborCounts = neighborTable.getNeighbors(i, neighbors);
 
         for(int j=0; j <neighborCounts; j++)
         {
-            unsigned short neighborIndex;
-            float r;
-            m_neighborTable.getNeighborInfo(i, j, neighborIndex, r);
+            Particle* pj = m_particleBuffer.get(neighbors[j]);
 
-            Particle* pj = m_particleBuffer.get(neighborIndex);
-
-            //r(i)-r(j)
+            //r(i)-r(j), the table keeps no distances
             glm::vec3 ri_rj = (pi->pos - pj->pos)*m_unitScale;
+            float r = std::sqrt(glm::dot(ri_rj, ri_rj));
             //h-r
             float h_r = m_smoothRadius - r;
             //h^2-r^2
@@ -170,18 +557,229 @@ void SPHSystem::_computeForce()
             //m_kernelViscosity = 45.0f/(3.141592f * h^6);
             float vterm = m_kernelViscosity * m_viscosity * h_r * m_particleMass/(pi->density * pj->density);
             accel_sum += (pj->velocity - pi->velocity)*vterm;
+
+            //gradient of the color field, sum of m/rho(j) * grad W_spiky
+            colorGradient += ri_rj*(m_kernelSpiky*h_r*h_r/(r*pj->density));
+        }
+
+        pi->acceleration = accel_sum;
+
+        colorGradient *= m_particleMass;
+        bool surface = _isSurface(pi->pos, colorGradient, neighborCounts, m_smoothRadius, surfaceGradient2);
+        m_surfaceFlags[i] = surface ? 1 : 0;
+        if (surface) surfacePointCounts++;
+    }
+
+    partial.surfacePointCounts = surfacePointCounts;
+    partial.neighborDecodeTime = decodeTime * NEIGHBOR_TIMING_INTERVAL;
+    partial.neighborDecodeCounts = end - begin;
+}
+
+bool SPHSystem::_isSurface(const glm::vec3 &pos, glm::vec3 colorGradient, int neighborCounts, float smoothRadius,
+                           float gradientThreshold) const
+{
+    if (neighborCounts >= m_surfaceNeighborCounts) return false;
+
+    //the gradient points into the fluid, the part pointing away from a close wall comes from the neighbors
+    //missing behind the wall and not from a free surface. close means within the boundary force layer
+    //(2 world units) and one kernel radius
+    float wallRange = 2.f + smoothRadius / m_unitScale;
+    for (int k = 0; k < 3; k++)
+    {
+        if (pos[k] - m_sphWallBox.min[k] < wallRange && colorGradient[k] > 0.f) colorGradient[k] = 0.f;
+        if (m_sphWallBox.max[k] - pos[k] < wallRange && colorGradient[k] < 0.f) colorGradient[k] = 0.f;
+    }
+
+    //few neighbors and neighbors on one side only, the particle is at the surface
+    return glm::dot(colorGradient, colorGradient) > gradientThreshold;
+}
+
+void SPHSystem::_computeDensityAdaptive(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial)
+{
+    TRACE_SCOPE("density");
+
+    //W(r, h) = 315 / (64 pi h^9) * (h^2 - r^2)^3, a pair uses the mean of both radii so the forces stay symmetric
+    const float poly6 = 315.0f / (64.0f * 3.141592f);
+    float invRestDensity = 1.f / m_restDensity;
+    float errorSum = 0.f;
+    float maxError = 0.f;
+
+    neighborTable.reset(m_particleBuffer.size(), end);
+    float encodeTime = 0.f;
+
+    for(unsigned int i=begin; i<end; i++)
+    {
+        Particle* pi = m_particleBuffer.get(i);
+        float hi = m_pointRadii[i];
+
+        //self, m * h^6 / h^9
+        float sum = m_pointMasses[i] / (hi * hi * hi);
+        neighborTable.point_prepare(i);
+
+        bool isNeighborTableFull = false;
+        for(int level=0; level < m_gridHierarchy.getLevelCounts() && !isNeighborTableFull; level++)
+        {
+            float levelRadius = m_gridHierarchy.getLevelMaxRadius(level);
+            if(levelRadius == 0.f) continue;
+
+            //no pair reaches further than the mean of this radius and the largest one of the level
+            glm::ivec3 cellMin, cellMax;
+            m_gridHierarchy.findCellRange(level, pi->pos, 0.5f * (hi + levelRadius) / m_unitScale, cellMin, cellMax);
+            for(int z=cellMin.z; z <= cellMax.z && !isNeighborTableFull; z++)
+            for(int y=cellMin.y; y <= cellMax.y && !isNeighborTableFull; y++)
+            for(int x=cellMin.x; x <= cellMax.x && !isNeighborTableFull; x++)
+            {
+                int pndx = m_gridHierarchy.getGridData(level, x, y, z);
+                while(pndx != -1)
+                {
+                    Particle* pj = m_particleBuffer.get(pndx);
+                    if(pj != pi)
+                    {
+                        glm::vec3 pi_pj = (pi->pos - pj->pos) * m_unitScale;
+                        float r2 = glm::dot(pi_pj, pi_pj);
+                        float h = 0.5f * (hi + m_pointRadii[pndx]);
+                        float h2 = h * h;
+                        if (h2 > r2)
+                        {
+                            float h2_r2 = h2 - r2;
+                            float invH3 = 1.f / (h2 * h);
+                            sum += m_pointMasses[pndx] * h2_r2 * h2_r2 * h2_r2 * invH3 * invH3 * invH3;
+
+                            if(!neighborTable.point_add_neighbor(pndx))
+                            {
+                                isNeighborTableFull = true;
+                                break;
+                            }
+                        }
+                    }
+                    pndx = m_gridHierarchy.getNext(pndx);
+                }
+            }
+        }
+
+        if (m_statsEnabled && i % NEIGHBOR_TIMING_INTERVAL == 0)
+        {
+            auto last = std::chrono::steady_clock::now();
+            neighborTable.point_commit();
+            encodeTime += elapsedMilliseconds(last);
+        }
+        else neighborTable.point_commit();
+
+        pi->density = poly6 * sum;
+        pi->pressure = (pi->density - m_restDensity) * m_gasConstantK;
+
+        float error = std::fabs(pi->density - m_restDensity) * invRestDensity;
+        errorSum += error;
+        maxError = std::max(maxError, error);
+    }
+
+    partial.densityErrorSum = errorSum;
+    partial.maxDensityError = maxError;
+    partial.neighborEncodeTime = encodeTime * NEIGHBOR_TIMING_INTERVAL;
+}
+
+void SPHSystem::_computeForceAdaptive(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial)
+{
+    TRACE_SCOPE("force");
+
+    //the kernels of _computeForce without their h^6
+    const float spiky = -45.0f / 3.141592f;
+    const float viscosity = 45.0f / 3.141592f;
+    unsigned int surfacePointCounts = 0;
+    float decodeTime = 0.f;
+
+    for(unsigned int i=begin; i<end; i++)
+    {
+        Particle* pi = m_particleBuffer.get(i);
+        float hi = m_pointRadii[i];
+
+        glm::vec3 accel_sum(0,0,0);
+        glm::vec3 colorGradient(0,0,0);
+        glm::vec3 vorticity(0,0,0);
+
+        unsigned short neighbors[NeighborTable::MAX_NEIGHBOR_COUNTS];
+        int neighborCounts;
+        if (m_statsEnabled && i % NEIGHBOR_TIMING_INTERVAL == 0)
+        {
+            auto last = std::chrono::steady_clock::now();
+            neighborCounts = neighborTable.getNeighbors(i, neighbors);
+            decodeTime += elapsedMilliseconds(last);
+        }
+        else neighborCounts = neighborTable.getNeighbors(i, neighbors);
+
+        for(int j=0; j <neighborCounts; j++)
+        {
+            unsigned short neighborIndex = neighbors[j];
+            Particle* pj = m_particleBuffer.get(neighborIndex);
+            float mj = m_pointMasses[neighborIndex];
+            float h = 0.5f * (hi + m_pointRadii[neighborIndex]);
+            float h3 = h * h * h;
+            float invH6 = 1.f / (h3 * h3);
+
+            glm::vec3 ri_rj = (pi->pos - pj->pos)*m_unitScale;
+            float r = std::sqrt(glm::dot(ri_rj, ri_rj));
+            float h_r = h - r;
+            glm::vec3 vj_vi = pj->velocity - pi->velocity;
+
+            //F_Pressure, symmetric in i and j so pairs exchange equal and opposite momentum
+            float pterm = -mj*spiky*invH6*h_r*h_r*(pi->pressure+pj->pressure)/(2.f * pi->density * pj->density);
+            accel_sum += ri_rj*pterm/r;
+
+            //F_Viscosity
+            float vterm = viscosity*invH6 * m_viscosity * h_r * mj/(pi->density * pj->density);
+            accel_sum += vj_vi*vterm;
+
+            //color field gradient and vorticity, sums of m/rho(j) * grad W_spiky
+            glm::vec3 gradient = ri_rj*(spiky*invH6*h_r*h_r*mj/(r*pj->density));
+            colorGradient += gradient;
+            vorticity += glm::cross(vj_vi, gradient);
         }
 
         pi->acceleration = accel_sum;
+        m_pointVorticity[i] = glm::length(vorticity);
+
+        float surfaceGradient = m_surfaceGradient / hi;
+        bool surface = _isSurface(pi->pos, colorGradient, neighborCounts, hi, surfaceGradient * surfaceGradient);
+        m_surfaceFlags[i] = surface ? 1 : 0;
+        if (surface) surfacePointCounts++;
     }
+
+    partial.surfacePointCounts = surfacePointCounts;
+    partial.neighborDecodeTime = decodeTime * NEIGHBOR_TIMING_INTERVAL;
+    partial.neighborDecodeCounts = end - begin;
 }
 
-void SPHSystem::_advance() {
+void SPHSystem::_advance(unsigned int counts)
+{
+    m_taskPool->parallelFor(counts, [this](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        _advance(begin, end, m_workerPartials[worker]);
+    });
+
+    float energySum = 0.f;
+    float maxSpeed2 = 0.f;
+    float maxAcceleration2 = 0.f;
+    for (unsigned int i = 0; i < m_taskPool->getThreadCounts(); i++)
+    {
+        energySum += m_workerPartials[i].energySum;
+        maxSpeed2 = std::max(maxSpeed2, m_workerPartials[i].maxSpeed2);
+        maxAcceleration2 = std::max(maxAcceleration2, m_workerPartials[i].maxAcceleration2);
+    }
+    m_diagnostics.kineticEnergy = 0.5f * energySum;
+    m_diagnostics.maxSpeed = std::sqrt(maxSpeed2);
+    m_diagnostics.maxAcceleration = std::sqrt(maxAcceleration2);
+}
 
+void SPHSystem::_advance(unsigned int begin, unsigned int end, WorkerPartial& partial)
+{
+    TRACE_SCOPE("advance");
 
     float SL2 = m_speedLimiting*m_speedLimiting;
+    float energySum = 0.f;
+    float maxSpeed2 = 0.f;
+    float maxAcceleration2 = 0.f;
 
-    for(unsigned int i=0; i<m_particleBuffer.size(); i++)
+    for(unsigned int i=begin; i<end; i++)
     {
         Particle* p = m_particleBuffer.get(i);
 
@@ -268,7 +866,178 @@ void SPHSystem::_advance() {
 
         m_timeIntegrator->update(p);
 
+        float speed2 = glm::dot(p->velocity, p->velocity);
+        energySum += m_pointMasses[i] * speed2;
+        maxSpeed2 = std::max(maxSpeed2, speed2);
+        maxAcceleration2 = std::max(maxAcceleration2, glm::dot(accel, accel));
+    }
+
+    partial.energySum = energySum;
+    partial.maxSpeed2 = maxSpeed2;
+    partial.maxAcceleration2 = maxAcceleration2;
+}
+
+void SPHSystem::_adapt(unsigned int counts)
+{
+    m_stats.splitCounts = 0;
+    m_stats.mergeCounts = 0;
+
+    //the ghosts of a distributed tick are not classified
+    if (!m_adaptiveEnabled || counts == 0 || counts != m_particleBuffer.size()) return;
+    if (m_stats.tickCounts % m_adaptInterval != 0) return;
+
+    TRACE_SCOPE("adapt resolution");
+
+    //same chunks as _computeDensity, every worker reads the neighbor table it has filled
+    m_adaptActions.resize(counts);
+    m_adaptPartners.resize(counts);
+    m_taskPool->parallelFor(counts, [this](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        _classifyAdapt(begin, end, m_neighborTables[worker]);
+    });
+    m_taskPool->parallelFor(counts, [this](unsigned int begin, unsigned int end, unsigned int worker)
+    {
+        _findMergePartners(begin, end, m_neighborTables[worker]);
+    });
+
+    const unsigned int maxPointCounts = 0xffff;
+    std::vector<Particle> particles;
+    std::vector<float> masses;
+    std::vector<float> radii;
+    std::vector<uint32_t> ids;
+    std::vector<unsigned char> surfaceFlags;
+    std::vector<unsigned char> merged(counts, 0);
+    particles.reserve(counts + counts / 8);
+
+    auto addParticle = [&](const Particle& p, float mass, uint32_t id, unsigned char surface)
+    {
+        particles.push_back(p);
+        masses.push_back(mass);
+        radii.push_back(m_smoothRadius * std::cbrt(mass / m_particleMass));
+        ids.push_back(id);
+        surfaceFlags.push_back(surface);
+    };
+
+    //pairs are taken in index order, a particle whose partner is already taken waits for the next pass
+    float spacingScale = 1.f / (std::cbrt(m_restDensity) * m_unitScale);
+    for (unsigned int i = 0; i < counts; i++)
+    {
+        if (merged[i]) continue;
+        const Particle& p = *m_particleBuffer.get(i);
+        float mass = m_pointMasses[i];
+        int j = m_adaptPartners[i];
+
+        if (m_adaptActions[i] == ADAPT_MERGE && j > (int)i && !merged[j])
+        {
+            //at the center of mass with the momentum of both
+            merged[j] = 1;
+            const Particle& q = *m_particleBuffer.get(j);
+            float sum = mass + m_pointMasses[j];
+            float a = mass / sum;
+            float b = m_pointMasses[j] / sum;
 
+            Particle c = p;
+            c.pos = p.pos * a + q.pos * b;
+            c.velocity = p.velocity * a + q.velocity * b;
+            c.acceleration = p.acceleration * a + q.acceleration * b;
+            c.density = p.density * a + q.density * b;
+            c.pressure = p.pressure * a + q.pressure * b;
+            addParticle(c, sum, m_pointIds[i], m_surfaceFlags[i] | m_surfaceFlags[j]);
+            m_stats.mergeCounts++;
+            continue;
+        }
+
+        //every particle still to come keeps at least one place
+        if (m_adaptActions[i] == ADAPT_SPLIT && particles.size() + (counts - i) + 1 <= maxPointCounts)
+        {
+            //two halves one child spacing apart, around the old position
+            float childMass = mass * 0.5f;
+            glm::vec3 offset = getSplitDirection(m_pointIds[i], m_stats.tickCounts) * (0.5f * std::cbrt(childMass) * spacingScale);
+            Particle c = p;
+            c.pos = p.pos + offset;
+            addParticle(c, childMass, m_pointIds[i], m_surfaceFlags[i]);
+            c.pos = p.pos - offset;
+            addParticle(c, childMass, m_nextPointId++, m_surfaceFlags[i]);
+            m_stats.splitCounts++;
+            continue;
+        }
+
+        addParticle(p, mass, m_pointIds[i], m_surfaceFlags[i]);
+    }
+
+    if (m_stats.splitCounts == 0 && m_stats.mergeCounts == 0) return;
+
+    unsigned int pointCounts = (unsigned int)particles.size();
+    if (pointCounts > m_particleBuffer.capacity()) m_particleBuffer.reset(std::min(pointCounts + pointCounts / 4 + 64, maxPointCounts));
+    m_particleBuffer.assign(particles.data(), pointCounts);
+    m_pointMasses.swap(masses);
+    m_pointRadii.swap(radii);
+    m_pointIds.swap(ids);
+    m_surfaceFlags.swap(surfaceFlags);
+    m_uniformMass = false;
+
+    //the grid chains of this tick point into the old order, readers between ticks follow them
+    _insertParticles();
+}
+
+void SPHSystem::_classifyAdapt(unsigned int begin, unsigned int end, NeighborTable &neighborTable)
+{
+    float minSplitMass = 2.f * m_minMassRatio * m_particleMass * 0.999f;
+    float maxMergeMass = m_maxMassRatio * m_particleMass * 1.001f;
+
+    for (unsigned int i = begin; i < end; i++)
+    {
+        //the neighbors of surface particles keep the fine resolution too, so a layer under the surface is fine
+        bool nearSurface = m_surfaceFlags[i] != 0;
+        unsigned short neighbors[NeighborTable::MAX_NEIGHBOR_COUNTS];
+        int neighborCounts = neighborTable.getNeighbors(i, neighbors);
+        for (int j = 0; j < neighborCounts && !nearSurface; j++)
+        {
+            nearSurface = m_surfaceFlags[neighbors[j]] != 0;
+        }
+
+        float mass = m_pointMasses[i];
+        AdaptAction action = ADAPT_KEEP;
+        if (nearSurface || m_pointVorticity[i] > m_splitVorticity)
+        {
+            if (mass >= minSplitMass) action = ADAPT_SPLIT;
+        }
+        else if (m_pointVorticity[i] < m_mergeVorticity && mass < maxMergeMass)
+        {
+            action = ADAPT_MERGE;
+        }
+        m_adaptActions[i] = action;
+    }
+}
+
+void SPHSystem::_findMergePartners(unsigned int begin, unsigned int end, NeighborTable &neighborTable)
+{
+    float maxMergeMass = m_maxMassRatio * m_particleMass * 1.001f;
+
+    for (unsigned int i = begin; i < end; i++)
+    {
+        m_adaptPartners[i] = -1;
+        if (m_adaptActions[i] != ADAPT_MERGE) continue;
+
+        //the nearest neighbor which may merge too and keeps the sum under the largest mass, at the moved positions
+        const glm::vec3& pos = m_particleBuffer.get(i)->pos;
+        float nearest2 = 0.f;
+        unsigned short neighbors[NeighborTable::MAX_NEIGHBOR_COUNTS];
+        int neighborCounts = neighborTable.getNeighbors(i, neighbors);
+        for (int j = 0; j < neighborCounts; j++)
+        {
+            unsigned short neighborIndex = neighbors[j];
+            if (m_adaptActions[neighborIndex] != ADAPT_MERGE || m_pointMasses[i] + m_pointMasses[neighborIndex] > maxMergeMass) continue;
+
+            glm::vec3 d = m_particleBuffer.get(neighborIndex)->pos - pos;
+            float r2 = glm::dot(d, d);
+            int partner = m_adaptPartners[i];
+            if (partner < 0 || r2 < nearest2 || (r2 == nearest2 && neighborIndex < partner))
+            {
+                m_adaptPartners[i] = neighborIndex;
+                nearest2 = r2;
+            }
+        }
     }
 }
 
@@ -288,4 +1057,60 @@ void SPHSystem::addParticles(const ParticleBox3 &fluidBox, float spacing)
             }
         }
     }
+
+    //new particles count as surface until the next tick classifies them
+    m_surfaceFlags.resize(m_particleBuffer.size(), 1);
+    m_pointMasses.resize(m_particleBuffer.size(), m_particleMass);
+    m_pointRadii.resize(m_particleBuffer.size(), m_smoothRadius);
+    while (m_pointIds.size() < m_particleBuffer.size()) m_pointIds.push_back(m_nextPointId++);
+}
+
+uint64_t SPHSystem::getFluidBoxPointCounts(const glm::vec3 fluidBox_min, const glm::vec3 fluidBox_max) const
+{
+    //same float steps as addParticles, so the counts match exactly
+    float spacing = getPointDistance();
+    uint64_t nx = 0, ny = 0, nz = 0;
+    for (float z=fluidBox_max.z; z>=fluidBox_min.z; z-=spacing) nz++;
+    for (float y=fluidBox_min.y; y<=fluidBox_max.y; y+=spacing) ny++;
+    for (float x=fluidBox_min.x; x<=fluidBox_max.x; x+=spacing) nx++;
+    return nx * ny * nz;
+}
+
+bool SPHSystem::setParticles(const Particle *particles, const uint32_t *ids, unsigned int counts,
+                             const float *masses, const float *radii)
+{
+    //neighbor tables index particles with 16 bits
+    if (counts > 0xffff) return false;
+
+    //headroom, the counts change a little with every call
+    if (counts > m_particleBuffer.capacity()) m_particleBuffer.reset(std::min(counts + counts / 4 + 64, 0xffffu));
+    m_particleBuffer.assign(particles, counts);
+    m_surfaceFlags.assign(counts, 1);
+    _setPointMasses(masses, radii, counts);
+    m_pointIds.assign(ids, ids + counts);
+    for (unsigned int i = 0; i < counts; i++) m_nextPointId = std::max(m_nextPointId, ids[i] + 1);
+    _insertParticles();
+    return true;
+}
+
+unsigned int SPHSystem::addParticles(const glm::vec3 *positions, unsigned int counts)
+{
+    //neighbor tables index particles with 16 bits
+    const unsigned int maxPointCounts = 65535;
+    counts = std::min(counts, maxPointCounts - std::min(maxPointCounts, m_particleBuffer.size()));
+    if (counts == 0) return 0;
+
+    Particle* p = m_particleBuffer.append(counts);
+    for (unsigned int i = 0; i < counts; i++)
+    {
+        p[i].pos = positions[i];
+    }
+
+    m_surfaceFlags.resize(m_particleBuffer.size(), 1);
+    m_pointMasses.resize(m_particleBuffer.size(), m_particleMass);
+    m_pointRadii.resize(m_particleBuffer.size(), m_smoothRadius);
+    m_pointIds.reserve(m_particleBuffer.size());
+    while (m_pointIds.size() < m_particleBuffer.size()) m_pointIds.push_back(m_nextPointId++);
+    _insertParticles();
+    return counts;
 }
@@ -6,8 +6,16 @@
 #define SIMPLE_FLUID_SIMULATOR_SPH_SYSTEM_H
 
 #include "particle_box.h"
+#include "sph_stats.h"
+#include "task_pool.h"
 #include "time_integrator.h"
 
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct CheckpointState;
+
 class SPHSystem{
 
 public:
@@ -23,25 +31,178 @@ public:
               gravity);
     }
 
+    /** add another box of fluid to the system, must be called after init */
+    void addFluidBox(const glm::vec3 fluidBox_min, const glm::vec3 fluidBox_max)
+    {
+        addParticles(ParticleBox3(fluidBox_min, fluidBox_max), getPointDistance());
+    }
+    /** counts of the particles init and addFluidBox lay out in a fluid box */
+    uint64_t getFluidBoxPointCounts(const glm::vec3 fluidBox_min, const glm::vec3 fluidBox_max) const;
+    /** add particles at rest at the given positions in one step, must be called after init. particles beyond
+     *  the 65535 a tick can address are dropped, returns the counts added */
+    unsigned int addParticles(const glm::vec3* positions, unsigned int counts);
+
+    /** set the number of threads used by tick, 1 runs everything on the calling thread */
+    void setThreadCounts(unsigned int threadCounts);
+    unsigned int getThreadCounts() const { return m_taskPool->getThreadCounts(); }
+
+    /** distance between two particles when the fluid is filled, in world units */
+    float getPointDistance() const { return std::pow(m_particleMass/m_restDensity, 1.0f/3.0f) / m_unitScale; }
+    /** radius of the smoothing kernel, in world units */
+    float getSmoothRadius() const { return m_smoothRadius / m_unitScale; }
+    float getDeltaTime() const { return m_deltaTime; }
+    /** metres per world unit */
+    float getUnitScale() const { return m_unitScale; }
+    /** mass of a particle in kg */
+    float getParticleMass() const { return m_particleMass; }
+    /** the constant of the poly6 kernel used for density, W(r) = kernelPoly6 * (h^2 - r^2)^3 with r and h in metres */
+    float getKernelPoly6() const { return m_kernelPoly6; }
+    void setViscosity(float viscosity) { m_viscosity = viscosity; }
+    float getViscosity() const { return m_viscosity; }
+    /** stiffness of the equation of state, pressure = k * (density - rest density) */
+    void setGasConstant(float gasConstantK) { m_gasConstantK = gasConstantK; }
+    float getGasConstant() const { return m_gasConstantK; }
+
+    /** enable phase timers and the collection of solver counters in tick */
+    void setStatsEnabled(bool enabled) { m_statsEnabled = enabled; }
+    bool isStatsEnabled() const { return m_statsEnabled; }
+    /** get the statistics of the last tick, only updated when stats are enabled */
+    const SPHStats& getStats() const { return m_stats; }
+    /** get energy, max speed and density error of the last tick */
+    const SPHDiagnostics& getDiagnostics() const { return m_diagnostics; }
+
+    /** write a full checkpoint, see CheckpointWriter for incremental writes */
+    bool saveCheckpoint(const char* path) const;
+    /** restart from a checkpoint, the system is unchanged if the file can't be used */
+    bool loadCheckpoint(const char* path);
+    /** get a view of the state for a checkpoint, particles point into the particle buffer */
+    void getCheckpointState(CheckpointState& state) const;
+    bool setCheckpointState(const CheckpointState& state);
+
     unsigned int getPointStride() const { return sizeof(Particle); }
     unsigned int getPointCounts() const { return m_particleBuffer.size(); }
     const glm::vec3* getPointBuf() const { return (const glm::vec3*)m_particleBuffer.get(0); }
+    const Particle* getParticles() const { return m_particleBuffer.get(0); }
+    /** mutable particles for embedding code which edits the state between two ticks */
+    Particle* getParticles() { return m_particleBuffer.get(0); }
+    /** id of every particle, assigned when the particle is created and never reused */
+    const uint32_t* getPointIds() const { return m_pointIds.data(); }
+    const ParticleBox3& getWallBox() const { return m_sphWallBox; }
+    const ParticleGridContainer& getGridContainer() const { return m_gridContainer; }
+    /** adaptive resolution: particles carry their own mass and smoothing radius, they are split in two near the
+     *  surface and where the vorticity is high and merged in pairs in the calm bulk, both conserve mass and
+     *  momentum. masses stay between minMassRatio and maxMassRatio times the base mass and the radius follows the
+     *  cube root of the mass, so neighbor counts stay about the same. their neighbors are searched in a
+     *  ParticleGridHierarchy with a level for every doubling of the radius, getGridContainer keeps the base cells.
+     *  disabling it stops splitting and merging, the particles keep their masses. checkpoints keep the masses,
+     *  setParticles takes them or brings back the base mass. FieldProbe and SurfaceExtractor use them too */
+    void setAdaptiveResolution(bool enabled, float minMassRatio = 1.f, float maxMassRatio = 4.f);
+    bool isAdaptiveResolution() const { return m_adaptiveEnabled; }
+    /** split where the vorticity is above splitVorticity, merge where it is below mergeVorticity, both in 1/s,
+     *  every intervalTicks ticks */
+    void setAdaptiveThresholds(float splitVorticity, float mergeVorticity, unsigned int intervalTicks);
+    /** mass of every particle in kg */
+    const float* getPointMasses() const { return m_pointMasses.data(); }
+    /** smoothing radius of every particle in metres */
+    const float* getPointSmoothRadii() const { return m_pointRadii.data(); }
+    /** every particle has the base mass and smoothing radius, the fixed kernels apply */
+    bool isUniformMass() const { return m_uniformMass; }
+
+    /** one byte per particle, 1 for particles at the surface. set by the force pass of tick from the neighbor
+     *  counts and the color field gradient, interior particles are hidden behind the surface ones */
+    const unsigned char* getSurfaceFlags() const { return m_surfaceFlags.data(); }
+    /** classify particles with fewer neighbors and a color field gradient longer than gradient / h as surface,
+     *  the part of the gradient caused by a close wall is left out */
+    void setSurfaceThresholds(int neighborCounts, float gradient) { m_surfaceNeighborCounts = neighborCounts; m_surfaceGradient = gradient; }
     virtual void tick();
+    /** tick in two halves for DistributedSystem. the first ownedCounts particles are owned, the rest are ghosts
+     *  copied from other processes which are only neighbors: tickDensity computes the density and pressure of the
+     *  owned particles, the caller then sets those of the ghosts, and tickForce moves the owned particles */
+    void tickDensity(unsigned int ownedCounts);
+    void tickForce(unsigned int ownedCounts);
+    /** replace all particles with their ids, masses in kg and smoothing radii in metres, the buffer grows if
+     *  needed. without masses and radii the particles get the base ones. false if they are more than the 65535 a
+     *  tick can address */
+    bool setParticles(const Particle* particles, const uint32_t* ids, unsigned int counts,
+                      const float* masses = nullptr, const float* radii = nullptr);
 
 private:
+    // per worker partial sums of the diagnostics, merged after each pass
+    struct WorkerPartial
+    {
+        float densityErrorSum;
+        float maxDensityError;
+        float maxSpeed2;
+        float maxAcceleration2;
+        float energySum;                    // sum of m v^2
+        unsigned int surfacePointCounts;
+        float neighborEncodeTime;           // ms, estimated from sampled commits
+        float neighborDecodeTime;           // ms, estimated from sampled decodes
+        unsigned int neighborDecodeCounts;
+    };
+
+    // what the adapt pass does with a particle
+    enum AdaptAction : unsigned char
+    {
+        ADAPT_KEEP,
+        ADAPT_SPLIT,
+        ADAPT_MERGE,                        // may merge with m_adaptPartners[i]
+    };
 
     void _init(unsigned short maxPointCounts, const ParticleBox3& wallBox, const ParticleBox3& initFluidBox, const glm::vec3 & gravity);
-    void _computeDensity();
-    void _computeForce();
-    void _advance();
+    void _computeKernels();
+    void _insertParticles();
+    void _computeDensity(unsigned int counts);
+    void _computeDensity(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial);
+    void _computeForce(unsigned int counts);
+    void _computeForce(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial);
+    void _computeDensityAdaptive(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial);
+    void _computeForceAdaptive(unsigned int begin, unsigned int end, NeighborTable& neighborTable, WorkerPartial& partial);
+    bool _isSurface(const glm::vec3& pos, glm::vec3 colorGradient, int neighborCounts, float smoothRadius, float gradientThreshold) const;
+    void _advance(unsigned int counts);
+    void _advance(unsigned int begin, unsigned int end, WorkerPartial& partial);
+    void _adapt(unsigned int counts);
+    void _classifyAdapt(unsigned int begin, unsigned int end, NeighborTable& neighborTable);
+    void _findMergePartners(unsigned int begin, unsigned int end, NeighborTable& neighborTable);
+    void _resetPointMasses();
+    void _setPointMasses(const float* masses, const float* radii, unsigned int counts);
+    void _initGridHierarchy();
+    void _collectStats();
     void addParticles(const ParticleBox3& fluidBox, float spacing);
 
 private:
     ParticleBuffer m_particleBuffer;
     ParticleGridContainer m_gridContainer;
-    NeighborTable m_neighborTable;
+    ParticleGridHierarchy m_gridHierarchy;  // filled while adaptive or masses differ
     TimeIntegrator* m_timeIntegrator;
 
+    // Threading, one neighbor table per worker
+    TaskPool* m_taskPool;
+    NeighborTable* m_neighborTables;
+    WorkerPartial* m_workerPartials;
+
+    // Statistics
+    bool m_statsEnabled;
+    SPHStats m_stats;
+    SPHDiagnostics m_diagnostics;
+    std::vector<unsigned char> m_surfaceFlags;
+    std::vector<uint32_t> m_pointIds;
+    uint32_t m_nextPointId;
+
+    // Adaptive resolution
+    bool m_adaptiveEnabled;
+    bool m_uniformMass;                     // every particle has the base mass, the fixed kernels apply
+    float m_minMassRatio;
+    float m_maxMassRatio;
+    float m_splitVorticity;                 // 1/s
+    float m_mergeVorticity;
+    unsigned int m_adaptInterval;           // ticks
+    std::vector<float> m_pointMasses;       // kg
+    std::vector<float> m_pointRadii;        // smoothing radius in metres
+    std::vector<float> m_pointVorticity;    // 1/s, only computed while adaptive
+    std::vector<AdaptAction> m_adaptActions;
+    std::vector<int> m_adaptPartners;
+
     // SPH Kernel
     float m_kernelPoly6;
     float m_kernelSpiky;
@@ -57,6 +218,8 @@ private:
     float m_boundaryStiffness;
     float m_boundaryDampening;
     float m_speedLimiting;
+    int m_surfaceNeighborCounts;            // particles at the surface have fewer neighbors
+    float m_surfaceGradient;                // and a longer color field gradient, times h
     float m_deltaTime;
     glm::vec3 m_gravityDir;
 
@@ -0,0 +1,97 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "state_interpolator.h"
+
+#include <algorithm>
+
+StateInterpolator::StateInterpolator()
+        : m_tickCounts(0)
+        , m_previousSimulatedTime(0.0)
+        , m_currentSimulatedTime(0.0)
+        , m_previousPublishTime(0.0)
+        , m_currentPublishTime(0.0)
+        , m_hasPrevious(false)
+        , m_hasVelocities(false)
+        , m_activeMode(MODE_LATEST)
+{
+}
+
+void StateInterpolator::update(const SimulationSnapshot &snapshot)
+{
+    if (m_hasVelocities && snapshot.tickCounts == m_tickCounts && snapshot.positions.size() == m_current.size()) return;
+
+    //a reset or a loaded checkpoint is a jump, don't blend across it
+    m_hasPrevious = m_hasVelocities && snapshot.tickCounts > m_tickCounts
+                    && snapshot.positions.size() == m_current.size();
+
+    m_previous.swap(m_current);
+    m_current = snapshot.positions;
+    m_velocities = snapshot.velocities;
+    m_tickCounts = snapshot.tickCounts;
+    m_hasVelocities = true;
+
+    m_previousSimulatedTime = m_currentSimulatedTime;
+    m_currentSimulatedTime = snapshot.simulatedTime;
+    m_previousPublishTime = m_currentPublishTime;
+    m_currentPublishTime = snapshot.publishTime;
+}
+
+void StateInterpolator::setPositions(const glm::vec3 *positions, unsigned int pointCounts)
+{
+    m_current.assign(positions, positions + pointCounts);
+    m_hasPrevious = false;
+    m_hasVelocities = false;
+}
+
+float StateInterpolator::computeBlend(Mode mode, double displayTime)
+{
+    double interval = m_currentPublishTime - m_previousPublishTime;
+    m_activeMode = mode;
+    if (mode == MODE_INTERPOLATE && (!m_hasPrevious || interval <= 0.0)) m_activeMode = MODE_LATEST;
+    if (mode == MODE_EXTRAPOLATE && !m_hasVelocities) m_activeMode = MODE_LATEST;
+
+    double elapsed = std::max(displayTime - m_currentPublishTime, 0.0);
+    switch (m_activeMode)
+    {
+        case MODE_INTERPOLATE:
+            return (float)std::min(elapsed / interval, 1.0);
+
+        case MODE_EXTRAPOLATE:
+        {
+            //simulated seconds ahead of the latest tick, never more than one tick interval
+            if (!m_hasPrevious || interval <= 0.0) return 0.f;
+            double rate = (m_currentSimulatedTime - m_previousSimulatedTime) / interval;
+            return (float)(std::min(elapsed, interval) * rate);
+        }
+
+        default:
+            return 0.f;
+    }
+}
+
+void StateInterpolator::gather(const unsigned int *indices, unsigned int counts, glm::vec3 *instances) const
+{
+    for (unsigned int k = 0; k < counts; k++)
+    {
+        unsigned int i = indices ? indices[k] : k;
+        switch (m_activeMode)
+        {
+            case MODE_INTERPOLATE:
+                instances[2 * k] = m_previous[i];
+                instances[2 * k + 1] = m_current[i] - m_previous[i];
+                break;
+
+            case MODE_EXTRAPOLATE:
+                instances[2 * k] = m_current[i];
+                instances[2 * k + 1] = m_velocities[i];
+                break;
+
+            default:
+                instances[2 * k] = m_current[i];
+                instances[2 * k + 1] = glm::vec3(0.f);
+                break;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_STATE_INTERPOLATOR_H
+#define SIMPLE_FLUID_SIMULATOR_STATE_INTERPOLATOR_H
+
+#include "simulation_thread.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/** keeps the two latest simulation states for the renderer and maps the display clock onto simulated time.
+ *  instances are written as a base and a delta, the vertex shader draws base + delta * blend:
+ *  interpolation shows the previous state blending into the latest one over one tick interval,
+ *  extrapolation moves the latest state along the velocities */
+class StateInterpolator
+{
+public:
+    enum Mode
+    {
+        MODE_LATEST,                    // the last tick as is
+        MODE_INTERPOLATE,               // one tick behind, smooth
+        MODE_EXTRAPOLATE,               // no latency, overshoots on collisions
+    };
+
+    /** keep the snapshot if it holds a new tick */
+    void update(const SimulationSnapshot& snapshot);
+    /** positions without a history, e.g. a trajectory frame */
+    void setPositions(const glm::vec3* positions, unsigned int pointCounts);
+
+    /** blend factor of the display time for the mode, falls back to MODE_LATEST without two usable states */
+    float computeBlend(Mode mode, double displayTime);
+    /** two vec3 per instance, indices may be null for all particles in order */
+    void gather(const unsigned int* indices, unsigned int counts, glm::vec3* instances) const;
+
+    /** positions of the latest state */
+    const glm::vec3* getPositions() const { return m_current.data(); }
+    unsigned int getPointCounts() const { return (unsigned int)m_current.size(); }
+    Mode getActiveMode() const { return m_activeMode; }
+
+private:
+    std::vector<glm::vec3> m_previous;
+    std::vector<glm::vec3> m_current;
+    std::vector<glm::vec3> m_velocities;
+    uint64_t m_tickCounts;
+    double m_previousSimulatedTime, m_currentSimulatedTime;
+    double m_previousPublishTime, m_currentPublishTime;
+    bool m_hasPrevious;
+    bool m_hasVelocities;
+    Mode m_activeMode;
+
+public:
+    StateInterpolator();
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_STATE_INTERPOLATOR_H
@@ -0,0 +1,573 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "surface_extractor.h"
+#include "sph_system.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/gtx/norm.hpp>
+
+namespace
+{
+    const float FIXED_SCALE = 65536.f;              // fixed point units per kernel weight
+    const uint64_t SHARED_EDGE = 1ull << 63;
+    const float FULL_CELL_FRACTION = 0.5f;
+
+    // marching cubes cases, built from the cube faces instead of the usual 256 x 16 literal table.
+    // corner i sits at (i & 1, i >> 1 & 1, i >> 2 & 1), edge axis * 4 + k runs along axis starting at edgeCorners[edge].
+    // on every face the crossings are joined so that the inside lies on the left seen from outside the cube, that
+    // chains them into closed polygons. a face with four crossings always cuts off its inside corners, both cubes
+    // sharing the face decide the same way so the surface stays closed
+    struct MarchingCubesTable
+    {
+        unsigned char edgeCorners[12];
+        unsigned char edgeAxes[12];
+        unsigned char triangleCounts[256];
+        unsigned char edges[256][30];
+
+        static int getEdge(int corner0, int corner1)
+        {
+            int bit = corner0 ^ corner1;
+            int axis = bit == 1 ? 0 : (bit == 2 ? 1 : 2);
+            int base = corner0 & ~bit;
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            return axis * 4 + ((base >> u) & 1) + 2 * ((base >> v) & 1);
+        }
+
+        // bit axis * 2 + side for the two faces holding an edge
+        static int getFaces(int edge)
+        {
+            int axis = edge / 4, k = edge % 4;
+            int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            return (1 << (u * 2 + (k & 1))) | (1 << (v * 2 + (k >> 1)));
+        }
+
+        MarchingCubesTable()
+        {
+            for (int edge = 0; edge < 12; edge++)
+            {
+                int axis = edge / 4, k = edge % 4;
+                int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                edgeCorners[edge] = (unsigned char)(((k & 1) << u) | ((k >> 1) << v));
+                edgeAxes[edge] = (unsigned char)axis;
+            }
+
+            for (int config = 0; config < 256; config++)
+            {
+                int next[12];
+                for (int& n : next) n = -1;
+
+                for (int face = 0; face < 6; face++)
+                {
+                    int axis = face / 2, side = face % 2;
+                    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                    //counter clockwise seen from outside
+                    const int square[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+                    int corners[4];
+                    for (int i = 0; i < 4; i++)
+                    {
+                        int j = side ? i : 3 - i;
+                        corners[i] = (side << axis) | (square[j][0] << u) | (square[j][1] << v);
+                    }
+
+                    int crossings[4];
+                    bool exits[4];
+                    int crossingCounts = 0;
+                    for (int i = 0; i < 4; i++)
+                    {
+                        bool inside0 = (config >> corners[i]) & 1;
+                        bool inside1 = (config >> corners[(i + 1) % 4]) & 1;
+                        crossings[i] = inside0 != inside1 ? getEdge(corners[i], corners[(i + 1) % 4]) : -1;
+                        exits[i] = inside0 && !inside1;
+                        if (crossings[i] >= 0) crossingCounts++;
+                    }
+
+                    if (crossingCounts == 2)
+                    {
+                        int exit = -1, entry = -1;
+                        for (int i = 0; i < 4; i++)
+                        {
+                            if (crossings[i] < 0) continue;
+                            if (exits[i]) exit = crossings[i];
+                            else entry = crossings[i];
+                        }
+                        next[exit] = entry;
+                    }
+                    else if (crossingCounts == 4)
+                    {
+                        //the entry right before the exit closes around the inside corner between them
+                        for (int i = 0; i < 4; i++)
+                        {
+                            if (exits[i]) next[crossings[i]] = crossings[(i + 3) % 4];
+                        }
+                    }
+                }
+
+                bool visited[12] = {};
+                int counts = 0;
+                for (int start = 0; start < 12; start++)
+                {
+                    if (next[start] < 0 || visited[start]) continue;
+
+                    int polygon[12];
+                    int size = 0;
+                    for (int edge = start; !visited[edge]; edge = next[edge])
+                    {
+                        visited[edge] = true;
+                        polygon[size++] = edge;
+                    }
+                    //a fan diagonal between two crossings of the same face would lie in that face and meet the
+                    //segment the neighbor cube draws there, so pick an apex without such diagonals if there is one
+                    int apex = 0;
+                    for (int candidate = 0; candidate < size; candidate++)
+                    {
+                        bool valid = true;
+                        for (int i = 2; i + 1 < size && valid; i++)
+                        {
+                            valid = (getFaces(polygon[candidate]) & getFaces(polygon[(candidate + i) % size])) == 0;
+                        }
+                        if (valid)
+                        {
+                            apex = candidate;
+                            break;
+                        }
+                    }
+                    for (int i = 1; i + 1 < size; i++)
+                    {
+                        edges[config][counts * 3 + 0] = (unsigned char)polygon[apex];
+                        edges[config][counts * 3 + 1] = (unsigned char)polygon[(apex + i + 1) % size];
+                        edges[config][counts * 3 + 2] = (unsigned char)polygon[(apex + i) % size];
+                        counts++;
+                    }
+                }
+                triangleCounts[config] = (unsigned char)counts;
+            }
+        }
+    };
+
+    const MarchingCubesTable s_marchingCubes;
+
+    float elapsedMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point stop)
+    {
+        return std::chrono::duration<float, std::milli>(stop - start).count();
+    }
+}
+
+SurfaceExtractor::SurfaceExtractor(unsigned int threadCounts)
+        : m_taskPool(threadCounts)
+        , m_voxelsPerCell(6)
+        , m_isoValue(0.5f)
+        , m_moveTolerance(0.1f)
+        , m_gridMin(0.f)
+        , m_cellSize(0.f)
+        , m_gridRes(0)
+        , m_blockRes(0)
+        , m_origin(0.f)
+        , m_voxelSize(0.f)
+        , m_radius(0.f)
+        , m_maxRadius(0.f)
+        , m_cellRange(1)
+        , m_fullCellCounts(1)
+        , m_rebuildAll(true)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void SurfaceExtractor::setVoxelsPerCell(unsigned int voxelsPerCell)
+{
+    voxelsPerCell = std::max(1u, voxelsPerCell);
+    if (voxelsPerCell != m_voxelsPerCell) m_rebuildAll = true;
+    m_voxelsPerCell = voxelsPerCell;
+}
+
+void SurfaceExtractor::setIsoValue(float isoValue)
+{
+    if (isoValue != m_isoValue) m_rebuildAll = true;
+    m_isoValue = isoValue;
+}
+
+void SurfaceExtractor::setMoveTolerance(float voxelFraction)
+{
+    m_moveTolerance = std::max(0.f, voxelFraction);
+}
+
+glm::ivec3 SurfaceExtractor::_getCell(const glm::vec3 &p) const
+{
+    return glm::clamp(glm::ivec3(glm::floor((p - m_gridMin) / m_cellSize)), glm::ivec3(0), m_gridRes - 1);
+}
+
+void SurfaceExtractor::_setup(const SPHSystem &system)
+{
+    const ParticleGridContainer& grid = system.getGridContainer();
+    glm::vec3 gridMin = *grid.getGridMin();
+    glm::ivec3 gridRes = *grid.getGridRes();
+    glm::vec3 cellSize = *grid.getGridSize() / glm::vec3(gridRes);
+    float radius = system.getSmoothRadius();
+    float maxRadius = radius;
+    if (!system.isUniformMass())
+    {
+        //particles with their own radius, they splat as far as they reach in the solver
+        const float* radii = system.getPointSmoothRadii();
+        for (unsigned int i = 0; i < system.getPointCounts(); i++) maxRadius = std::max(maxRadius, radii[i] / system.getUnitScale());
+    }
+
+    //a reset, a loaded checkpoint or new settings start over, so does a particle reaching further than the
+    //searched cells
+    if (gridMin != m_gridMin || gridRes != m_gridRes || cellSize != m_cellSize || radius != m_radius ||
+        maxRadius > m_maxRadius ||
+        m_referencePositions.size() != system.getPointCounts() ||
+        m_voxelSize != cellSize.x / m_voxelsPerCell)
+    {
+        m_rebuildAll = true;
+    }
+    if (!m_rebuildAll) return;
+
+    m_gridMin = gridMin;
+    m_gridRes = gridRes;
+    m_cellSize = cellSize;
+    m_radius = radius;
+    m_maxRadius = maxRadius;
+    m_cellRange = std::max(1, (int)std::ceil(maxRadius / std::min(cellSize.x, std::min(cellSize.y, cellSize.z))));
+
+    //grid cells are cubes, one block of padding closes the surface of fluid touching the walls
+    m_blockRes = gridRes + 2;
+    m_voxelSize = cellSize.x / m_voxelsPerCell;
+    m_origin = gridMin - cellSize;
+
+    float cellPoints = std::pow(cellSize.x / system.getPointDistance(), 3.f);
+    m_fullCellCounts = std::max(1u, (unsigned int)(FULL_CELL_FRACTION * cellPoints));
+
+    unsigned int cellCounts = (unsigned int)(gridRes.x * gridRes.y * gridRes.z);
+    unsigned int blockCounts = (unsigned int)(m_blockRes.x * m_blockRes.y * m_blockRes.z);
+    m_cellCounts.assign(cellCounts, 0);
+    m_dirtyCells.assign(cellCounts, 0);
+    m_blockStates.assign(blockCounts, 0);
+    m_blockMeshes.clear();
+    m_blockMeshes.resize(blockCounts);
+    m_movedPoints.assign(system.getPointCounts(), 0);
+    m_referencePositions.resize(system.getPointCounts());
+    for (unsigned int i = 0; i < system.getPointCounts(); i++) m_referencePositions[i] = system.getParticles()[i].pos;
+
+    unsigned int sampleSide = m_voxelsPerCell + 1;
+    m_workerScratch.resize(m_taskPool.getThreadCounts());
+    for (WorkerScratch& scratch : m_workerScratch)
+    {
+        scratch.samples.assign(sampleSide * sampleSide * sampleSide, 0);
+        scratch.edgeVertices.assign(3 * sampleSide * sampleSide * sampleSide, -1);
+    }
+}
+
+void SurfaceExtractor::_classifyBlocks(const SPHSystem &system)
+{
+    TRACE_SCOPE("surface classify");
+
+    const ParticleGridContainer& grid = system.getGridContainer();
+    const Particle* particles = system.getParticles();
+
+    //particles per cell, from the lists built by the last tick
+    unsigned int cellCounts = (unsigned int)m_cellCounts.size();
+    m_taskPool.parallelFor(cellCounts, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            int counts = 0;
+            for (int j = grid.getGridData((int)i); j != -1; j = particles[j].next) counts++;
+            m_cellCounts[i] = counts;
+        }
+    });
+
+    //a moved particle changes the field around the cell it left and the cell it is in now
+    std::fill(m_dirtyCells.begin(), m_dirtyCells.end(), 0);
+    m_stats.movedPointCounts = 0;
+    if (!m_rebuildAll)
+    {
+        unsigned int pointCounts = system.getPointCounts();
+        float tolerance2 = (m_moveTolerance * m_voxelSize) * (m_moveTolerance * m_voxelSize);
+        m_taskPool.parallelFor(pointCounts, [&](unsigned int begin, unsigned int end, unsigned int)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                m_movedPoints[i] = glm::distance2(particles[i].pos, m_referencePositions[i]) > tolerance2;
+            }
+        });
+
+        for (unsigned int i = 0; i < pointCounts; i++)
+        {
+            if (!m_movedPoints[i]) continue;
+
+            glm::ivec3 from = _getCell(m_referencePositions[i]);
+            glm::ivec3 to = _getCell(particles[i].pos);
+            m_dirtyCells[(from.z * m_gridRes.y + from.y) * m_gridRes.x + from.x] = 1;
+            m_dirtyCells[(to.z * m_gridRes.y + to.y) * m_gridRes.x + to.x] = 1;
+            m_referencePositions[i] = particles[i].pos;
+            m_stats.movedPointCounts++;
+        }
+    }
+
+    //a block is in the band if particles reach into it and its neighborhood isn't all fluid
+    unsigned int blockCounts = (unsigned int)m_blockStates.size();
+    m_taskPool.parallelFor(blockCounts, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for (unsigned int block = begin; block < end; block++)
+        {
+            glm::ivec3 b((int)(block % m_blockRes.x), (int)(block / m_blockRes.x % m_blockRes.y),
+                         (int)(block / m_blockRes.x / m_blockRes.y));
+            glm::ivec3 cell = b - 1;
+            glm::ivec3 lo = glm::max(cell - m_cellRange, glm::ivec3(0));
+            glm::ivec3 hi = glm::min(cell + m_cellRange, m_gridRes - 1);
+
+            //cells outside of the grid are empty
+            bool occupied = false;
+            bool full = lo == cell - m_cellRange && hi == cell + m_cellRange;
+            bool dirty = false;
+            for (int z = lo.z; z <= hi.z; z++)
+            {
+                for (int y = lo.y; y <= hi.y; y++)
+                {
+                    for (int x = lo.x; x <= hi.x; x++)
+                    {
+                        int index = (z * m_gridRes.y + y) * m_gridRes.x + x;
+                        occupied |= m_cellCounts[index] > 0;
+                        full &= m_cellCounts[index] >= (int)m_fullCellCounts;
+                        dirty |= m_dirtyCells[index] != 0;
+                    }
+                }
+            }
+
+            unsigned char state = (m_blockStates[block] & BLOCK_BAND) ? BLOCK_WAS_BAND : 0;
+            if (occupied && !full) state |= BLOCK_BAND;
+            if (dirty) state |= BLOCK_DIRTY;
+            m_blockStates[block] = state;
+        }
+    });
+
+    m_bandBlockList.clear();
+    m_rebuildBlockList.clear();
+    for (unsigned int block = 0; block < blockCounts; block++)
+    {
+        unsigned char state = m_blockStates[block];
+        if (state & BLOCK_BAND)
+        {
+            m_bandBlockList.push_back(block);
+            if (m_rebuildAll || !(state & BLOCK_WAS_BAND) || (state & BLOCK_DIRTY)) m_rebuildBlockList.push_back(block);
+        }
+        else if (state & BLOCK_WAS_BAND)
+        {
+            BlockMesh& mesh = m_blockMeshes[block];
+            mesh.vertices.clear();
+            mesh.edgeKeys.clear();
+            mesh.indices.clear();
+        }
+    }
+}
+
+void SurfaceExtractor::_extractBlock(const SPHSystem &system, unsigned int block, WorkerScratch &scratch)
+{
+    const ParticleGridContainer& grid = system.getGridContainer();
+    const Particle* particles = system.getParticles();
+
+    const int N = (int)m_voxelsPerCell;
+    const int S = N + 1;
+    glm::ivec3 b((int)(block % m_blockRes.x), (int)(block / m_blockRes.x % m_blockRes.y),
+                 (int)(block / m_blockRes.x / m_blockRes.y));
+    glm::ivec3 sampleBase = b * N;
+
+    //splat the particles of the surrounding cells. sample positions only depend on the global sample, so two
+    //blocks compute the same weights for a shared sample, and integer sums don't depend on the order
+    std::vector<uint32_t>& samples = scratch.samples;
+    std::fill(samples.begin(), samples.end(), 0);
+
+    glm::ivec3 cell = b - 1;
+    glm::ivec3 lo = glm::max(cell - m_cellRange, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(cell + m_cellRange, m_gridRes - 1);
+    //a particle splats over its own radius, so a lighter one adds less to the field
+    const float* radii = system.isUniformMass() ? nullptr : system.getPointSmoothRadii();
+    float invUnitScale = 1.f / system.getUnitScale();
+    for (int z = lo.z; z <= hi.z; z++)
+    {
+        for (int y = lo.y; y <= hi.y; y++)
+        {
+            for (int x = lo.x; x <= hi.x; x++)
+            {
+                for (int j = grid.getGridData((z * m_gridRes.y + y) * m_gridRes.x + x); j != -1; j = particles[j].next)
+                {
+                    glm::vec3 p = particles[j].pos;
+                    float radius = radii ? radii[j] * invUnitScale : m_radius;
+                    float radius2 = radius * radius;
+                    float invRadius2 = 1.f / radius2;
+                    glm::ivec3 sampleMin = glm::max(glm::ivec3(glm::ceil((p - radius - m_origin) / m_voxelSize)), sampleBase) - sampleBase;
+                    glm::ivec3 sampleMax = glm::min(glm::ivec3(glm::floor((p + radius - m_origin) / m_voxelSize)), sampleBase + N) - sampleBase;
+
+                    for (int sz = sampleMin.z; sz <= sampleMax.z; sz++)
+                    {
+                        for (int sy = sampleMin.y; sy <= sampleMax.y; sy++)
+                        {
+                            for (int sx = sampleMin.x; sx <= sampleMax.x; sx++)
+                            {
+                                glm::vec3 d = m_origin + glm::vec3(sampleBase + glm::ivec3(sx, sy, sz)) * m_voxelSize - p;
+                                float r2 = glm::dot(d, d);
+                                if (r2 >= radius2) continue;
+
+                                float q = 1.f - r2 * invRadius2;
+                                samples[(sz * S + sy) * S + sx] += (uint32_t)(q * q * q * FIXED_SCALE + 0.5f);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    scratch.sampleCounts += (unsigned int)(S * S * S);
+
+    //marching cubes, vertices are shared through the edges of the block
+    BlockMesh& mesh = m_blockMeshes[block];
+    mesh.vertices.clear();
+    mesh.edgeKeys.clear();
+    mesh.indices.clear();
+
+    uint32_t iso = (uint32_t)(m_isoValue * FIXED_SCALE);
+    uint64_t sampleRowX = (uint64_t)m_blockRes.x * N + 1;
+    uint64_t sampleRowY = (uint64_t)m_blockRes.y * N + 1;
+    std::vector<int>& edgeVertices = scratch.edgeVertices;
+    for (int z = 0; z < N; z++)
+    {
+        for (int y = 0; y < N; y++)
+        {
+            for (int x = 0; x < N; x++)
+            {
+                int config = 0;
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    int index = ((z + ((corner >> 2) & 1)) * S + y + ((corner >> 1) & 1)) * S + x + (corner & 1);
+                    if (samples[index] > iso) config |= 1 << corner;
+                }
+
+                for (int i = 0; i < s_marchingCubes.triangleCounts[config] * 3; i++)
+                {
+                    int edge = s_marchingCubes.edges[config][i];
+                    int corner = s_marchingCubes.edgeCorners[edge];
+                    int axis = s_marchingCubes.edgeAxes[edge];
+                    glm::ivec3 l(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1));
+                    int sample0 = (l.z * S + l.y) * S + l.x;
+
+                    int& vertex = edgeVertices[sample0 * 3 + axis];
+                    if (vertex < 0)
+                    {
+                        glm::ivec3 step(0);
+                        step[axis] = 1;
+                        int sample1 = sample0 + (axis == 0 ? 1 : (axis == 1 ? S : S * S));
+                        float v0 = (float)samples[sample0];
+                        float v1 = (float)samples[sample1];
+                        float t = ((float)iso - v0) / (v1 - v0);
+
+                        glm::ivec3 g = sampleBase + l;
+                        uint64_t key = (((uint64_t)g.z * sampleRowY + g.y) * sampleRowX + g.x) * 3 + axis;
+                        for (int k = 0; k < 3; k++)
+                        {
+                            if (k != axis && (l[k] == 0 || l[k] == N)) key |= SHARED_EDGE;
+                        }
+
+                        vertex = (int)mesh.vertices.size();
+                        mesh.vertices.push_back(m_origin + (glm::vec3(g) + t * glm::vec3(step)) * m_voxelSize);
+                        mesh.edgeKeys.push_back(key);
+                    }
+                    mesh.indices.push_back((unsigned int)vertex);
+                }
+            }
+        }
+    }
+
+    std::fill(edgeVertices.begin(), edgeVertices.end(), -1);
+}
+
+void SurfaceExtractor::_weld()
+{
+    TRACE_SCOPE("surface weld");
+
+    m_vertices.clear();
+    m_indices.clear();
+    m_sharedVertices.clear();
+
+    for (unsigned int block : m_bandBlockList)
+    {
+        const BlockMesh& mesh = m_blockMeshes[block];
+        m_remap.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            if (mesh.edgeKeys[i] & SHARED_EDGE)
+            {
+                auto result = m_sharedVertices.emplace(mesh.edgeKeys[i], (unsigned int)m_vertices.size());
+                if (result.second) m_vertices.push_back(mesh.vertices[i]);
+                m_remap[i] = result.first->second;
+            }
+            else
+            {
+                m_remap[i] = (unsigned int)m_vertices.size();
+                m_vertices.push_back(mesh.vertices[i]);
+            }
+        }
+        for (unsigned int index : mesh.indices) m_indices.push_back(m_remap[index]);
+    }
+}
+
+void SurfaceExtractor::extract(const SPHSystem &system)
+{
+    TRACE_SCOPE("surface extract");
+
+    auto start = std::chrono::steady_clock::now();
+    _setup(system);
+    _classifyBlocks(system);
+    auto classified = std::chrono::steady_clock::now();
+
+    {
+        TRACE_SCOPE("surface blocks");
+        for (WorkerScratch& scratch : m_workerScratch) scratch.sampleCounts = 0;
+        m_taskPool.parallelFor((unsigned int)m_rebuildBlockList.size(), [&](unsigned int begin, unsigned int end, unsigned int worker)
+        {
+            for (unsigned int i = begin; i < end; i++) _extractBlock(system, m_rebuildBlockList[i], m_workerScratch[worker]);
+        });
+    }
+    auto extracted = std::chrono::steady_clock::now();
+
+    _weld();
+    auto welded = std::chrono::steady_clock::now();
+    m_rebuildAll = false;
+
+    m_stats.blockCounts = (unsigned int)m_blockStates.size();
+    m_stats.bandBlockCounts = (unsigned int)m_bandBlockList.size();
+    m_stats.rebuiltBlockCounts = (unsigned int)m_rebuildBlockList.size();
+    m_stats.sampleCounts = 0;
+    for (const WorkerScratch& scratch : m_workerScratch) m_stats.sampleCounts += scratch.sampleCounts;
+    m_stats.vertexCounts = (unsigned int)m_vertices.size();
+    m_stats.triangleCounts = (unsigned int)(m_indices.size() / 3);
+    m_stats.classifyTime = elapsedMs(start, classified);
+    m_stats.extractTime = elapsedMs(classified, extracted);
+    m_stats.weldTime = elapsedMs(extracted, welded);
+    m_stats.totalTime = elapsedMs(start, welded);
+}
+
+bool SurfaceExtractor::writeObj(const char *path) const
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    fprintf(file, "# fluid surface, %u vertices, %u triangles\n", (unsigned int)m_vertices.size(), (unsigned int)(m_indices.size() / 3));
+    for (const glm::vec3& v : m_vertices)
+    {
+        fprintf(file, "v %f %f %f\n", v.x, v.y, v.z);
+    }
+    for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+    {
+        fprintf(file, "f %u %u %u\n", m_indices[i] + 1, m_indices[i + 1] + 1, m_indices[i + 2] + 1);
+    }
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,131 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_SURFACE_EXTRACTOR_H
+#define SIMPLE_FLUID_SIMULATOR_SURFACE_EXTRACTOR_H
+
+#include "task_pool.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class SPHSystem;
+
+/** counters and timers of the last extract */
+struct SurfaceStats
+{
+    unsigned int blockCounts;           // grid cells and the padding around them
+    unsigned int bandBlockCounts;       // blocks near the surface
+    unsigned int rebuiltBlockCounts;    // band blocks extracted again
+    unsigned int movedPointCounts;
+    unsigned int sampleCounts;          // scalar field samples splatted
+    unsigned int vertexCounts;
+    unsigned int triangleCounts;
+    float classifyTime;                 // ms, cell counts, moved particles and band blocks
+    float extractTime;                  // ms, splat and marching cubes of the rebuilt blocks
+    float weldTime;                     // ms, merge of the block meshes
+    float totalTime;                    // ms
+};
+
+/** reconstructs the fluid surface as a triangle mesh with marching cubes.
+ *  every cell of the neighbor search grid is a block of voxelsPerCell^3 voxels. only blocks in a narrow band
+ *  around the surface get a scalar field, those whose neighborhood holds particles but isn't completely filled
+ *  with fluid. the field is splatted from the particles of the surrounding cells, found through
+ *  ParticleGridContainer, and summed in fixed point so the samples shared by two blocks are bit identical and
+ *  the welded mesh has no cracks. blocks are extracted in parallel on a task pool.
+ *  block meshes are kept between calls, extract only redoes the blocks whose particles moved */
+class SurfaceExtractor
+{
+public:
+    /** voxels along a grid cell, more gives a finer mesh */
+    void setVoxelsPerCell(unsigned int voxelsPerCell);
+    /** the surface is where the summed kernel weights reach isoValue, 1 at the center of a lone particle */
+    void setIsoValue(float isoValue);
+    /** particles closer than this fraction of a voxel to where they were at the last extract didn't move */
+    void setMoveTolerance(float voxelFraction);
+
+    /** update the mesh, the system must not tick meanwhile */
+    void extract(const SPHSystem& system);
+    /** drop the block meshes, the next extract does every band block */
+    void invalidate() { m_rebuildAll = true; }
+
+    const std::vector<glm::vec3>& getVertices() const { return m_vertices; }
+    const std::vector<unsigned int>& getIndices() const { return m_indices; }
+    const SurfaceStats& getStats() const { return m_stats; }
+
+    bool writeObj(const char* path) const;
+
+    unsigned int getThreadCounts() const { return m_taskPool.getThreadCounts(); }
+
+private:
+    enum
+    {
+        BLOCK_BAND = 1,                         // near the surface
+        BLOCK_WAS_BAND = 2,                     // near the surface at the last extract, the mesh is valid
+        BLOCK_DIRTY = 4,                        // particles moved in the surrounding cells
+    };
+
+    struct BlockMesh
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<uint64_t> edgeKeys;         // global edge of every vertex, SHARED_EDGE for vertices on block faces
+        std::vector<unsigned int> indices;      // into vertices
+    };
+
+    struct WorkerScratch
+    {
+        std::vector<uint32_t> samples;          // fixed point field of the block
+        std::vector<int> edgeVertices;          // vertex of every block edge, -1 if none
+        unsigned int sampleCounts;
+    };
+
+    void _setup(const SPHSystem& system);
+    void _classifyBlocks(const SPHSystem& system);
+    void _extractBlock(const SPHSystem& system, unsigned int block, WorkerScratch& scratch);
+    void _weld();
+    glm::ivec3 _getCell(const glm::vec3& p) const;
+
+private:
+    TaskPool m_taskPool;
+    unsigned int m_voxelsPerCell;
+    float m_isoValue;
+    float m_moveTolerance;
+
+    ////// layout of the last extract
+    glm::vec3 m_gridMin;
+    glm::vec3 m_cellSize;
+    glm::ivec3 m_gridRes;
+    glm::ivec3 m_blockRes;                      // grid resolution plus one block of padding on every side
+    glm::vec3 m_origin;                         // sample 0, the corner of the first padding block
+    float m_voxelSize;
+    float m_radius;                             // base smoothing radius in world units
+    float m_maxRadius;                          // largest smoothing radius of a particle, sets m_cellRange
+    int m_cellRange;                            // cells around a block whose particles reach into it
+    unsigned int m_fullCellCounts;              // particles in a cell of fluid at rest, halved
+
+    std::vector<int> m_cellCounts;
+    std::vector<unsigned char> m_dirtyCells;
+    std::vector<unsigned char> m_blockStates;   // BLOCK_ flags
+    std::vector<BlockMesh> m_blockMeshes;
+    std::vector<unsigned int> m_bandBlockList;
+    std::vector<unsigned int> m_rebuildBlockList;
+    std::vector<glm::vec3> m_referencePositions;
+    std::vector<unsigned char> m_movedPoints;
+    bool m_rebuildAll;
+
+    std::vector<WorkerScratch> m_workerScratch;
+    std::unordered_map<uint64_t, unsigned int> m_sharedVertices;
+    std::vector<unsigned int> m_remap;
+
+    std::vector<glm::vec3> m_vertices;
+    std::vector<unsigned int> m_indices;
+    SurfaceStats m_stats;
+
+public:
+    explicit SurfaceExtractor(unsigned int threadCounts);
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_SURFACE_EXTRACTOR_H
@@ -0,0 +1,92 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "task_pool.h"
+#include "trace.h"
+
+TaskPool::TaskPool(unsigned int threadCounts)
+        : m_threadCounts(threadCounts > 0 ? threadCounts : 1)
+        , m_func(nullptr)
+        , m_counts(0)
+        , m_generation(0)
+        , m_pendingWorkers(0)
+        , m_quit(false)
+{
+    //worker 0 is the calling thread
+    for (unsigned int i = 1; i < m_threadCounts; i++)
+    {
+        m_threads.emplace_back(&TaskPool::_workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_startCond.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void TaskPool::parallelFor(unsigned int counts, const RangeFunc &func)
+{
+    if (m_threadCounts == 1)
+    {
+        func(0, counts, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_counts = counts;
+        m_pendingWorkers = m_threadCounts - 1;
+        m_generation++;
+    }
+    m_startCond.notify_all();
+
+    unsigned int begin, end;
+    getChunk(counts, m_threadCounts, 0, begin, end);
+    func(begin, end, 0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCond.wait(lock, [this] { return m_pendingWorkers == 0; });
+    m_func = nullptr;
+}
+
+void TaskPool::_workerLoop(unsigned int worker)
+{
+    TraceRecorder::get()->setThreadName("task pool worker");
+    unsigned int seenGeneration = 0;
+
+    for (;;)
+    {
+        const RangeFunc* func;
+        unsigned int counts;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_startCond.wait(lock, [&] { return m_quit || m_generation != seenGeneration; });
+            if (m_quit) return;
+
+            seenGeneration = m_generation;
+            func = m_func;
+            counts = m_counts;
+        }
+
+        unsigned int begin, end;
+        getChunk(counts, m_threadCounts, worker, begin, end);
+        (*func)(begin, end, worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingWorkers--;
+        }
+        m_doneCond.notify_one();
+    }
+}
@@ -0,0 +1,60 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_TASK_POOL_H
+#define SIMPLE_FLUID_SIMULATOR_TASK_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool
+{
+public:
+    typedef std::function<void(unsigned int begin, unsigned int end, unsigned int worker)> RangeFunc;
+
+    /** get thread counts, including the calling thread */
+    unsigned int getThreadCounts() const { return m_threadCounts; }
+
+    /** split [0, counts) into getThreadCounts() contiguous chunks and run func on each, blocks until all are done.
+     *  the chunk of a worker only depends on counts and thread counts, so two calls with the same counts
+     *  hand the same particles to the same worker */
+    void parallelFor(unsigned int counts, const RangeFunc& func);
+
+    /** get the range handled by a worker for the given counts */
+    static void getChunk(unsigned int counts, unsigned int chunks, unsigned int worker, unsigned int& begin, unsigned int& end)
+    {
+        begin = (unsigned int)((unsigned long long)counts * worker / chunks);
+        end = (unsigned int)((unsigned long long)counts * (worker + 1) / chunks);
+    }
+
+private:
+    void _workerLoop(unsigned int worker);
+
+private:
+    unsigned int m_threadCounts;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_startCond;
+    std::condition_variable m_doneCond;
+
+    ////// current job
+    const RangeFunc* m_func;
+    unsigned int m_counts;
+    unsigned int m_generation;
+    unsigned int m_pendingWorkers;
+    bool m_quit;
+
+public:
+    explicit TaskPool(unsigned int threadCounts);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_TASK_POOL_H
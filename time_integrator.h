@@ -12,6 +12,7 @@ public:
     explicit TimeIntegrator(float dt) :m_dt(dt) {}
 
     virtual void update(Particle* particle) = 0;
+    void setDeltaTime(float dt) { m_dt = dt; }
 protected:
     float m_dt;
 };
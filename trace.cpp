@@ -0,0 +1,185 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+
+std::atomic<bool> TraceRecorder::s_enabled{false};
+
+namespace
+{
+    uint64_t steadyNanoseconds()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+// gives the ring of a thread back to the recorder when the thread exits
+struct TraceThreadSlot
+{
+    TraceRing* ring = nullptr;
+    const char* name = nullptr;
+
+    ~TraceThreadSlot()
+    {
+        if (ring) TraceRecorder::get()->_releaseRing(ring);
+    }
+};
+
+static thread_local TraceThreadSlot t_traceSlot;
+
+//-----------------------------------------------------------------------------------------------------------------
+void TraceRing::copyEvents(std::vector<TraceEvent> &events) const
+{
+    uint64_t end = m_writeIndex.load(std::memory_order_acquire);
+    uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+    for (uint64_t i = begin; i < end; i++)
+    {
+        const Slot& slot = m_slots[i & (CAPACITY - 1)];
+
+        //drop the slot if the writer started on it before or while we read it
+        if (slot.sequence.load(std::memory_order_acquire) != i + 1) continue;
+        TraceEvent event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.beginTime = slot.beginTime.load(std::memory_order_relaxed);
+        event.endTime = slot.endTime.load(std::memory_order_relaxed);
+        event.frame = slot.frame.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != i + 1) continue;
+
+        events.push_back(event);
+    }
+}
+
+void TraceRing::_clear()
+{
+    for (Slot& slot : m_slots) slot.sequence.store(0, std::memory_order_relaxed);
+    m_writeIndex.store(0, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+TraceRecorder::TraceRecorder()
+        : m_frame(0)
+        , m_startTime(steadyNanoseconds())
+        , m_nextThreadId(1)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    for (TraceRing* ring : m_rings) delete ring;
+}
+
+TraceRecorder* TraceRecorder::get()
+{
+    //never destroyed, worker threads may still give their rings back while statics are torn down
+    static TraceRecorder* s_recorder = new TraceRecorder();
+    return s_recorder;
+}
+
+uint64_t TraceRecorder::now() const
+{
+    return steadyNanoseconds() - m_startTime;
+}
+
+void TraceRecorder::setThreadName(const char *name)
+{
+    //the ring is only allocated once the thread records an event
+    t_traceSlot.name = name;
+    if (t_traceSlot.ring)
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        t_traceSlot.ring->m_threadName = name;
+    }
+}
+
+void TraceRecorder::record(const char *name, uint64_t beginTime, uint64_t endTime)
+{
+    TraceEvent event;
+    event.name = name;
+    event.beginTime = beginTime;
+    event.endTime = endTime;
+    event.frame = getFrame();
+    _getThreadRing()->push(event);
+}
+
+TraceRing *TraceRecorder::_getThreadRing()
+{
+    if (t_traceSlot.ring) return t_traceSlot.ring;
+
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+
+    //reuse the ring of a thread which has exited
+    TraceRing* ring = nullptr;
+    for (TraceRing* r : m_rings)
+    {
+        if (!r->m_inUse)
+        {
+            ring = r;
+            break;
+        }
+    }
+    if (!ring)
+    {
+        ring = new TraceRing();
+        m_rings.push_back(ring);
+    }
+
+    //forget the events of the previous owner, their sequences would match the new write indices
+    ring->_clear();
+    ring->m_threadId = m_nextThreadId++;
+    ring->m_threadName = t_traceSlot.name;
+    ring->m_inUse = true;
+
+    t_traceSlot.ring = ring;
+    return ring;
+}
+
+void TraceRecorder::_releaseRing(TraceRing *ring)
+{
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    ring->m_inUse = false;
+}
+
+bool TraceRecorder::dumpChromeTrace(const char *path, unsigned int frameCounts)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    uint32_t frame = getFrame();
+    uint32_t firstFrame = frame >= frameCounts ? frame - frameCounts : 0;
+
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Simple Fluid Simulator\"}}");
+
+    std::vector<TraceEvent> events;
+    for (TraceRing* ring : m_rings)
+    {
+        if (ring->getThreadName())
+        {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    ring->getThreadId(), ring->getThreadName());
+        }
+
+        events.clear();
+        ring->copyEvents(events);
+        for (const TraceEvent& event : events)
+        {
+            if (event.frame < firstFrame) continue;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                    event.name, ring->getThreadId(), event.beginTime / 1000.0,
+                    (event.endTime - event.beginTime) / 1000.0, event.frame);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
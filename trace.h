@@ -0,0 +1,147 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_TRACE_H
+#define SIMPLE_FLUID_SIMULATOR_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+    const char* name;       // must be a string literal, only the pointer is stored
+    uint64_t beginTime;     // nanoseconds since the recorder was created
+    uint64_t endTime;
+    uint32_t frame;
+};
+
+/** fixed size ring of events, written by a single thread and read by the dump without locks */
+class TraceRing
+{
+public:
+    enum { CAPACITY = 1 << 15, };
+
+    void push(const TraceEvent& event)
+    {
+        uint64_t index = m_writeIndex.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[index & (CAPACITY - 1)];
+
+        //seqlock, the slot reads as invalid while its fields are rewritten
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.beginTime.store(event.beginTime, std::memory_order_relaxed);
+        slot.endTime.store(event.endTime, std::memory_order_relaxed);
+        slot.frame.store(event.frame, std::memory_order_relaxed);
+        slot.sequence.store(index + 1, std::memory_order_release);
+
+        m_writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    /** copy the events still held by the ring, events overwritten while copying are dropped */
+    void copyEvents(std::vector<TraceEvent>& events) const;
+
+    unsigned int getThreadId() const { return m_threadId; }
+    const char* getThreadName() const { return m_threadName; }
+
+private:
+    friend class TraceRecorder;
+
+    /** one event, sequence is the write index + 1 of the event it holds, 0 while empty or being written */
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> beginTime{0};
+        std::atomic<uint64_t> endTime{0};
+        std::atomic<uint32_t> frame{0};
+    };
+
+    void _clear();
+
+    Slot m_slots[CAPACITY];
+    std::atomic<uint64_t> m_writeIndex{0};
+    unsigned int m_threadId{0};
+    const char* m_threadName{nullptr};
+    bool m_inUse{false};
+};
+
+/** records scoped events of every thread into per-thread rings and writes them as chrome trace json,
+ *  which loads in chrome://tracing and ui.perfetto.dev */
+class TraceRecorder
+{
+public:
+    static TraceRecorder* get();
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+    /** mark the start of a new frame, events are tagged with the frame they began in */
+    void nextFrame() { m_frame.fetch_add(1, std::memory_order_relaxed); }
+    uint32_t getFrame() const { return m_frame.load(std::memory_order_relaxed); }
+
+    /** name the calling thread in the trace, name must be a string literal */
+    void setThreadName(const char* name);
+
+    uint64_t now() const;
+    void record(const char* name, uint64_t beginTime, uint64_t endTime);
+
+    /** write the events of the last frameCounts frames to a chrome trace json file */
+    bool dumpChromeTrace(const char* path, unsigned int frameCounts);
+
+private:
+    TraceRing* _getThreadRing();
+    void _releaseRing(TraceRing* ring);
+
+private:
+    static std::atomic<bool> s_enabled;
+
+    std::atomic<uint32_t> m_frame;
+    uint64_t m_startTime;
+
+    std::mutex m_ringMutex;                 // only taken when a thread records its first event, or by the dump
+    std::vector<TraceRing*> m_rings;
+    unsigned int m_nextThreadId;
+
+    friend struct TraceThreadSlot;
+
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+            : m_name(TraceRecorder::isEnabled() ? name : nullptr)
+            , m_beginTime(m_name ? TraceRecorder::get()->now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_name)
+        {
+            TraceRecorder* recorder = TraceRecorder::get();
+            recorder->record(m_name, m_beginTime, recorder->now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_beginTime;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+/** record the enclosing scope as an event, name must be a string literal */
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+
+#endif //SIMPLE_FLUID_SIMULATOR_TRACE_H
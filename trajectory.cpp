@@ -0,0 +1,488 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "trajectory.h"
+#include "sph_system.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const char TRAJECTORY_MAGIC[8] = { 'S', 'P', 'H', 'T', 'R', 'A', 'J', 0 };
+    const char TRAJECTORY_INDEX_MAGIC[8] = { 'S', 'P', 'H', 'T', 'I', 'D', 'X', 0 };
+
+    uint16_t quantizeValue(float value, float offset, float scale)
+    {
+        float q = (value - offset) * scale + 0.5f;
+        if (q < 0.f) q = 0.f;
+        if (q > 65535.f) q = 65535.f;
+        return (uint16_t)q;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+void TrajectoryCodec::init(const TrajectoryHeader &header)
+{
+    m_pointCounts = header.pointCounts;
+    m_domainMin = glm::vec3(header.domainMin[0], header.domainMin[1], header.domainMin[2]);
+    glm::vec3 domainSize = glm::vec3(header.domainMax[0], header.domainMax[1], header.domainMax[2]) - m_domainMin;
+    m_domainScale = 65535.f / glm::max(domainSize, glm::vec3(1e-6f));
+    m_speedMin = -header.maxSpeed;
+    m_speedScale = 65535.f / std::max(2.f * header.maxSpeed, 1e-6f);
+}
+
+void TrajectoryCodec::quantize(const glm::vec3 *positions, const glm::vec3 *velocities, std::vector<uint16_t> &quantized) const
+{
+    unsigned int n = m_pointCounts;
+    quantized.resize(TRAJECTORY_COMPONENTS * n);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            quantized[axis * n + i] = quantizeValue(positions[i][axis], m_domainMin[axis], m_domainScale[axis]);
+            quantized[(3 + axis) * n + i] = quantizeValue(velocities[i][axis], m_speedMin, m_speedScale);
+        }
+    }
+}
+
+void TrajectoryCodec::dequantize(const std::vector<uint16_t> &quantized, glm::vec3 *positions, glm::vec3 *velocities) const
+{
+    unsigned int n = m_pointCounts;
+    glm::vec3 invDomainScale = 1.f / m_domainScale;
+    float invSpeedScale = 1.f / m_speedScale;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            positions[i][axis] = m_domainMin[axis] + quantized[axis * n + i] * invDomainScale[axis];
+        }
+    }
+
+    if (!velocities) return;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            velocities[i][axis] = m_speedMin + quantized[(3 + axis) * n + i] * invSpeedScale;
+        }
+    }
+}
+
+void TrajectoryCodec::encode(const std::vector<uint16_t> &current, const std::vector<uint16_t> &previous,
+                             unsigned int pointCounts, bool keyframe, std::vector<unsigned char> &payload)
+{
+    payload.clear();
+
+    for (unsigned int c = 0; c < TRAJECTORY_COMPONENTS; c++)
+    {
+        const uint16_t* cur = current.data() + c * pointCounts;
+        const uint16_t* prev = keyframe ? nullptr : previous.data() + c * pointCounts;
+
+        int last = 0;
+        for (unsigned int i = 0; i < pointCounts; i++)
+        {
+            int reference = keyframe ? last : prev[i];
+            int delta = (int)cur[i] - reference;
+            last = cur[i];
+
+            //zigzag, then 7 bits per byte
+            uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+            while (value >= 0x80)
+            {
+                payload.push_back((unsigned char)(value | 0x80));
+                value >>= 7;
+            }
+            payload.push_back((unsigned char)value);
+        }
+    }
+}
+
+bool TrajectoryCodec::decode(const unsigned char *payload, uint32_t payloadSize, unsigned int pointCounts, bool keyframe,
+                             std::vector<uint16_t> &quantized)
+{
+    if (quantized.size() != (size_t)TRAJECTORY_COMPONENTS * pointCounts)
+    {
+        if (!keyframe) return false;
+        quantized.resize((size_t)TRAJECTORY_COMPONENTS * pointCounts);
+    }
+
+    const unsigned char* p = payload;
+    const unsigned char* end = payload + payloadSize;
+
+    for (unsigned int c = 0; c < TRAJECTORY_COMPONENTS; c++)
+    {
+        uint16_t* q = quantized.data() + c * pointCounts;
+
+        int last = 0;
+        for (unsigned int i = 0; i < pointCounts; i++)
+        {
+            uint32_t value = 0;
+            int shift = 0;
+            for (;;)
+            {
+                if (p >= end || shift > 28) return false;
+                unsigned char byte = *p++;
+                value |= (uint32_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) break;
+                shift += 7;
+            }
+            int delta = (int)(value >> 1) ^ -(int)(value & 1);
+
+            int reference = keyframe ? last : q[i];
+            last = (uint16_t)(reference + delta);
+            q[i] = (uint16_t)last;
+        }
+    }
+    return p == end;
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+TrajectoryWriter::TrajectoryWriter()
+        : m_file(nullptr)
+        , m_intervalTicks(1)
+        , m_nextSnapshot(0)
+        , m_writeSnapshot(0)
+        , m_quit(false)
+        , m_fileOffset(0)
+        , m_frameCounts(0)
+        , m_droppedFrameCounts(0)
+        , m_failedFrameCounts(0)
+        , m_payloadBytes(0)
+        , m_sampleCounts(0)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+bool TrajectoryWriter::open(const char *path, const SPHSystem &system, unsigned int intervalTicks,
+                            unsigned int keyframeInterval, float maxSpeed)
+{
+    close();
+
+    m_file = fopen(path, "wb");
+    if (!m_file) return false;
+
+    //the boundary is a penalty force, so particles can get slightly outside of the walls
+    const ParticleBox3& domain = system.getWallBox();
+    float margin = system.getPointDistance();
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.magic, TRAJECTORY_MAGIC, sizeof(m_header.magic));
+    m_header.version = TRAJECTORY_VERSION;
+    m_header.pointCounts = system.getPointCounts();
+    for (int i = 0; i < 3; i++)
+    {
+        m_header.domainMin[i] = domain.min[i] - margin;
+        m_header.domainMax[i] = domain.max[i] + margin;
+    }
+    m_header.maxSpeed = maxSpeed;
+    m_intervalTicks = intervalTicks > 0 ? intervalTicks : 1;
+    m_header.frameTime = system.getDeltaTime() * m_intervalTicks;
+    m_header.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    m_codec.init(m_header);
+
+    if (fwrite(&m_header, sizeof(m_header), 1, m_file) != 1)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_fileOffset = sizeof(m_header);
+
+    for (Snapshot& snapshot : m_snapshots)
+    {
+        snapshot.positions.resize(m_header.pointCounts);
+        snapshot.velocities.resize(m_header.pointCounts);
+        snapshot.ready = false;
+    }
+    m_nextSnapshot = 0;
+    m_writeSnapshot = 0;
+    m_quit = false;
+    m_index.clear();
+    m_previous.clear();
+    m_frameCounts = 0;
+    m_droppedFrameCounts = 0;
+    m_failedFrameCounts = 0;
+    m_payloadBytes = 0;
+    m_sampleCounts = 0;
+
+    m_thread = std::thread(&TrajectoryWriter::_writerLoop, this);
+    return true;
+}
+
+void TrajectoryWriter::record(const SPHSystem &system)
+{
+    if (!m_file) return;
+
+    uint64_t tick = system.getStats().tickCounts;
+    if (tick % m_intervalTicks != 0) return;
+
+    if (system.getPointCounts() != m_header.pointCounts)
+    {
+        m_droppedFrameCounts++;
+        return;
+    }
+
+    Snapshot& snapshot = m_snapshots[m_nextSnapshot];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (snapshot.ready)
+        {
+            //the writer is behind by two frames
+            m_droppedFrameCounts++;
+            return;
+        }
+    }
+
+    TRACE_SCOPE("trajectory snapshot");
+
+    //the writer doesn't touch a slot which is not ready
+    const Particle* particles = system.getParticles();
+    for (unsigned int i = 0; i < m_header.pointCounts; i++)
+    {
+        snapshot.positions[i] = particles[i].pos;
+        snapshot.velocities[i] = particles[i].velocity;
+    }
+    snapshot.tick = tick;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        snapshot.ready = true;
+    }
+    m_cond.notify_one();
+    m_nextSnapshot ^= 1;
+}
+
+bool TrajectoryWriter::close()
+{
+    if (!m_file) return true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+
+    TrajectoryFooter footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.indexOffset = m_fileOffset;
+    footer.frameCounts = (uint32_t)m_index.size();
+    memcpy(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic));
+
+    bool ok = (m_index.empty() || fwrite(m_index.data(), sizeof(TrajectoryIndexEntry), m_index.size(), m_file) == m_index.size())
+              && fwrite(&footer, sizeof(footer), 1, m_file) == 1;
+    ok = fclose(m_file) == 0 && ok && m_failedFrameCounts == 0;
+    m_file = nullptr;
+    return ok;
+}
+
+float TrajectoryWriter::getBytesPerParticleFrame() const
+{
+    uint64_t samples = m_sampleCounts.load();
+    return samples > 0 ? (float)((double)m_payloadBytes.load() / samples) : 0.f;
+}
+
+void TrajectoryWriter::_writerLoop()
+{
+    TraceRecorder::get()->setThreadName("trajectory writer");
+
+    for (;;)
+    {
+        Snapshot& snapshot = m_snapshots[m_writeSnapshot];
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return snapshot.ready || m_quit; });
+            if (!snapshot.ready) return;    //quit and nothing left
+        }
+
+        _writeFrame(snapshot);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            snapshot.ready = false;
+        }
+        m_writeSnapshot ^= 1;
+    }
+}
+
+void TrajectoryWriter::_writeFrame(const Snapshot &snapshot)
+{
+    TRACE_SCOPE("trajectory write");
+
+    bool keyframe = m_index.size() % m_header.keyframeInterval == 0;
+    m_codec.quantize(snapshot.positions.data(), snapshot.velocities.data(), m_quantized);
+    TrajectoryCodec::encode(m_quantized, m_previous, m_header.pointCounts, keyframe, m_payload);
+
+    TrajectoryFrameHeader frameHeader;
+    frameHeader.tick = snapshot.tick;
+    frameHeader.payloadSize = (uint32_t)m_payload.size();
+    frameHeader.keyframe = keyframe ? 1 : 0;
+    if (fwrite(&frameHeader, sizeof(frameHeader), 1, m_file) != 1
+        || fwrite(m_payload.data(), 1, m_payload.size(), m_file) != m_payload.size())
+    {
+        //the next frame overwrites the partial one, it is encoded against the same previous frame
+        clearerr(m_file);
+        fseek(m_file, (long)m_fileOffset, SEEK_SET);
+        m_failedFrameCounts++;
+        return;
+    }
+
+    TrajectoryIndexEntry entry;
+    entry.offset = m_fileOffset;
+    entry.tick = snapshot.tick;
+    entry.payloadSize = frameHeader.payloadSize;
+    entry.keyframe = frameHeader.keyframe;
+    m_index.push_back(entry);
+
+    m_fileOffset += sizeof(frameHeader) + m_payload.size();
+    m_previous.swap(m_quantized);
+    m_payloadBytes += m_payload.size();
+    m_sampleCounts += m_header.pointCounts;
+    m_frameCounts++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------
+TrajectoryReader::TrajectoryReader()
+        : m_decodedFrame(-1)
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+bool TrajectoryReader::open(const char *path)
+{
+    close();
+    if (!m_file.open(path)) return false;
+
+    if (m_file.size() < sizeof(TrajectoryHeader)) return false;
+    memcpy(&m_header, m_file.data(), sizeof(m_header));
+    if (memcmp(m_header.magic, TRAJECTORY_MAGIC, sizeof(m_header.magic)) != 0
+        || m_header.version != TRAJECTORY_VERSION || m_header.keyframeInterval == 0)
+    {
+        close();
+        return false;
+    }
+    m_codec.init(m_header);
+
+    //a writer which didn't close has no index, find the frames by walking the file
+    if (!_loadIndex() && !_scanFrames())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TrajectoryReader::close()
+{
+    m_file.close();
+    m_index.clear();
+    m_quantized.clear();
+    m_decodedFrame = -1;
+}
+
+bool TrajectoryReader::_loadIndex()
+{
+    if (m_file.size() < sizeof(TrajectoryHeader) + sizeof(TrajectoryFooter)) return false;
+
+    TrajectoryFooter footer;
+    memcpy(&footer, m_file.data() + m_file.size() - sizeof(footer), sizeof(footer));
+    if (memcmp(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic)) != 0) return false;
+
+    uint64_t indexSize = (uint64_t)footer.frameCounts * sizeof(TrajectoryIndexEntry);
+    if (footer.indexOffset < sizeof(TrajectoryHeader) || footer.indexOffset + indexSize + sizeof(footer) != m_file.size()) return false;
+
+    m_index.resize(footer.frameCounts);
+    if (indexSize > 0) memcpy(m_index.data(), m_file.data() + footer.indexOffset, (size_t)indexSize);
+
+    //every frame has to lie between the header and the index, a bad entry falls back to walking the frames
+    for (const TrajectoryIndexEntry& entry : m_index)
+    {
+        if (entry.offset < sizeof(TrajectoryHeader) || entry.offset > footer.indexOffset
+            || footer.indexOffset - entry.offset < sizeof(TrajectoryFrameHeader) + (uint64_t)entry.payloadSize)
+        {
+            m_index.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrajectoryReader::_scanFrames()
+{
+    m_index.clear();
+
+    uint64_t offset = sizeof(TrajectoryHeader);
+    while (offset + sizeof(TrajectoryFrameHeader) <= m_file.size())
+    {
+        TrajectoryFrameHeader frameHeader;
+        memcpy(&frameHeader, m_file.data() + offset, sizeof(frameHeader));
+        if (offset + sizeof(frameHeader) + frameHeader.payloadSize > m_file.size()) break;
+
+        TrajectoryIndexEntry entry;
+        entry.offset = offset;
+        entry.tick = frameHeader.tick;
+        entry.payloadSize = frameHeader.payloadSize;
+        entry.keyframe = frameHeader.keyframe;
+        m_index.push_back(entry);
+
+        offset += sizeof(frameHeader) + frameHeader.payloadSize;
+    }
+    return !m_index.empty();
+}
+
+bool TrajectoryReader::_decode(unsigned int frame)
+{
+    const TrajectoryIndexEntry& entry = m_index[frame];
+    const unsigned char* payload = m_file.data() + entry.offset + sizeof(TrajectoryFrameHeader);
+    if (!TrajectoryCodec::decode(payload, entry.payloadSize, m_header.pointCounts, entry.keyframe != 0, m_quantized))
+    {
+        m_decodedFrame = -1;
+        return false;
+    }
+    m_decodedFrame = (int)frame;
+    return true;
+}
+
+unsigned int TrajectoryReader::getKeyframe(unsigned int frame) const
+{
+    while (frame > 0 && !m_index[frame].keyframe) frame--;
+    return frame;
+}
+
+bool TrajectoryReader::readFrame(unsigned int frame, glm::vec3 *positions, glm::vec3 *velocities)
+{
+    if (frame >= m_index.size()) return false;
+
+    if ((int)frame != m_decodedFrame)
+    {
+        //continue from the decoded frame if no keyframe is closer, otherwise start from the closest keyframe
+        unsigned int start = frame;
+        if (m_decodedFrame >= 0 && (int)frame > m_decodedFrame)
+        {
+            while ((int)start > m_decodedFrame + 1 && !m_index[start].keyframe) start--;
+        }
+        else
+        {
+            start = getKeyframe(frame);
+            if (!m_index[start].keyframe) return false;
+        }
+
+        for (unsigned int f = start; f <= frame; f++)
+        {
+            if (!_decode(f)) return false;
+        }
+    }
+
+    m_codec.dequantize(m_quantized, positions, velocities);
+    return true;
+}
@@ -0,0 +1,207 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_TRAJECTORY_H
+#define SIMPLE_FLUID_SIMULATOR_TRAJECTORY_H
+
+#include "mapped_file.h"
+#include "particle_box.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SPHSystem;
+
+// Trajectory file layout, all values little endian:
+//
+//   TrajectoryHeader
+//   frame 0: TrajectoryFrameHeader + payload
+//   frame 1: ...
+//   TrajectoryIndexEntry[frameCounts]
+//   TrajectoryFooter
+//
+// Positions are quantized to 16 bits per axis inside the domain box, velocities to 16 bits per axis inside
+// [-maxSpeed, maxSpeed]. The payload holds the six components one after another, each as zigzag varints of
+// the difference to the previous particle (keyframes) or to the same particle in the previous frame.
+// Every keyframeInterval-th frame is a keyframe, so any frame decodes from at most keyframeInterval frames.
+
+enum
+{
+    TRAJECTORY_VERSION = 1,
+    TRAJECTORY_COMPONENTS = 6,      // position xyz, velocity xyz
+};
+
+struct TrajectoryHeader
+{
+    char magic[8];                  // "SPHTRAJ\0"
+    uint32_t version;
+    uint32_t pointCounts;
+    float domainMin[3];
+    float domainMax[3];
+    float maxSpeed;
+    float frameTime;                // simulated seconds between two frames
+    uint32_t keyframeInterval;
+    uint32_t reserved;
+};
+
+struct TrajectoryFrameHeader
+{
+    uint64_t tick;
+    uint32_t payloadSize;
+    uint32_t keyframe;
+};
+
+struct TrajectoryIndexEntry
+{
+    uint64_t offset;                // of the frame header
+    uint64_t tick;
+    uint32_t payloadSize;
+    uint32_t keyframe;
+};
+
+struct TrajectoryFooter
+{
+    uint64_t indexOffset;
+    uint32_t frameCounts;
+    uint32_t reserved;
+    char magic[8];                  // "SPHTIDX\0"
+};
+
+/** quantizes and delta encodes frames, shared by the writer and the reader */
+class TrajectoryCodec
+{
+public:
+    void init(const TrajectoryHeader& header);
+
+    /** encode quantized components, previous is ignored for keyframes */
+    static void encode(const std::vector<uint16_t>& current, const std::vector<uint16_t>& previous,
+                       unsigned int pointCounts, bool keyframe, std::vector<unsigned char>& payload);
+    /** decode in place, quantized holds the previous frame for delta frames */
+    static bool decode(const unsigned char* payload, uint32_t payloadSize, unsigned int pointCounts, bool keyframe,
+                       std::vector<uint16_t>& quantized);
+
+    void quantize(const glm::vec3* positions, const glm::vec3* velocities, std::vector<uint16_t>& quantized) const;
+    void dequantize(const std::vector<uint16_t>& quantized, glm::vec3* positions, glm::vec3* velocities) const;
+
+private:
+    unsigned int m_pointCounts;
+    glm::vec3 m_domainMin;
+    glm::vec3 m_domainScale;        // quantized units per world unit
+    float m_speedMin;
+    float m_speedScale;
+};
+
+/** records snapshots of a system every intervalTicks ticks and writes them from a background thread.
+ *  record only copies positions and velocities into a free snapshot slot, a frame is dropped when both slots
+ *  are still waiting for the disk, so the simulation never waits for the writer */
+class TrajectoryWriter
+{
+public:
+    bool open(const char* path, const SPHSystem& system, unsigned int intervalTicks,
+              unsigned int keyframeInterval = 32, float maxSpeed = 5.f);
+    /** call after every tick */
+    void record(const SPHSystem& system);
+    /** write the pending frames and the index. false if the index or a frame failed to write, the frames before
+     *  a failed index are still found by a reader */
+    bool close();
+    bool isOpen() const { return m_file != nullptr; }
+
+    unsigned int getFrameCounts() const { return m_frameCounts.load(); }
+    unsigned int getDroppedFrameCounts() const { return m_droppedFrameCounts.load(); }
+    /** frames lost to a failed write, the next frame is written in their place */
+    unsigned int getFailedFrameCounts() const { return m_failedFrameCounts.load(); }
+    /** average payload bytes per particle per frame, 24 bytes uncompressed */
+    float getBytesPerParticleFrame() const;
+
+private:
+    struct Snapshot
+    {
+        uint64_t tick;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> velocities;
+        bool ready;
+    };
+
+    void _writerLoop();
+    void _writeFrame(const Snapshot& snapshot);
+
+private:
+    FILE* m_file;
+    TrajectoryHeader m_header;
+    TrajectoryCodec m_codec;
+    unsigned int m_intervalTicks;
+
+    Snapshot m_snapshots[2];
+    unsigned int m_nextSnapshot;        // slot written by the next record
+    unsigned int m_writeSnapshot;       // slot written next by the writer thread
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_quit;
+
+    ////// writer thread only
+    std::vector<uint16_t> m_quantized;
+    std::vector<uint16_t> m_previous;
+    std::vector<unsigned char> m_payload;
+    std::vector<TrajectoryIndexEntry> m_index;
+    uint64_t m_fileOffset;
+
+    std::atomic<unsigned int> m_frameCounts;
+    std::atomic<unsigned int> m_droppedFrameCounts;
+    std::atomic<unsigned int> m_failedFrameCounts;
+    std::atomic<uint64_t> m_payloadBytes;
+    std::atomic<uint64_t> m_sampleCounts;   // particles over all written frames
+
+public:
+    TrajectoryWriter();
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+};
+
+/** random access to the frames of a trajectory file through a memory mapping */
+class TrajectoryReader
+{
+public:
+    bool open(const char* path);
+    void close();
+
+    const TrajectoryHeader& getHeader() const { return m_header; }
+    unsigned int getPointCounts() const { return m_header.pointCounts; }
+    unsigned int getFrameCounts() const { return (unsigned int)m_index.size(); }
+    uint64_t getFrameTick(unsigned int frame) const { return m_index[frame].tick; }
+    /** the keyframe a frame is decoded from */
+    unsigned int getKeyframe(unsigned int frame) const;
+    /** frame held by the decoder, reading the next one only decodes a single frame */
+    int getDecodedFrame() const { return m_decodedFrame; }
+
+    /** decode a frame, velocities may be null. sequential reads only decode one frame, others start
+     *  from the closest keyframe */
+    bool readFrame(unsigned int frame, glm::vec3* positions, glm::vec3* velocities);
+
+private:
+    bool _loadIndex();
+    bool _scanFrames();
+    bool _decode(unsigned int frame);
+
+private:
+    MappedFile m_file;
+    TrajectoryHeader m_header;
+    TrajectoryCodec m_codec;
+    std::vector<TrajectoryIndexEntry> m_index;
+
+    std::vector<uint16_t> m_quantized;  // last decoded frame
+    int m_decodedFrame;
+
+public:
+    TrajectoryReader();
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_TRAJECTORY_H
@@ -0,0 +1,230 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#include "trajectory_player.h"
+#include "trace.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const unsigned int CACHE_SLACK = 4;     // cached frames on top of the read ahead window
+}
+
+TrajectoryPlayer::TrajectoryPlayer()
+        : m_readAhead(DEFAULT_READ_AHEAD)
+        , m_readBehind(DEFAULT_READ_BEHIND)
+        , m_quit(false)
+        , m_targetFrame(0)
+        , m_direction(1)
+        , m_requestVersion(0)
+{
+}
+
+TrajectoryPlayer::~TrajectoryPlayer()
+{
+    close();
+}
+
+bool TrajectoryPlayer::open(const char *path, unsigned int readAhead, unsigned int readBehind)
+{
+    close();
+    if (!m_reader.open(path)) return false;
+    if (m_reader.getFrameCounts() == 0)
+    {
+        m_reader.close();
+        return false;
+    }
+
+    m_readAhead = readAhead;
+    m_readBehind = readBehind;
+    m_cache.resize(readAhead + readBehind + 1 + CACHE_SLACK);
+    for (CachedFrame& cached : m_cache)
+    {
+        cached.frame = -1;
+        cached.valid = false;
+        cached.positions.resize(m_reader.getPointCounts());
+    }
+
+    m_targetFrame = 0;
+    m_direction = 1;
+    m_requestVersion = 0;
+    m_quit = false;
+    m_thread = std::thread(&TrajectoryPlayer::_workerLoop, this);
+    return true;
+}
+
+void TrajectoryPlayer::close()
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cond.notify_one();
+        m_thread.join();
+    }
+
+    m_cache.clear();
+    m_reader.close();
+}
+
+void TrajectoryPlayer::request(unsigned int frame, int direction)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (frame == m_targetFrame && direction == m_direction) return;
+
+        m_targetFrame = frame;
+        m_direction = direction < 0 ? -1 : 1;
+        m_requestVersion++;
+    }
+    m_cond.notify_one();
+}
+
+bool TrajectoryPlayer::copyFrame(unsigned int frame, glm::vec3 *positions)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    int slot = _findSlot(frame);
+    if (slot < 0 || !m_cache[slot].valid) return false;
+
+    memcpy(positions, m_cache[slot].positions.data(), m_cache[slot].positions.size() * sizeof(glm::vec3));
+    return true;
+}
+
+unsigned int TrajectoryPlayer::getCachedFrameCounts()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    unsigned int counts = 0;
+    for (const CachedFrame& cached : m_cache)
+    {
+        if (cached.frame >= 0) counts++;
+    }
+    return counts;
+}
+
+bool TrajectoryPlayer::_isWanted(unsigned int frame) const
+{
+    int offset = ((int)frame - (int)m_targetFrame) * m_direction;
+    return offset >= -(int)m_readBehind && offset <= (int)m_readAhead;
+}
+
+int TrajectoryPlayer::_findSlot(unsigned int frame) const
+{
+    for (size_t i = 0; i < m_cache.size(); i++)
+    {
+        if (m_cache[i].frame == (int)frame) return (int)i;
+    }
+    return -1;
+}
+
+bool TrajectoryPlayer::_findMissingFrame(unsigned int &frame) const
+{
+    int frameCounts = (int)m_reader.getFrameCounts();
+    unsigned int window = m_readAhead > m_readBehind ? m_readAhead : m_readBehind;
+
+    //the target first, then alternate between the frames ahead and behind it
+    for (unsigned int i = 0; i <= window; i++)
+    {
+        int candidates[2] = { -1, -1 };
+        if (i <= m_readAhead) candidates[0] = (int)m_targetFrame + (int)i * m_direction;
+        if (i > 0 && i <= m_readBehind) candidates[1] = (int)m_targetFrame - (int)i * m_direction;
+
+        for (int candidate : candidates)
+        {
+            if (candidate < 0 || candidate >= frameCounts) continue;
+            if (_findSlot((unsigned int)candidate) < 0)
+            {
+                frame = (unsigned int)candidate;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TrajectoryPlayer::_store(unsigned int frame, bool valid, std::vector<glm::vec3> &positions)
+{
+    if (_findSlot(frame) >= 0) return;
+
+    //take a free slot or evict the frame farthest from the target which is out of the window. the cache is
+    //larger than the window, so a wanted frame always finds a slot and is never decoded again
+    int slot = -1;
+    unsigned int farthest = 0;
+    for (size_t i = 0; i < m_cache.size(); i++)
+    {
+        if (m_cache[i].frame < 0)
+        {
+            slot = (int)i;
+            break;
+        }
+        if (_isWanted((unsigned int)m_cache[i].frame)) continue;
+
+        unsigned int distance = (unsigned int)abs(m_cache[i].frame - (int)m_targetFrame);
+        if (distance >= farthest)
+        {
+            farthest = distance;
+            slot = (int)i;
+        }
+    }
+
+    if (slot < 0) return;
+    //a frame left behind by a scrub doesn't push out a closer one
+    if (m_cache[slot].frame >= 0 && !_isWanted(frame) && (unsigned int)abs((int)frame - (int)m_targetFrame) > farthest) return;
+
+    m_cache[slot].frame = (int)frame;
+    m_cache[slot].valid = valid;
+    m_cache[slot].positions.swap(positions);
+}
+
+void TrajectoryPlayer::_workerLoop()
+{
+    TraceRecorder::get()->setThreadName("trajectory player");
+
+    std::vector<glm::vec3> positions(m_reader.getPointCounts());
+    for (;;)
+    {
+        unsigned int frame;
+        unsigned int version;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] { return m_quit || _findMissingFrame(frame); });
+            if (m_quit) return;
+            version = m_requestVersion;
+        }
+
+        TRACE_SCOPE("decode trajectory");
+
+        //frames between the keyframe and the missing one are decoded anyway, keep the wanted ones.
+        //this makes reading behind the target as cheap as reading ahead of it
+        unsigned int start = m_reader.getKeyframe(frame);
+        int decoded = m_reader.getDecodedFrame();
+        if (decoded >= (int)start && decoded <= (int)frame) start = (unsigned int)decoded;
+
+        for (unsigned int f = start; f <= frame; f++)
+        {
+            bool valid = m_reader.readFrame(f, positions.data(), nullptr);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!valid)
+            {
+                //don't retry a broken frame forever
+                _store(frame, false, positions);
+                positions.resize(m_reader.getPointCounts());
+                break;
+            }
+            if (f == frame || _isWanted(f))
+            {
+                _store(f, true, positions);
+                positions.resize(m_reader.getPointCounts());
+            }
+            //the user scrubbed somewhere else, serve the new target first
+            if (m_quit || m_requestVersion != version) break;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_TRAJECTORY_PLAYER_H
+#define SIMPLE_FLUID_SIMULATOR_TRAJECTORY_PLAYER_H
+
+#include "trajectory.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** plays a trajectory file back. a worker thread decodes the requested frame first and then reads ahead in
+ *  the playing direction and a few frames behind it, so stepping and scrubbing around the current frame are
+ *  served from the cache. a cache miss never blocks the caller, it keeps showing the previous frame */
+class TrajectoryPlayer
+{
+public:
+    enum
+    {
+        DEFAULT_READ_AHEAD = 32,
+        DEFAULT_READ_BEHIND = 12,
+    };
+
+    bool open(const char* path, unsigned int readAhead = DEFAULT_READ_AHEAD, unsigned int readBehind = DEFAULT_READ_BEHIND);
+    void close();
+    bool isOpen() const { return m_thread.joinable(); }
+
+    const TrajectoryHeader& getHeader() const { return m_reader.getHeader(); }
+    unsigned int getPointCounts() const { return m_reader.getPointCounts(); }
+    unsigned int getFrameCounts() const { return m_reader.getFrameCounts(); }
+    uint64_t getFrameTick(unsigned int frame) const { return m_reader.getFrameTick(frame); }
+    float getFrameTime() const { return m_reader.getHeader().frameTime; }
+
+    /** the frame shown next, direction is 1 when playing forward and -1 when playing backward */
+    void request(unsigned int frame, int direction);
+    /** copy the positions of a frame if it is decoded already */
+    bool copyFrame(unsigned int frame, glm::vec3* positions);
+    unsigned int getCachedFrameCounts();
+
+private:
+    struct CachedFrame
+    {
+        int frame;
+        bool valid;                     // false if the frame failed to decode
+        std::vector<glm::vec3> positions;
+    };
+
+    void _workerLoop();
+    bool _findMissingFrame(unsigned int& frame) const;
+    bool _isWanted(unsigned int frame) const;
+    int _findSlot(unsigned int frame) const;
+    void _store(unsigned int frame, bool valid, std::vector<glm::vec3>& positions);
+
+private:
+    TrajectoryReader m_reader;          // worker thread only after open
+    unsigned int m_readAhead;
+    unsigned int m_readBehind;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_quit;
+
+    std::vector<CachedFrame> m_cache;
+    unsigned int m_targetFrame;
+    int m_direction;
+    unsigned int m_requestVersion;
+
+public:
+    TrajectoryPlayer();
+    ~TrajectoryPlayer();
+
+    TrajectoryPlayer(const TrajectoryPlayer&) = delete;
+    TrajectoryPlayer& operator=(const TrajectoryPlayer&) = delete;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_TRAJECTORY_PLAYER_H
@@ -0,0 +1,49 @@
+//
+// Created by Leo on 2026/10/19.
+//
+
+#ifndef SIMPLE_FLUID_SIMULATOR_TRIPLE_BUFFER_H
+#define SIMPLE_FLUID_SIMULATOR_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/** lock free single producer, single consumer triple buffer. the producer fills the write buffer and
+ *  publishes it, the consumer always gets the latest published buffer. neither side ever waits, frames the
+ *  consumer didn't pick up in time are overwritten */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : m_shared(1), m_write(0), m_read(2) {}
+
+    ////// producer
+    T& getWriteBuffer() { return m_buffers[m_write]; }
+    void publish()
+    {
+        m_write = m_shared.exchange(m_write | DIRTY, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    ////// consumer
+    /** switch to the latest published buffer, false if nothing was published since the last update */
+    bool update()
+    {
+        if (!(m_shared.load(std::memory_order_relaxed) & DIRTY)) return false;
+        m_read = m_shared.exchange(m_read, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& getReadBuffer() const { return m_buffers[m_read]; }
+
+private:
+    enum
+    {
+        INDEX_MASK = 3,
+        DIRTY = 4,
+    };
+
+    T m_buffers[3];
+    std::atomic<unsigned int> m_shared;     // index of the shared buffer and the dirty flag
+    unsigned int m_write;
+    unsigned int m_read;
+};
+
+#endif //SIMPLE_FLUID_SIMULATOR_TRIPLE_BUFFER_H